@@ -0,0 +1,58 @@
+// Times the analyser on synthetic audio, to check the host side stays cheap
+//
+//   ./spectrum-bench [fft size] [fps]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "spectrum.h"
+
+int main(int argc, char** argv) {
+  Spectrum::settings s;
+  if (argc > 1) {
+    s.fft_size = std::atoi(argv[1]);
+  }
+  const double fps = argc > 2 ? std::atof(argv[2]) : 60;
+
+  Spectrum::Analyser analyser(s);
+
+  // A few tones over some noise, so every band has something in it
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+  std::vector<float> samples(s.fft_size * 4);
+  for (size_t i = 0; i < samples.size(); i++) {
+    const float t = static_cast<float>(i) / s.sample_rate;
+    samples[i] = 0.3f * std::sin(2 * M_PI * 80 * t) +
+                 0.2f * std::sin(2 * M_PI * 1000 * t) +
+                 0.1f * std::sin(2 * M_PI * 8000 * t) +
+                 noise(rng);
+  }
+
+  uint8_t levels[256];
+  const uint32_t iterations = 20000;
+  const uint32_t stride = s.fft_size / 4;
+  unsigned checksum = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; i++) {
+    analyser.analyse(&samples[(i % 12) * stride], levels);
+    checksum += levels[i % s.bands];
+  }
+  const std::chrono::duration<double, std::micro> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  const double per_frame_us = elapsed.count() / iterations;
+#if defined(__SSE2__) && !defined(FFT_NO_SIMD)
+  const char* path = "SSE2";
+#else
+  const char* path = "scalar";
+#endif
+  std::printf("%u point FFT, %u bands, %s butterflies\n", s.fft_size, s.bands, path);
+  std::printf("%.2f us per frame, %.4f%% of one core at %.0f fps (checksum %u)\n",
+              per_frame_us, per_frame_us * fps / 1e4, fps, checksum);
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include "fft.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) && !defined(FFT_NO_SIMD)
+#include <emmintrin.h>
+#endif
+
+namespace Fft {
+  RealFft::RealFft(const uint32_t n) :
+    n(n), half(n / 2),
+    bit_reverse(n / 2),
+    twiddle_re(n / 2), twiddle_im(n / 2),
+    split_re(n / 2), split_im(n / 2),
+    re(n / 2), im(n / 2) {
+    if (n < 16 || (n & (n - 1)) != 0) {
+      throw std::invalid_argument("FFT size must be a power of two, at least 16");
+    }
+
+    uint32_t bits = 0;
+    while ((1u << bits) < half) {
+      bits++;
+    }
+    for (uint32_t i = 0; i < half; i++) {
+      uint32_t r = 0;
+      for (uint32_t b = 0; b < bits; b++) {
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+      bit_reverse[i] = r;
+    }
+
+    for (uint32_t h = 1; h < half; h *= 2) {
+      for (uint32_t j = 0; j < h; j++) {
+        const double angle = -M_PI * j / h;
+        twiddle_re[h - 1 + j] = std::cos(angle);
+        twiddle_im[h - 1 + j] = std::sin(angle);
+      }
+    }
+
+    for (uint32_t k = 0; k < half; k++) {
+      const double angle = -2 * M_PI * k / n;
+      split_re[k] = std::cos(angle);
+      split_im[k] = std::sin(angle);
+    }
+  }
+
+  void RealFft::transform() {
+    for (uint32_t h = 1; h < half; h *= 2) {
+      const float* const wr = &twiddle_re[h - 1];
+      const float* const wi = &twiddle_im[h - 1];
+
+      for (uint32_t base = 0; base < half; base += 2 * h) {
+        float* const ar = &re[base];
+        float* const ai = &im[base];
+        float* const br = &re[base + h];
+        float* const bi = &im[base + h];
+
+        uint32_t j = 0;
+#if defined(__SSE2__) && !defined(FFT_NO_SIMD)
+        // Four butterflies at a time once the stage is wide enough
+        for (; j + 4 <= h; j += 4) {
+          const __m128 w_re = _mm_loadu_ps(wr + j);
+          const __m128 w_im = _mm_loadu_ps(wi + j);
+          const __m128 b_re = _mm_loadu_ps(br + j);
+          const __m128 b_im = _mm_loadu_ps(bi + j);
+          const __m128 t_re = _mm_sub_ps(_mm_mul_ps(w_re, b_re), _mm_mul_ps(w_im, b_im));
+          const __m128 t_im = _mm_add_ps(_mm_mul_ps(w_re, b_im), _mm_mul_ps(w_im, b_re));
+          const __m128 a_re = _mm_loadu_ps(ar + j);
+          const __m128 a_im = _mm_loadu_ps(ai + j);
+          _mm_storeu_ps(ar + j, _mm_add_ps(a_re, t_re));
+          _mm_storeu_ps(ai + j, _mm_add_ps(a_im, t_im));
+          _mm_storeu_ps(br + j, _mm_sub_ps(a_re, t_re));
+          _mm_storeu_ps(bi + j, _mm_sub_ps(a_im, t_im));
+        }
+#endif
+        for (; j < h; j++) {
+          const float t_re = wr[j] * br[j] - wi[j] * bi[j];
+          const float t_im = wr[j] * bi[j] + wi[j] * br[j];
+          br[j] = ar[j] - t_re;
+          bi[j] = ai[j] - t_im;
+          ar[j] += t_re;
+          ai[j] += t_im;
+        }
+      }
+    }
+  }
+
+  void RealFft::power(const float* in, float* out) {
+    // Even samples go in the real part, odd in the imaginary
+    for (uint32_t i = 0; i < half; i++) {
+      re[bit_reverse[i]] = in[2 * i];
+      im[bit_reverse[i]] = in[2 * i + 1];
+    }
+
+    transform();
+
+    const float dc = re[0] + im[0];
+    const float nyquist = re[0] - im[0];
+    out[0] = dc * dc;
+    out[half] = nyquist * nyquist;
+
+    for (uint32_t k = 1; k < half; k++) {
+      const float zr = re[k], zi = im[k];
+      const float cr = re[half - k], ci = -im[half - k];
+
+      // X[k] = E[k] + W^k * O[k], with E and O the spectra of the even and odd samples
+      const float e_re = 0.5f * (zr + cr);
+      const float e_im = 0.5f * (zi + ci);
+      const float o_re = 0.5f * (zi - ci);
+      const float o_im = -0.5f * (zr - cr);
+
+      const float x_re = e_re + split_re[k] * o_re - split_im[k] * o_im;
+      const float x_im = e_im + split_re[k] * o_im + split_im[k] * o_re;
+      out[k] = x_re * x_re + x_im * x_im;
+    }
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Fft {
+  // Power spectrum of real input, using a half size complex FFT
+  // with SSE butterflies where available
+  class RealFft {
+  public:
+    // n must be a power of two, at least 16
+    explicit RealFft(uint32_t n);
+
+    uint32_t size() const { return n; }
+
+    // in holds n samples, out gets n/2+1 bins of |X[k]|^2
+    void power(const float* in, float* out);
+
+  private:
+    void transform();
+
+    uint32_t n;
+    uint32_t half;
+    std::vector<uint32_t> bit_reverse;
+    // Butterfly twiddles, stage with h butterflies starts at h-1
+    std::vector<float> twiddle_re, twiddle_im;
+    // e^(-2*pi*i*k/n), to split the half size FFT back into the real one
+    std::vector<float> split_re, split_im;
+    std::vector<float> re, im;
+  };
+}
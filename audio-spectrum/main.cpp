@@ -0,0 +1,262 @@
+// Drives the light bar's Audio Spectrum mode from an audio stream or WAV file
+//
+//   parec --format=s16le --channels=2 --rate=48000 | ./beef-spectrum
+//   ./beef-spectrum --wav song.wav
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hidapi.h>
+
+#include "spectrum.h"
+
+namespace {
+  constexpr unsigned short BEEF_VID = 0x1CCF;
+  constexpr unsigned short BEEF_PID = 0x8048;
+  constexpr int LIGHTS_INTERFACE = 4;
+
+  // Lights protocol, see fw/devices/iidx/iidx_tape_led.h and iidx_audio_spectrum.h
+  constexpr uint8_t PROTOCOL_VERSION = 1;
+  constexpr uint8_t FLAG_SPECTRUM = 1 << 2;
+  constexpr size_t REPORT_SIZE = 64;
+  constexpr uint8_t HEADER_SIZE = 5;
+  constexpr uint8_t MAX_BANDS = 16;
+
+  struct options {
+    std::string wav;
+    uint32_t rate = 48000;
+    uint16_t channels = 2;
+    uint8_t bands = MAX_BANDS;
+    uint32_t fft_size = 2048;
+    uint32_t fps = 60;
+  };
+
+  // Interleaved 16-bit PCM or 32-bit float, mixed down to mono
+  class Source {
+  public:
+    bool open_stdin(const options &opts) {
+      file = stdin;
+      rate = opts.rate;
+      channels = opts.channels;
+      float_samples = false;
+      return true;
+    }
+
+    bool open_wav(const std::string &path) {
+      file = std::fopen(path.c_str(), "rb");
+      if (!file) {
+        std::fprintf(stderr, "Can't open %s\n", path.c_str());
+        return false;
+      }
+
+      char riff[12];
+      if (std::fread(riff, 1, sizeof(riff), file) != sizeof(riff) ||
+          std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        std::fprintf(stderr, "%s isn't a WAV file\n", path.c_str());
+        return false;
+      }
+
+      bool have_format = false;
+      while (true) {
+        char id[4];
+        uint32_t size;
+        if (std::fread(id, 1, 4, file) != 4 || std::fread(&size, 4, 1, file) != 1) {
+          std::fprintf(stderr, "%s has no audio data\n", path.c_str());
+          return false;
+        }
+
+        if (std::memcmp(id, "fmt ", 4) == 0) {
+          uint8_t fmt[16];
+          if (size < sizeof(fmt) || std::fread(fmt, 1, sizeof(fmt), file) != sizeof(fmt)) {
+            return false;
+          }
+          std::fseek(file, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+
+          const uint16_t format = fmt[0] | fmt[1] << 8;
+          channels = fmt[2] | fmt[3] << 8;
+          rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | static_cast<uint32_t>(fmt[7]) << 24;
+          const uint16_t bits = fmt[14] | fmt[15] << 8;
+          float_samples = format == 3 && bits == 32;
+          if (!(float_samples || (format == 1 && bits == 16)) || channels == 0) {
+            std::fprintf(stderr, "Only 16-bit PCM and 32-bit float WAV files are supported\n");
+            return false;
+          }
+          have_format = true;
+        } else if (std::memcmp(id, "data", 4) == 0) {
+          return have_format;
+        } else {
+          std::fseek(file, size + (size & 1), SEEK_CUR);
+        }
+      }
+    }
+
+    // Returns the number of mono samples read, 0 at the end of the stream
+    size_t read(float* out, const size_t n) {
+      const size_t sample_size = float_samples ? 4 : 2;
+      buffer.resize(n * channels * sample_size);
+      const size_t frames = std::fread(buffer.data(), sample_size * channels, n, file);
+
+      for (size_t i = 0; i < frames; i++) {
+        float sum = 0;
+        for (uint16_t c = 0; c < channels; c++) {
+          const uint8_t* sample = &buffer[(i * channels + c) * sample_size];
+          if (float_samples) {
+            float f;
+            std::memcpy(&f, sample, sizeof(f));
+            sum += f;
+          } else {
+            sum += static_cast<int16_t>(sample[0] | sample[1] << 8) / 32768.0f;
+          }
+        }
+        out[i] = sum / channels;
+      }
+      return frames;
+    }
+
+    uint32_t rate = 0;
+    uint16_t channels = 0;
+
+  private:
+    FILE* file = nullptr;
+    bool float_samples = false;
+    std::vector<uint8_t> buffer;
+  };
+
+  hid_device* open_board() {
+    hid_device* device = nullptr;
+    hid_device_info* devices = hid_enumerate(BEEF_VID, BEEF_PID);
+    for (auto d = devices; d; d = d->next) {
+      if (d->interface_number == LIGHTS_INTERFACE) {
+        device = hid_open_path(d->path);
+        break;
+      }
+    }
+    hid_free_enumeration(devices);
+    return device;
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: beef-spectrum [--wav file] [--rate hz] [--channels n]\n"
+                 "                     [--bands n] [--fft size] [--fps n]\n"
+                 "Without --wav, reads 16-bit little endian PCM from stdin\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const char* value = argv[++i];
+
+      if (arg == "--wav") {
+        opts.wav = value;
+      } else if (arg == "--rate") {
+        opts.rate = std::atoi(value);
+      } else if (arg == "--channels") {
+        opts.channels = std::atoi(value);
+      } else if (arg == "--bands") {
+        opts.bands = std::atoi(value);
+      } else if (arg == "--fft") {
+        opts.fft_size = std::atoi(value);
+      } else if (arg == "--fps") {
+        opts.fps = std::atoi(value);
+      } else {
+        return false;
+      }
+    }
+
+    return opts.rate > 0 && opts.channels > 0 && opts.fps > 0 &&
+      opts.bands > 0 && opts.bands <= MAX_BANDS;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  Source source;
+  const bool realtime = !opts.wav.empty();
+  if (!(realtime ? source.open_wav(opts.wav) : source.open_stdin(opts))) {
+    return 1;
+  }
+
+  Spectrum::settings settings;
+  settings.sample_rate = source.rate;
+  settings.fft_size = opts.fft_size;
+  settings.bands = opts.bands;
+  settings.max_hz = std::min(settings.max_hz, source.rate / 2.0f);
+  Spectrum::Analyser analyser(settings);
+
+  if (hid_init() != 0) {
+    std::fprintf(stderr, "Failed to start hidapi\n");
+    return 1;
+  }
+  hid_device* board = open_board();
+  if (!board) {
+    std::fprintf(stderr, "Beef Board not found\n");
+    return 1;
+  }
+
+  // Only analyse once per report, on the most recent window of audio,
+  // which keeps this to a few dozen small FFTs a second
+  const size_t hop = std::max<size_t>(source.rate / opts.fps, 1);
+  std::vector<float> history(analyser.window_size());
+  std::vector<float> block(hop);
+
+  uint8_t report[REPORT_SIZE + 1] = {};
+  uint8_t last_levels[MAX_BANDS] = {};
+  uint8_t sequence = 0;
+
+  auto next_frame = std::chrono::steady_clock::now();
+  while (true) {
+    const size_t n = source.read(block.data(), hop);
+    if (n == 0) {
+      break;
+    }
+
+    const size_t keep = history.size() > n ? history.size() - n : 0;
+    std::copy(history.end() - keep, history.end(), history.begin());
+    std::copy(block.begin() + (n - (history.size() - keep)), block.begin() + n,
+              history.begin() + keep);
+
+    uint8_t* const levels = &report[1 + HEADER_SIZE];
+    analyser.analyse(history.data(), levels);
+
+    // Silence is silence, the board decays the bars on its own
+    if (std::memcmp(levels, last_levels, opts.bands) != 0) {
+      std::memcpy(last_levels, levels, opts.bands);
+
+      // report[0] is the report ID, the lights interface doesn't use them
+      report[1] = PROTOCOL_VERSION;
+      report[2] = FLAG_SPECTRUM;
+      report[3] = sequence++;
+      report[4] = 0;
+      report[5] = opts.bands;
+      if (hid_write(board, report, sizeof(report)) < 0) {
+        std::fprintf(stderr, "Failed to send to Beef Board: %ls\n", hid_error(board));
+        break;
+      }
+    }
+
+    // Files are played back in real time, streams are paced by whoever is writing to us
+    if (realtime) {
+      next_frame += std::chrono::microseconds(1000000ull * n / source.rate);
+      std::this_thread::sleep_until(next_frame);
+    }
+  }
+
+  hid_close(board);
+  hid_exit();
+  return 0;
+}
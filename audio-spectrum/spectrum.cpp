@@ -0,0 +1,50 @@
+#include "spectrum.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Spectrum {
+  Analyser::Analyser(const settings &s) :
+    s(s), fft(s.fft_size),
+    window(s.fft_size), windowed(s.fft_size), power(s.fft_size / 2 + 1),
+    band_edges(s.bands + 1) {
+    // Hann window
+    for (uint32_t i = 0; i < s.fft_size; i++) {
+      window[i] = 0.5f - 0.5f * std::cos(2 * M_PI * i / s.fft_size);
+    }
+
+    // A full scale sine peaks at n/4 after the Hann window
+    const float peak = s.fft_size / 4.0f;
+    normalise = 1 / (peak * peak);
+
+    const float bin_hz = static_cast<float>(s.sample_rate) / s.fft_size;
+    const uint32_t last_bin = s.fft_size / 2;
+    for (uint32_t b = 0; b <= s.bands; b++) {
+      const float hz = s.min_hz * std::pow(s.max_hz / s.min_hz, static_cast<float>(b) / s.bands);
+      band_edges[b] = std::min(static_cast<uint32_t>(std::lround(hz / bin_hz)), last_bin);
+    }
+    // Low bands can be narrower than a bin, give each one at least one bin of its own
+    for (uint32_t b = 1; b <= s.bands; b++) {
+      band_edges[b] = std::min(std::max(band_edges[b], band_edges[b - 1] + 1), last_bin + 1);
+    }
+  }
+
+  void Analyser::analyse(const float* samples, uint8_t* levels) {
+    for (uint32_t i = 0; i < s.fft_size; i++) {
+      windowed[i] = samples[i] * window[i];
+    }
+    fft.power(windowed.data(), power.data());
+
+    for (uint8_t b = 0; b < s.bands; b++) {
+      // Loudest bin rather than the sum, so wide treble bands don't swamp the bass
+      float loudest = 0;
+      for (uint32_t k = band_edges[b]; k < band_edges[b + 1]; k++) {
+        loudest = std::max(loudest, power[k]);
+      }
+
+      const float db = 10 * std::log10(loudest * normalise + 1e-12f);
+      const float level = 255 * (1 - db / s.floor_db);
+      levels[b] = static_cast<uint8_t>(std::clamp(level, 0.0f, 255.0f));
+    }
+  }
+}
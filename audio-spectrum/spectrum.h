@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "fft.h"
+
+namespace Spectrum {
+  struct settings {
+    uint32_t sample_rate = 48000;
+    uint32_t fft_size = 2048;
+    uint8_t bands = 16;
+    float min_hz = 50;
+    float max_hz = 16000;
+    // Levels map floor_db..0dB onto 0..255, 0dB being a full scale sine
+    float floor_db = -60;
+  };
+
+  // Turns the latest fft_size mono samples into log spaced band levels
+  class Analyser {
+  public:
+    explicit Analyser(const settings &s);
+
+    uint32_t window_size() const { return fft.size(); }
+
+    // samples holds window_size() samples, oldest first
+    void analyse(const float* samples, uint8_t* levels);
+
+  private:
+    settings s;
+    Fft::RealFft fft;
+    std::vector<float> window;
+    std::vector<float> windowed;
+    std::vector<float> power;
+    // First bin of each band, with one past the last band's end at the back
+    std::vector<uint32_t> band_edges;
+    float normalise;
+  };
+}
@@ -1,6 +1,6 @@
 import { ReportId } from '$lib/types/hid';
 import { appState } from '$lib/types/state.svelte';
-import { TurntableMode, BarMode, ControllerType, InputMode, Hsv, numberToTurntableMode, numberToBarMode, numberToControllerType, numberToInputMode, turntableModeToNumber, barModeToNumber, controllerTypeToNumber, inputModeToNumber } from '$lib/types/types.svelte';
+import { TurntableMode, BarMode, ControllerType, InputMode, Hsv, LedLayout, numberToTurntableMode, numberToBarMode, numberToControllerType, numberToInputMode, turntableModeToNumber, barModeToNumber, controllerTypeToNumber, inputModeToNumber } from '$lib/types/types.svelte';
 import * as HIDCodes from '$lib/types/hid-codes';
 
 const packetSize = 1024;
@@ -86,6 +86,11 @@ export class Config {
   led_refresh = $state(0);
   rainbow_spin_speed = $state(0);
   tt_leds = $state(0);
+  tt_layout = $state(new LedLayout(0, 0, 1));
+  bar_layout = $state(new LedLayout(0, 0, 1));
+  debounce_auto = $state(false);
+  knob_min_cutoff = $state(0);
+  knob_beta = $state(0);
 
   constructor(configData: DataView) {
     this.version = configData.getUint8(0);
@@ -189,6 +194,28 @@ export class Config {
       this.rainbow_spin_speed = configData.getUint8(offset++);
       this.tt_leds = configData.getUint8(offset++);
     }
+
+    if (this.version >= 17) {
+      this.tt_layout = new LedLayout(
+        configData.getUint8(offset++),
+        configData.getUint8(offset++),
+        configData.getUint8(offset++)
+      );
+      this.bar_layout = new LedLayout(
+        configData.getUint8(offset++),
+        configData.getUint8(offset++),
+        configData.getUint8(offset++)
+      );
+    }
+
+    if (this.version >= 18) {
+      this.debounce_auto = configData.getUint8(offset++) as unknown as boolean;
+    }
+
+    if (this.version >= 19) {
+      this.knob_min_cutoff = configData.getUint8(offset++);
+      this.knob_beta = configData.getUint8(offset++);
+    }
   }
 }
 
@@ -319,6 +346,21 @@ export async function updateConfig(config: Config): Promise<void> {
       configView.setUint8(offset++, config.tt_leds);
     }
 
+    if (config.version >= 17) {
+      for (const value of [...config.tt_layout.toHid(), ...config.bar_layout.toHid()]) {
+        configView.setUint8(offset++, value);
+      }
+    }
+
+    if (config.version >= 18) {
+      configView.setUint8(offset++, Number(config.debounce_auto));
+    }
+
+    if (config.version >= 19) {
+      configView.setUint8(offset++, config.knob_min_cutoff);
+      configView.setUint8(offset++, config.knob_beta);
+    }
+
     const data = new Uint8Array(configBuffer);
     await appState.device.sendFeatureReport(ReportId.Config, data);
   } catch (err) {
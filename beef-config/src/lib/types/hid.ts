@@ -1,14 +1,19 @@
 import { appState, onDisconnect, connectDevice } from '$lib/types/state.svelte';
+import { LightingSlot, MAX_PROGRAM_SIZE } from '$lib/types/lighting-program';
 
 export enum ReportId {
   Config = 1,
   Command = 2,
-  FirmwareVersion = 3
+  FirmwareVersion = 3,
+  LightingProgram = 4,
+  Tempo = 5,
+  Chatter = 8
 }
 
 export enum Command {
   Bootloader = 1,
-  ResetConfig = 2
+  ResetConfig = 2,
+  CalibrateTurntable = 3
 }
 
 export async function waitForReconnection(): Promise<void> {
@@ -53,6 +58,92 @@ export async function readCommitHash(): Promise<string> {
   }
 }
 
+export interface Tempo {
+  bpm: number; // 0 when the board hasn't locked on to a tempo
+  confidence: number; // 0-1
+}
+
+export async function readTempo(): Promise<Tempo> {
+  if (!appState.device) {
+    throw new Error('Device not connected');
+  }
+
+  try {
+    const result = await appState.device.receiveFeatureReport(ReportId.Tempo);
+    const tempoData = new DataView(result.buffer.slice(1)); // Skip report id
+    return {
+      bpm: tempoData.getUint16(0, true) / 10,
+      confidence: tempoData.getUint8(2) / 255
+    };
+  } catch (err) {
+    throw new Error('Failed to read tempo', { cause: err });
+  }
+}
+
+export interface ButtonChatter {
+  presses: number;
+  bounces: number;
+  longestBounce: number; // ms
+  shortestGap: number | undefined; // ms, undefined when there hasn't been one under 255 ms
+  autoWindow: number; // ms
+}
+
+const CHATTER_STATS_SIZE = 7;
+
+export async function readChatter(): Promise<ButtonChatter[]> {
+  if (!appState.device) {
+    throw new Error('Device not connected');
+  }
+
+  try {
+    const result = await appState.device.receiveFeatureReport(ReportId.Chatter);
+    const chatterData = new DataView(result.buffer.slice(1)); // Skip report id
+    const buttons: ButtonChatter[] = [];
+    for (let i = 0; i < chatterData.getUint8(1); i++) {
+      const offset = 2 + i * CHATTER_STATS_SIZE;
+      const shortestGap = chatterData.getUint8(offset + 5);
+      buttons.push({
+        presses: chatterData.getUint16(offset, true),
+        bounces: chatterData.getUint16(offset + 2, true),
+        longestBounce: chatterData.getUint8(offset + 4),
+        shortestGap: shortestGap === 255 ? undefined : shortestGap,
+        autoWindow: chatterData.getUint8(offset + 6)
+      });
+    }
+    return buttons;
+  } catch (err) {
+    throw new Error('Failed to read button chatter', { cause: err });
+  }
+}
+
+export async function resetChatter(): Promise<void> {
+  if (!appState.device) {
+    throw new Error('Device not connected');
+  }
+
+  try {
+    await appState.device.sendFeatureReport(ReportId.Chatter, new Uint8Array([0]));
+  } catch (err) {
+    throw new Error('Failed to reset button chatter', { cause: err });
+  }
+}
+
+export async function uploadLightingProgram(slot: LightingSlot, program: Uint8Array): Promise<void> {
+  if (!appState.device) {
+    throw new Error('Device not connected');
+  }
+
+  try {
+    const data = new Uint8Array(2 + MAX_PROGRAM_SIZE);
+    data[0] = slot;
+    data[1] = program.length;
+    data.set(program, 2);
+    await appState.device.sendFeatureReport(ReportId.LightingProgram, data);
+  } catch (err) {
+    throw new Error('Failed to upload lighting program, is it too long for the number of LEDs?', { cause: err });
+  }
+}
+
 export async function sendCommand(command: Command): Promise<void> {
   if (!appState.device) {
     throw new Error('Device not connected');
@@ -0,0 +1,131 @@
+// Assembler for lighting programs, see fw/lighting_program.h for what each op does.
+//
+// Programs are written one op per token, with # comments and labels for forward jumps:
+//
+//   pos ttpos add    # hue follows the turntable
+//   push 255         # saturation
+//   button 0 jz dim  # full brightness while button 1 is held
+//   push 255 hsv end
+//   dim: push 64 hsv
+
+export enum LightingSlot {
+  Turntable = 0,
+  Bar = 1
+}
+
+export const MAX_PROGRAM_SIZE = 64;
+export const OP_BUDGET = 256;
+
+const ops: { [name: string]: { code: number; imm: boolean } } = {
+  end: { code: 0, imm: false },
+  push: { code: 1, imm: true },
+  led: { code: 2, imm: false },
+  leds: { code: 3, imm: false },
+  pos: { code: 4, imm: false },
+  time: { code: 5, imm: true },
+  ttvelocity: { code: 6, imm: false },
+  ttpos: { code: 7, imm: false },
+  button: { code: 8, imm: true },
+  dup: { code: 9, imm: false },
+  swap: { code: 10, imm: false },
+  drop: { code: 11, imm: false },
+  add: { code: 12, imm: false },
+  sub: { code: 13, imm: false },
+  addsat: { code: 14, imm: false },
+  subsat: { code: 15, imm: false },
+  mul: { code: 16, imm: false },
+  mod: { code: 17, imm: false },
+  min: { code: 18, imm: false },
+  max: { code: 19, imm: false },
+  sin: { code: 20, imm: false },
+  tri: { code: 21, imm: false },
+  lt: { code: 22, imm: false },
+  eq: { code: 23, imm: false },
+  jz: { code: 24, imm: true },
+  jmp: { code: 25, imm: true },
+  hsv: { code: 26, imm: false },
+  rgb: { code: 27, imm: false }
+};
+
+export class CompileError extends Error {
+  constructor(line: number, message: string) {
+    super(`Line ${line}: ${message}`);
+  }
+}
+
+export function compileLightingProgram(source: string): Uint8Array {
+  const code: number[] = [];
+  const labels = new Map<string, number>();
+  // Jump immediates to patch once labels are known
+  const fixups: { at: number; label: string; line: number }[] = [];
+
+  const lines = source.split('\n');
+  for (let i = 0; i < lines.length; i++) {
+    const line = i + 1;
+    const tokens = lines[i].split('#')[0].trim().split(/\s+/).filter((t) => t.length > 0);
+
+    for (let t = 0; t < tokens.length; t++) {
+      const token = tokens[t].toLowerCase();
+      if (token.endsWith(':')) {
+        labels.set(token.slice(0, -1), code.length);
+        continue;
+      }
+
+      const op = ops[token];
+      if (!op) {
+        throw new CompileError(line, `Unknown op "${tokens[t]}"`);
+      }
+      code.push(op.code);
+      if (!op.imm) {
+        continue;
+      }
+
+      const arg = tokens[++t];
+      if (arg === undefined) {
+        throw new CompileError(line, `"${token}" needs a value`);
+      }
+
+      if (token === 'jz' || token === 'jmp') {
+        fixups.push({ at: code.length, label: arg.toLowerCase(), line });
+        code.push(0);
+        continue;
+      }
+
+      const value = Number(arg);
+      if (!Number.isInteger(value) || value < 0 || value > 255) {
+        throw new CompileError(line, `"${arg}" must be a number from 0 to 255`);
+      }
+      code.push(value);
+    }
+  }
+
+  for (const fixup of fixups) {
+    const target = labels.get(fixup.label);
+    if (target === undefined) {
+      throw new CompileError(fixup.line, `Unknown label "${fixup.label}"`);
+    }
+    // Relative to the op after the jump, and only forwards
+    const offset = target - (fixup.at + 1);
+    if (offset < 0) {
+      throw new CompileError(fixup.line, `Jumps can only go forwards`);
+    }
+    code[fixup.at] = offset;
+  }
+
+  if (code.length > MAX_PROGRAM_SIZE) {
+    throw new Error(`Program is ${code.length} bytes, the limit is ${MAX_PROGRAM_SIZE}`);
+  }
+
+  return new Uint8Array(code);
+}
+
+// Worst case ops run per frame, the board rejects programs over OP_BUDGET.
+// Jumps only go forwards, so each op runs at most once per LED
+export function lightingProgramCost(program: Uint8Array, numLeds: number): number {
+  const withImm = new Set(Object.values(ops).filter((op) => op.imm).map((op) => op.code));
+  let count = 0;
+  for (let pc = 0; pc < program.length; pc += withImm.has(program[pc]) ? 2 : 1) {
+    count++;
+  }
+  return count * numLeds;
+}
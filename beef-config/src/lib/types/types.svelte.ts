@@ -10,16 +10,20 @@ export enum TurntableMode {
   Reactive = 'Reactive',
   Breathing = 'Breathing',
   HID = 'HID',
-  Off = 'Off'
+  Off = 'Off',
+  Custom = 'Custom'
 }
 
 export enum BarMode {
+  Beat = 'Beat',
   KeySpectrumP1 = 'Key Spectrum (P1)',
   KeySpectrumP2 = 'Key Spectrum (P2)',
+  AudioSpectrum = 'Audio Spectrum',
   HID = 'HID',
   TapeLedP1 = 'Tape LED (P1)',
   TapeLedP2 = 'Tape LED (P2)',
-  Off = 'Off'
+  Off = 'Off',
+  Custom = 'Custom'
 }
 
 export enum ControllerType {
@@ -43,7 +47,8 @@ export const turntableModeToNumber: { [key in TurntableMode]: number } = {
   [TurntableMode.Reactive]: 6,
   [TurntableMode.Breathing]: 7,
   [TurntableMode.HID]: 8,
-  [TurntableMode.Off]: 9
+  [TurntableMode.Off]: 9,
+  [TurntableMode.Custom]: 10
 };
 
 export const numberToTurntableMode: { [key: number]: TurntableMode } = Object.fromEntries(
@@ -51,12 +56,15 @@ export const numberToTurntableMode: { [key: number]: TurntableMode } = Object.fr
 );
 
 export const barModeToNumber: { [key in BarMode]: number } = {
+  [BarMode.Beat]: 0,
   [BarMode.KeySpectrumP1]: 1,
   [BarMode.KeySpectrumP2]: 2,
+  [BarMode.AudioSpectrum]: 3,
   [BarMode.HID]: 4,
   [BarMode.TapeLedP1]: 5,
   [BarMode.TapeLedP2]: 6,
-  [BarMode.Off]: 7
+  [BarMode.Off]: 7,
+  [BarMode.Custom]: 8
 };
 
 export const numberToBarMode: { [key: number]: BarMode } = Object.fromEntries(
@@ -102,3 +110,25 @@ export class Hsv {
     return [(this.h * 255) / 360, (this.s * 255) / 100, (this.v * 255) / 100];
   }
 }
+
+const LED_LAYOUT_REVERSE = 1 << 0;
+const LED_LAYOUT_MIRROR = 1 << 1;
+
+export class LedLayout {
+  offset = $state(0);
+  reverse = $state(false);
+  mirror = $state(false);
+  segments = $state(1);
+
+  constructor(offset: number, flags: number, segments: number) {
+    this.offset = offset;
+    this.reverse = (flags & LED_LAYOUT_REVERSE) !== 0;
+    this.mirror = (flags & LED_LAYOUT_MIRROR) !== 0;
+    this.segments = segments;
+  }
+
+  toHid(): [number, number, number] {
+    const flags = (this.reverse ? LED_LAYOUT_REVERSE : 0) | (this.mirror ? LED_LAYOUT_MIRROR : 0);
+    return [this.offset, flags, this.segments];
+  }
+}
@@ -100,6 +100,12 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
           Address = &ConfigurationDescriptor->HID_LightsID;
           Size    = sizeof(USB_HID_Descriptor_HID_t);
           break;
+#if TELEMETRY
+        case INTERFACE_ID_Telemetry:
+          Address = &ConfigurationDescriptor->HID_TelemetryHID;
+          Size    = sizeof(USB_HID_Descriptor_HID_t);
+          break;
+#endif
         default:
           break;
       }
@@ -129,6 +135,12 @@ uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
             Size    = SizeOfLightsHIDReport;
           }
           break;
+#if TELEMETRY
+        case INTERFACE_ID_Telemetry:
+          Address = &TelemetryHIDReport;
+          Size    = sizeof(TelemetryHIDReport);
+          break;
+#endif
         default:
           break;
       }
@@ -3,7 +3,13 @@
 #include <avr/pgmspace.h>
 #include <LUFA/Drivers/USB/USB.h>
 
+#include "chatter.h"
 #include "config.h"
+#include "latency.h"
+#include "lighting_program.h"
+#include "telemetry.h"
+#include "tempo.h"
+#include "trace.h"
 
 #define LedStringBase 0x10
 
@@ -44,6 +50,21 @@ HID_RI_COLLECTION(8, 0x02), \
   HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
 HID_RI_END_COLLECTION(0)
 
+// 8-bit brightness variant of HID_BUTTON_LIGHT, for BUTTON_LIGHT_LEVELS builds
+#define HID_BUTTON_LIGHT_LEVEL(Number) \
+HID_RI_USAGE_PAGE(8, 0x0A), \
+HID_RI_USAGE(8, Number), \
+HID_RI_COLLECTION(8, 0x02), \
+  HID_RI_USAGE_PAGE(8, 0x09), \
+  HID_RI_USAGE(8, Number), \
+  HID_RI_STRING_INDEX(8, LedStringBase+Number), \
+  HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+  HID_RI_LOGICAL_MAXIMUM(16, 0xFF), \
+  HID_RI_REPORT_SIZE(8, 0x08), \
+  HID_RI_REPORT_COUNT(8, 0x01), \
+  HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
+HID_RI_END_COLLECTION(0)
+
 #define HID_RGB(Number) \
 HID_RI_LOGICAL_MINIMUM(8, 0x00), \
 HID_RI_LOGICAL_MAXIMUM(8, 0xFF), \
@@ -76,6 +97,28 @@ HID_RI_COLLECTION(8, 0x02), \
   HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
 HID_RI_END_COLLECTION(0)
 
+// Vendor defined frame sequence number at the end of the joystick OUT report,
+// for LATENCY_PROBE builds
+#define HID_LIGHTS_SEQUENCE \
+HID_RI_USAGE_PAGE(16, 0xFFEB), \
+HID_RI_USAGE(8, 0x10), \
+HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+HID_RI_LOGICAL_MAXIMUM(16, 0xFF), \
+HID_RI_REPORT_SIZE(8, 0x08), \
+HID_RI_REPORT_COUNT(8, 0x01), \
+HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+// The last HID_LIGHTS_SEQUENCE received, echoed at the end of the joystick IN
+// report so the host can time OUT to IN round trips, for LATENCY_PROBE builds
+#define HID_INPUT_SEQUENCE \
+HID_RI_USAGE_PAGE(16, 0xFFEB), \
+HID_RI_USAGE(8, 0x11), \
+HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+HID_RI_LOGICAL_MAXIMUM(16, 0xFF), \
+HID_RI_REPORT_SIZE(8, 0x08), \
+HID_RI_REPORT_COUNT(8, 0x01), \
+HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
 // Type define for the device configuration descriptor structure. This
 // must be defined in the application code, as the configuration
 // descriptor contains several sub-descriptors which vary between
@@ -106,6 +149,12 @@ typedef struct {
   USB_Descriptor_Interface_t HID_LightsInterface;
   USB_HID_Descriptor_HID_t HID_LightsID;
   USB_Descriptor_Endpoint_t HID_LightsReportOUTEndpoint;
+
+#if TELEMETRY
+  USB_Descriptor_Interface_t HID_TelemetryInterface;
+  USB_HID_Descriptor_HID_t HID_TelemetryHID;
+  USB_Descriptor_Endpoint_t HID_TelemetryReportINEndpoint;
+#endif
 } USB_Descriptor_Configuration_t;
 
 // HID class report descriptor. This is a special descriptor
@@ -134,6 +183,7 @@ enum InterfaceDescriptors_t {
   INTERFACE_ID_Mouse    = 2, /**< Mouse interface descriptor ID */
   INTERFACE_ID_Config   = 3, /**< Config interface descriptor ID */
   INTERFACE_ID_Lights   = 4, /**< Lights interface descriptor ID */
+  INTERFACE_ID_Telemetry = 5, /**< Telemetry interface descriptor ID, TELEMETRY builds only */
 };
 
 // Enum for the device string descriptor IDs within the device. Each
@@ -152,7 +202,13 @@ enum {
 enum {
   HID_REPORTID_Config = 0x01,
   HID_REPORTID_Command = 0x02,
-  HID_REPORTID_FirmwareVersion = 0x03
+  HID_REPORTID_FirmwareVersion = 0x03,
+  HID_REPORTID_LightingProgram = 0x04,
+  HID_REPORTID_Tempo = 0x05,
+  HID_REPORTID_Latency = 0x06,
+  HID_REPORTID_Trace = 0x07,
+  HID_REPORTID_Chatter = 0x08,
+  HID_REPORTID_Latched = 0x09
 };
 
 const USB_Descriptor_HIDReport_Datatype_t PROGMEM KeyboardHIDReport[] = {
@@ -212,8 +268,61 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM ConfigHIDReport[] {
     HID_RI_REPORT_COUNT(8, sizeof(uint32_t)),
     HID_RI_REPORT_SIZE(8, 0x08),
     HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+    HID_RI_REPORT_ID(8, HID_REPORTID_LightingProgram),
+    HID_RI_USAGE(8, 0x04),
+    HID_RI_REPORT_COUNT(8, sizeof(LightingProgram::program_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+    HID_RI_REPORT_ID(8, HID_REPORTID_Tempo),
+    HID_RI_USAGE(8, 0x05),
+    HID_RI_REPORT_COUNT(8, sizeof(Tempo::tempo_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+    HID_RI_REPORT_ID(8, HID_REPORTID_Latency),
+    HID_RI_USAGE(8, 0x06),
+    HID_RI_REPORT_COUNT(8, sizeof(Latency::latency_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+    HID_RI_REPORT_ID(8, HID_REPORTID_Latched),
+    HID_RI_USAGE(8, 0x09),
+    HID_RI_REPORT_COUNT(8, sizeof(Latency::latched_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+    HID_RI_REPORT_ID(8, HID_REPORTID_Chatter),
+    HID_RI_USAGE(8, 0x08),
+    HID_RI_REPORT_COUNT(8, sizeof(Chatter::chatter_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+
+#if INPUT_TRACE
+    HID_RI_REPORT_ID(8, HID_REPORTID_Trace),
+    HID_RI_USAGE(8, 0x07),
+    HID_RI_REPORT_COUNT(8, sizeof(Trace::trace_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_FEATURE(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+#endif
+  HID_RI_END_COLLECTION(0)
+};
+
+#if TELEMETRY
+const USB_Descriptor_HIDReport_Datatype_t PROGMEM TelemetryHIDReport[] {
+  HID_RI_USAGE_PAGE(16, 0xFFEB),
+  HID_RI_USAGE(8, 0x03),
+  HID_RI_LOGICAL_MINIMUM(8, 0x00),
+  HID_RI_LOGICAL_MAXIMUM(16, 0xFF),
+  HID_RI_COLLECTION(8, 0x01),
+    HID_RI_USAGE(8, 0x01),
+    HID_RI_REPORT_COUNT(8, sizeof(Telemetry::telemetry_report)),
+    HID_RI_REPORT_SIZE(8, 0x08),
+    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
   HID_RI_END_COLLECTION(0)
 };
+#endif
 
 // Device descriptor structure. This descriptor, located in FLASH
 // memory, describes the overall device characteristics, including the
@@ -253,6 +362,9 @@ constexpr USB_Descriptor_Device_t generate_device_descriptor(uint16_t vid, uint1
 // Endpoint address of tape LED data HID reporting OUT endpoint
 #define LIGHTS_OUT_EPADDR (ENDPOINT_DIR_OUT | 5)
 
+// Endpoint address of the telemetry HID reporting IN endpoint
+#define TELEMETRY_IN_EPADDR (ENDPOINT_DIR_IN | 6)
+
 // Size of Hid reporting IN/OUT endpoint in bytes
 #define HID_EPSIZE FIXED_CONTROL_ENDPOINT_SIZE
 
@@ -268,10 +380,10 @@ constexpr USB_Descriptor_Configuration_t generate_configuration_descriptor(const
     .Config = {
       .Header = {.Size = sizeof(USB_Descriptor_Configuration_Header_t), .Type = DTYPE_Configuration},
       .TotalConfigurationSize = sizeof(USB_Descriptor_Configuration_t),
-      .TotalInterfaces = 5,
+      .TotalInterfaces = TELEMETRY ? 6 : 5,
       .ConfigurationNumber = 1,
       .ConfigurationStrIndex = NO_DESCRIPTOR,
-      .ConfigAttributes = (USB_CONFIG_ATTR_RESERVED | USB_CONFIG_ATTR_SELFPOWERED),
+      .ConfigAttributes = (USB_CONFIG_ATTR_RESERVED | USB_CONFIG_ATTR_SELFPOWERED | USB_CONFIG_ATTR_REMOTEWAKEUP),
       .MaxPowerConsumption = USB_CONFIG_POWER_MA(500)
     },
     .HID_JoystickInterface = {
@@ -398,6 +510,33 @@ constexpr USB_Descriptor_Configuration_t generate_configuration_descriptor(const
       .Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
       .EndpointSize = HID_EPSIZE,
       .PollingIntervalMS = 0x01
+    },
+#if TELEMETRY
+    .HID_TelemetryInterface = {
+      .Header = {.Size = sizeof(USB_Descriptor_Interface_t), .Type = DTYPE_Interface},
+      .InterfaceNumber = INTERFACE_ID_Telemetry,
+      .AlternateSetting = 0x00,
+      .TotalEndpoints = 1,
+      .Class = HID_CSCP_HIDClass,
+      .SubClass = HID_CSCP_NonBootSubclass,
+      .Protocol = HID_CSCP_NonBootProtocol,
+      .InterfaceStrIndex = NO_DESCRIPTOR
+    },
+    .HID_TelemetryHID = {
+      .Header = {.Size = sizeof(USB_HID_Descriptor_HID_t), .Type = HID_DTYPE_HID},
+      .HIDSpec = VERSION_BCD(1,1,1),
+      .CountryCode = 0x00,
+      .TotalReportDescriptors = 1,
+      .HIDReportType = HID_DTYPE_Report,
+      .HIDReportLength = sizeof(TelemetryHIDReport)
+    },
+    .HID_TelemetryReportINEndpoint = {
+      .Header = {.Size = sizeof(USB_Descriptor_Endpoint_t), .Type = DTYPE_Endpoint},
+      .EndpointAddress = TELEMETRY_IN_EPADDR,
+      .Attributes = (EP_TYPE_INTERRUPT | ENDPOINT_ATTR_NO_SYNC | ENDPOINT_USAGE_DATA),
+      .EndpointSize = HID_EPSIZE,
+      .PollingIntervalMS = 0x01
     }
+#endif
   };
 }
@@ -6,7 +6,7 @@ public:
   virtual uint8_t get() const = 0;
 };
 
-class AnalogAxis : public Axis {
+class AnalogAxis final : public Axis {
 public:
   explicit AnalogAxis(uint8_t pin);
 
@@ -18,7 +18,7 @@ private:
   uint8_t position{};
 };
 
-class QeAxis : public Axis {
+class QeAxis final : public Axis {
 public:
   QeAxis(volatile uint8_t* PIN, uint8_t a_pin, uint8_t b_pin);
 
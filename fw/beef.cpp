@@ -1,6 +1,7 @@
 #include <avr/wdt.h>
 #include <avr/power.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include <LUFA/Common/Common.h>
 #include <LUFA/Drivers/USB/USB.h>
@@ -11,29 +12,52 @@
 
 #include "axis.h"
 #include "beef.h"
+#include "button_lights.h"
+#include "chatter.h"
 #include "combo.h"
 #include "config.h"
+#include "latency.h"
+#include "lighting_program.h"
 #include "pin.h"
 #include "rgb_helper.h"
+#include "telemetry.h"
+#include "tempo.h"
+#include "trace.h"
+#include "tt_calibration.h"
 
 // bit-field storing button state. bits 0-10 map to buttons 1-11
 // bits 11 and 12 map to digital tt -/+
 uint16_t button_state;
 // Ignore button inputs after startup so that we don't send keycodes after holding a boot combo
 bool ignore_buttons;
-AbstractUsbHandler* usb_handler;
+ControllerUsbHandler* usb_handler;
 button_pins buttons[] = CONFIG_ALL_HW_PIN;
 Command current_command;
 volatile bool sleep;
+// Set by a button press while suspended, to wake the host back up
+volatile bool remote_wakeup;
 
 bool run_bootloader ATTR_NO_INIT;
 
 HidReport<config, INTERFACE_ID_Config, ENDPOINT_CONTROLEP> config_hid_report;
+#if TELEMETRY
+HidReport<Telemetry::telemetry_report, INTERFACE_ID_Telemetry, TELEMETRY_IN_EPADDR> telemetry_hid_report;
+#endif
 
 ISR(TIMER1_COMPA_vect) {
   milliseconds++;
 }
 
+// Wake-up sources while suspended
+// Only buttons wired to INTn/PCINTn pins can wake the chip from power-down:
+// B2 (PB6/PCINT6), B4 (PD2/INT2), B5 (PD0/INT0), B7 (PB4/PCINT4)
+ISR(INT0_vect) {
+  remote_wakeup = true;
+}
+
+ISR(INT2_vect, ISR_ALIASOF(INT0_vect));
+ISR(PCINT0_vect, ISR_ALIASOF(INT0_vect));
+
 void application_jump_check() {
   // Check if the reset source was from the watchdog
   // and if we received a command/button combo to reset to bootloader
@@ -77,32 +101,105 @@ void handle_command() {
       // TODO: find out why device re-enumeration doesn't work
       reboot();
       break;
+    case Command::CalibrateTurntable:
+#if CONTROLLER_HAS_IIDX
+      TtCalibration::start();
+#endif
+      current_command = Command::None;
+      break;
+  }
+}
+
+void enable_button_wakeup() {
+  // Any logical change on INT0/INT2, these are detected asynchronously
+  EICRA = (EICRA & ~((1 << ISC01) | (1 << ISC21))) | (1 << ISC00) | (1 << ISC20);
+  EIFR = (1 << INTF0) | (1 << INTF2);
+  EIMSK |= (1 << INT0) | (1 << INT2);
+
+  PCMSK0 |= (1 << PCINT4) | (1 << PCINT6);
+  PCIFR = (1 << PCIF0);
+  PCICR |= (1 << PCIE0);
+}
+
+void disable_button_wakeup() {
+  EIMSK &= ~((1 << INT0) | (1 << INT2));
+  PCICR &= ~(1 << PCIE0);
+  PCMSK0 &= ~((1 << PCINT4) | (1 << PCINT6));
+}
+
+// LUFA has already frozen the USB clock and stopped the PLL by the time we get here,
+// so power down everything else until the host resumes us or a button is pressed
+void suspend() {
+  ADCSRA &= ~(1 << ADEN);
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  if (sleep && !remote_wakeup) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+
+  if (sleep && remote_wakeup) {
+    remote_wakeup = false;
+    if (USB_Device_RemoteWakeupEnabled) {
+      USB_Device_SendRemoteWakeup();
+    }
+  }
+
+  if (!sleep) {
+    ADCSRA |= (1 << ADEN);
   }
 }
 
 int main() {
+  main_init();
+
+  while (true) {
+    main_task();
+  }
+}
+
+void main_init() {
   setup_hardware();
 
   config_init(&current_config);
   RgbHelper::init(current_config);
+  LightingProgram::init();
   usb_init(current_config);
+}
 
-  timer_arm(&joystick_out_state.hid_expiry_timer, 0);
-  timer_arm(&lights_out_state.hid_expiry_timer, 0);
-
-  while (true) {
-    if (sleep) {
-      continue;
-    }
-
-    handle_command();
-    usb_handler->usb_task(current_config);
-
-    set_hid_standby_lighting();
-    process_buttons();
-    process_combos();
-    usb_handler->update(current_config);
+void main_task() {
+  if (sleep) {
+    suspend();
+    return;
   }
+
+  handle_command();
+  LightingProgram::save();
+  usb_handler->usb_task(current_config);
+#if TELEMETRY
+  HID_Device_USBTask(&telemetry_hid_report.HID_Interface);
+#endif
+
+  set_hid_standby_lighting();
+  process_buttons();
+  Chatter::update(button_state);
+#if INPUT_TRACE
+  Trace::update(button_state);
+#endif
+#if TELEMETRY
+  Telemetry::update(button_state);
+#endif
+  Tempo::update(button_state);
+  process_combos();
+  usb_handler->update(current_config);
+#if CONTROLLER_HAS_IIDX
+  TtCalibration::update();
+#endif
+  RgbHelper::run();
 }
 
 // this refers to the hardware timer peripheral
@@ -156,6 +253,7 @@ void setup_hardware() {
     CONFIG_PORT_INPUT(button.INPUT_PORT.PORT, button.input_pin);
     CONFIG_PORT_LED(button.LED_PORT.PORT, button.led_pin);
   }
+  ButtonLights::init(buttons, BUTTONS);
 
   GlobalInterruptEnable();
 
@@ -168,7 +266,12 @@ void setup_hardware() {
 }
 
 void usb_init(config &config) {
+#ifndef CONTROLLER_UNIVERSAL
+  config.controller_type = BUILD_CONTROLLER_TYPE;
+#endif
+
   switch (button_state) {
+#if CONTROLLER_HAS_IIDX
     case BUTTON_1 | BUTTON_8:
       set_controller_type(config, ControllerType::IIDX);
       set_input_mode(config, InputMode::Joystick);
@@ -177,6 +280,8 @@ void usb_init(config &config) {
       set_controller_type(config, ControllerType::IIDX);
       set_input_mode(config, InputMode::Keyboard);
       break;
+#endif
+#if CONTROLLER_HAS_SDVX
     case BUTTON_1 | BUTTON_9:
       set_controller_type(config, ControllerType::SDVX);
       set_input_mode(config, InputMode::Joystick);
@@ -185,6 +290,7 @@ void usb_init(config &config) {
       set_controller_type(config, ControllerType::SDVX);
       set_input_mode(config, InputMode::Keyboard);
       break;
+#endif
     default:
       break;
   }
@@ -194,6 +300,11 @@ void usb_init(config &config) {
 }
 
 void init_controller_io(const config &config) {
+#if defined(CONTROLLER_IIDX)
+  IIDX::usb_init(config);
+#elif defined(CONTROLLER_SDVX)
+  SDVX::usb_init(config);
+#else
   switch (config.controller_type) {
     case ControllerType::IIDX:
       IIDX::usb_init(config);
@@ -202,27 +313,45 @@ void init_controller_io(const config &config) {
       SDVX::usb_init(config);
       break;
   }
+#endif
 }
 
 void EVENT_USB_Device_Suspend() {
   sleep = true;
+  remote_wakeup = false;
   clear_all_lights();
+  // Timer3 stops in power-down, so make sure the lamps aren't left on
+  ButtonLights::stop();
+  enable_button_wakeup();
 }
 
 void EVENT_USB_Device_WakeUp() {
   sleep = false;
+  disable_button_wakeup();
+  ButtonLights::start();
 }
 
 // event handler for USB config change event
 void EVENT_USB_Device_ConfigurationChanged() {
   // setup HID report endpoints
   Endpoint_ConfigureEndpoint(JOYSTICK_IN_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
-  Endpoint_ConfigureEndpoint(JOYSTICK_OUT_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
+  // OUT endpoints are double banked so the host can send the next report
+  // before the last one is drained
+  Endpoint_ConfigureEndpoint(JOYSTICK_OUT_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 2);
   Endpoint_ConfigureEndpoint(KEYBOARD_IN_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
   Endpoint_ConfigureEndpoint(MOUSE_IN_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
-  Endpoint_ConfigureEndpoint(LIGHTS_OUT_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
+  Endpoint_ConfigureEndpoint(LIGHTS_OUT_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 2);
+#if TELEMETRY
+  Endpoint_ConfigureEndpoint(TELEMETRY_IN_EPADDR, EP_TYPE_INTERRUPT, HID_EPSIZE, 1);
+#endif
+
+  // We don't use StartOfFrame events to poll inputs as it's too slow and results in lots of jitter,
+  // but it's a good fit for draining OUT reports, which can't arrive any faster than once a frame
+  USB_Device_EnableSOFEvents();
+}
 
-  // We don't use StartOfFrame events to poll as it's too slow and results in lots of jitter from inputs
+void EVENT_USB_Device_StartOfFrame() {
+  hid_receive();
 }
 
 void EVENT_USB_Device_ControlRequest() {
@@ -236,6 +365,16 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
                                          uint16_t* const ReportSize) {
   switch (ReportType) {
     case HID_REPORT_ITEM_In:
+#if TELEMETRY
+      if (HIDInterfaceInfo == &telemetry_hid_report.HID_Interface) {
+        Telemetry::telemetry_report report;
+        Telemetry::fill_report(report);
+        memcpy(ReportData, &report, sizeof(report));
+        *ReportSize = sizeof(report);
+        // Sent every poll, the sequence number changes anyway
+        return true;
+      }
+#endif
       return usb_handler->create_hid_report(HIDInterfaceInfo,
                                             ReportID,
                                             ReportData,
@@ -247,6 +386,7 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
           *ReportSize = sizeof(current_config);
           return false;
         case HID_REPORTID_Command:
+        case HID_REPORTID_LightingProgram:
           return false;
         case HID_REPORTID_FirmwareVersion: {
           constexpr uint32_t firmware_version = FW_VER;
@@ -254,6 +394,47 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
           *ReportSize = sizeof(firmware_version);
           return false;
         }
+        case HID_REPORTID_Tempo: {
+          Tempo::tempo_report report;
+          Tempo::fill_report(report);
+          memcpy(ReportData, &report, sizeof(report));
+          *ReportSize = sizeof(report);
+          return false;
+        }
+        case HID_REPORTID_Latency: {
+          // GET reports go through a buffer the size of the config report
+          static_assert(sizeof(Latency::latency_report) <= sizeof(config), "Latency report too big");
+          Latency::latency_report report;
+          Latency::fill_report(report);
+          memcpy(ReportData, &report, sizeof(report));
+          *ReportSize = sizeof(report);
+          return false;
+        }
+        case HID_REPORTID_Latched: {
+          Latency::latched_report report;
+          Latency::fill_latched_report(report);
+          memcpy(ReportData, &report, sizeof(report));
+          *ReportSize = sizeof(report);
+          return false;
+        }
+        case HID_REPORTID_Chatter: {
+          static_assert(sizeof(Chatter::chatter_report) <= sizeof(config), "Chatter report too big");
+          Chatter::chatter_report report;
+          Chatter::fill_report(report);
+          memcpy(ReportData, &report, sizeof(report));
+          *ReportSize = sizeof(report);
+          return false;
+        }
+#if INPUT_TRACE
+        case HID_REPORTID_Trace: {
+          static_assert(sizeof(Trace::trace_report) <= sizeof(config), "Trace report too big");
+          Trace::trace_report report;
+          Trace::fill_report(report);
+          memcpy(ReportData, &report, sizeof(report));
+          *ReportSize = sizeof(report);
+          return false;
+        }
+#endif
         default:
           // We're handling a feature report, should only be coming from HID_Device_ProcessControlRequest()
           Endpoint_StallTransaction();
@@ -296,24 +477,43 @@ void CALLBACK_HID_Device_ProcessHIDReport(USB_ClassInfo_HID_Device_t* const HIDI
       break;
     }
     case HID_REPORTID_FirmwareVersion:
+    case HID_REPORTID_Tempo:
+    case HID_REPORTID_Latency:
+    case HID_REPORTID_Latched:
+      break;
+    case HID_REPORTID_LightingProgram: {
+      // Saved to EEPROM outside of interrupt
+      if (ReportSize != sizeof(LightingProgram::program_report) ||
+          !LightingProgram::load(*static_cast<const LightingProgram::program_report*>(ReportData))) {
+        Endpoint_StallTransaction();
+        return;
+      }
+      break;
+    }
+    case HID_REPORTID_Chatter: {
+      if (ReportSize != sizeof(Chatter::Action) ||
+          !Chatter::process_report(*static_cast<const Chatter::Action*>(ReportData))) {
+        Endpoint_StallTransaction();
+        return;
+      }
       break;
+    }
+#if INPUT_TRACE
+    case HID_REPORTID_Trace: {
+      if (ReportSize != sizeof(Trace::action_report) ||
+          !Trace::process_report(*static_cast<const Trace::action_report*>(ReportData))) {
+        Endpoint_StallTransaction();
+        return;
+      }
+      break;
+    }
+#endif
     default:
       Endpoint_StallTransaction();
       break;
   }
 }
 
-void set_led(volatile uint8_t* PORT,
-             const uint8_t button_number,
-             const uint8_t led_pin,
-             const uint16_t led_state) {
-  const uint8_t mask = 1 << led_pin;
-  const uint8_t state = (led_state >> button_number) & 1;
-
-  *PORT = (*PORT & ~mask) | // Clear led_pin bit
-    (-state & mask);        // state will either be 0 or -1 (underflows to 255)
-}
-
 void set_hid_standby_lighting() {
   reactive_led = joystick_out_state.on_standby();
 }
@@ -363,29 +563,43 @@ void process_keyboard(Beef::USB_KeyboardReport_Data_t* const hid_key_codes,
   }
 }
 
-void update_button_lighting(uint16_t led_state) {
-  if (reactive_led) {
-    led_state = button_state;
+void update_button_lighting(const uint16_t led_state) {
+  uint8_t brightness[BUTTONS];
+  for (uint8_t i = 0; i < BUTTONS; i++) {
+    brightness[i] = (led_state >> i) & 1 ? 255 : 0;
   }
+  update_button_brightness(brightness, BUTTONS);
+}
 
-  if (current_config.disable_leds ||
-      // Temporarily black out button LEDs to notify a setting change
-      timer_is_active(&combo_lights_timer)) {
-    led_state = 0;
-  }
+void update_button_brightness(const uint8_t* brightness, const uint8_t n) {
+  // Temporarily black out button LEDs to notify a setting change
+  const bool off = current_config.disable_leds ||
+    timer_is_active(&combo_lights_timer);
 
+  uint8_t levels[BUTTONS];
   for (uint8_t i = 0; i < BUTTONS; i++) {
-    set_led(buttons[i].LED_PORT.PORT,
-            i,
-            buttons[i].led_pin,
-            led_state);
+    if (off) {
+      levels[i] = 0;
+    } else if (reactive_led) {
+      levels[i] = (button_state >> i) & 1 ? 255 : 0;
+    } else {
+      levels[i] = i < n ? brightness[i] : 0;
+    }
+  }
+
+  // Only fade out in reactive mode, HID lighting is up to the host
+  ButtonLights::update(levels, reactive_led && !off);
+
+  uint32_t latched_us;
+  if (ButtonLights::latched(latched_us)) {
+    Latency::latched(Latency::Path::Lamps, latched_us);
   }
 }
 
 void clear_all_lights() {
   reactive_led = false;
   update_button_lighting(0);
-  FastLED.clear(true);
+  RgbHelper::clear();
 }
 
 bool is_only_pressed(uint16_t button_bits, uint16_t ignore) {
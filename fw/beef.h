@@ -1,22 +1,25 @@
 #pragma once
 
 #include "config.h"
+#include "controller.h"
 #include "debounce.h"
 #include "hid.h"
 #include "usb_handler.h"
 
 extern uint16_t button_state;
-extern AbstractUsbHandler* usb_handler;
+extern ControllerUsbHandler* usb_handler;
 
 void application_jump_check() ATTR_INIT_SECTION(3);
+// Boot, and one pass of the main loop, split out of main() so the virtual board can drive them
+void main_init();
+void main_task();
 void setup_hardware();
 void usb_init(config &config);
 void init_controller_io(const config &config);
+void suspend();
+void enable_button_wakeup();
+void disable_button_wakeup();
 
-void set_led(volatile uint8_t* PORT,
-             uint8_t button_number,
-             uint8_t led_pin,
-             uint16_t OutputData);
 void set_hid_standby_lighting();
 void process_buttons();
 void process_button(const volatile uint8_t* PIN,
@@ -27,6 +30,8 @@ void process_keyboard(Beef::USB_KeyboardReport_Data_t* const hid_key_codes,
                       const uint8_t* const key_codes,
                       const uint8_t n);
 void update_button_lighting(uint16_t led_state);
+// Brightness 0-255 per button, for BUTTON_LIGHT_LEVELS reports
+void update_button_brightness(const uint8_t* brightness, uint8_t n);
 void clear_all_lights();
 
 bool is_only_pressed(uint16_t button_bits, uint16_t ignore = 0);
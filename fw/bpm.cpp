@@ -11,9 +11,11 @@ Bpm::Bpm(const uint8_t max_level) : max_level(max_level){}
 
 uint8_t Bpm::update(const uint16_t button_state) {
   const auto now = milliseconds;
-  if (now == sample_time) {
+  // Once a millisecond, the first sample counts whatever the time is
+  if (sampled && now == sample_time) {
     return current_level;
   }
+  sampled = true;
   sample_time = now;
 
   if (!timer_is_active(&button_guard)) {
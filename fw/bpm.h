@@ -2,7 +2,7 @@
 
 #include "timer.h"
 
-// Doesn't actually track BPM, but it's the closest concept
+// Doesn't actually track BPM, but it's the closest concept. See tempo.h for that
 class Bpm {
 public:
   explicit Bpm(uint8_t max_level);
@@ -16,4 +16,5 @@ private:
   uint8_t current_level{};
   uint16_t last_button_state{};
   uint32_t sample_time{};
+  bool sampled{};
 };
@@ -0,0 +1,181 @@
+#include <avr/interrupt.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include <LUFA/Common/Common.h>
+
+#include "button_lights.h"
+#include "timer.h"
+
+namespace ButtonLights {
+  enum {
+    MAX_PORTS = 6,
+
+    // Shortest bit plane is 64us with a prescaler of 8, so a whole frame
+    // of 63 * 64us refreshes at ~250Hz, with 6 interrupts per frame
+    BASE_TICKS = 128
+  };
+
+  volatile uint8_t max_isr_ticks = 0;
+
+  volatile uint8_t* ports[MAX_PORTS];
+  uint8_t port_masks[MAX_PORTS];
+  uint8_t num_ports = 0;
+
+  uint8_t button_port[BUTTONS];
+  uint8_t button_mask[BUTTONS];
+  uint8_t num_buttons = 0;
+
+  // Port values for each bit plane, double buffered so the interrupt
+  // only ever switches between two complete frames
+  uint8_t planes[2][LEVEL_BITS][MAX_PORTS];
+  volatile uint8_t active_planes = 0;
+  volatile bool swap_pending = false;
+  volatile bool swapped = false;
+  volatile uint32_t swap_us;
+
+  uint8_t brightness_levels[BUTTONS];
+  uint8_t bam_levels[BUTTONS];
+  uint32_t last_update;
+
+  void init(const button_pins* pins, const uint8_t n) {
+    num_buttons = MIN(n, static_cast<uint8_t>(BUTTONS));
+    for (uint8_t i = 0; i < num_buttons; i++) {
+      const auto port = pins[i].LED_PORT.PORT;
+      uint8_t p = 0;
+      while (p < num_ports && ports[p] != port) {
+        p++;
+      }
+      if (p == num_ports) {
+        ports[num_ports++] = port;
+      }
+
+      button_port[i] = p;
+      button_mask[i] = 1 << pins[i].led_pin;
+      port_masks[p] |= button_mask[i];
+    }
+
+    last_update = milliseconds;
+    start();
+  }
+
+  void start() {
+    TCCR3A = 0;
+    TCNT3 = 0;
+    OCR3A = BASE_TICKS - 1;
+    TIMSK3 |= (1 << OCIE3A);
+    // CTC mode, prescaler of 8
+    TCCR3B = (1 << WGM32) | (1 << CS31);
+  }
+
+  void stop() {
+    TCCR3B = 0;
+    TIMSK3 &= ~(1 << OCIE3A);
+
+    for (uint8_t p = 0; p < num_ports; p++) {
+      *ports[p] &= ~port_masks[p];
+    }
+  }
+
+  // Lamps look much brighter than their duty cycle at low levels
+  uint8_t to_bam_level(const uint8_t brightness) {
+    return (static_cast<uint16_t>(brightness) * brightness) >> 10;
+  }
+
+  void build_planes(uint8_t (&frame)[LEVEL_BITS][MAX_PORTS]) {
+    memset(frame, 0, sizeof(frame));
+    for (uint8_t i = 0; i < num_buttons; i++) {
+      const uint8_t level = bam_levels[i];
+      for (uint8_t bit = 0; bit < LEVEL_BITS; bit++) {
+        if (level & (1 << bit)) {
+          frame[bit][button_port[i]] |= button_mask[i];
+        }
+      }
+    }
+  }
+
+  void update(const uint8_t* brightness, const bool fade) {
+    const uint32_t now = milliseconds;
+    const uint32_t elapsed = now - last_update;
+    // Keep fractional steps around until they add up to at least one level
+    const uint16_t fade_step = MIN(elapsed * 255 / FADE_TIME, static_cast<uint32_t>(255));
+    if (fade_step > 0) {
+      last_update = now;
+    }
+
+    bool changed = false;
+    for (uint8_t i = 0; i < num_buttons; i++) {
+      uint8_t level = brightness[i];
+      if (fade && level < brightness_levels[i]) {
+        level = brightness_levels[i] -
+          MIN(fade_step, static_cast<uint16_t>(brightness_levels[i] - level));
+      }
+      brightness_levels[i] = level;
+
+      const uint8_t bam_level = to_bam_level(level);
+      changed |= bam_levels[i] != bam_level;
+      bam_levels[i] = bam_level;
+    }
+
+    // Retried on the next update if the interrupt hasn't picked up the last frame yet
+    static bool dirty = false;
+    dirty |= changed;
+    if (dirty && !swap_pending) {
+      build_planes(planes[active_planes ^ 1]);
+      swap_pending = true;
+      dirty = false;
+    }
+  }
+
+  bool latched(uint32_t &latched_us) {
+    bool was_swapped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      was_swapped = swapped;
+      latched_us = swap_us;
+      swapped = false;
+    }
+    return was_swapped;
+  }
+
+  uint8_t take_max_isr_ticks() {
+    uint8_t ticks;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      ticks = max_isr_ticks;
+      max_isr_ticks = 0;
+    }
+    return ticks;
+  }
+}
+
+ISR(TIMER3_COMPA_vect) {
+  using namespace ButtonLights;
+  static uint8_t bit = 0;
+
+  if (bit == 0 && swap_pending) {
+    active_planes ^= 1;
+    swap_pending = false;
+    swapped = true;
+    swap_us = timer_micros();
+  }
+
+  const uint8_t* plane = planes[active_planes][bit];
+  for (uint8_t p = 0; p < num_ports; p++) {
+    *ports[p] = (*ports[p] & ~port_masks[p]) | plane[p];
+  }
+
+  // TCNT3 was cleared at the compare match, so this sets how long this plane
+  // stays on. If the interrupt was held off past the new TOP, e.g. by
+  // FastLED's show(), the match is already gone and the counter would run on
+  // to 0xFFFF, leaving this plane lit for 32 ms. Restart the plane instead
+  const uint16_t top = (BASE_TICKS << bit) - 1;
+  OCR3A = top;
+  bit = bit + 1 < LEVEL_BITS ? bit + 1 : 0;
+
+  const uint16_t ticks = TCNT3;
+  if (ticks >= top) {
+    TCNT3 = 0;
+  }
+  if (ticks > max_isr_ticks) {
+    max_isr_ticks = MIN(ticks, static_cast<uint16_t>(UINT8_MAX));
+  }
+}
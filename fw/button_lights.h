@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "config.h"
+#include "pin.h"
+
+// Button lamps are dimmed with bit angle modulation from a Timer3 interrupt,
+// each bit plane is output for twice as long as the previous one
+namespace ButtonLights {
+  enum : uint8_t {
+    LEVEL_BITS = 6,
+    MAX_LEVEL = (1 << LEVEL_BITS) - 1,
+
+    // Time taken to fade out a lamp after a button is released in reactive mode
+    FADE_TIME = 200
+  };
+
+  void init(const button_pins* pins, uint8_t n);
+  void start();
+  // Stops the interrupt and switches all lamps off, e.g. before power-down
+  void stop();
+
+  // Brightness 0-255 for each button, fade eases lamps out instead of switching them off
+  void update(const uint8_t* brightness, bool fade);
+
+  // True once after the interrupt starts outputting a new frame, with when it did
+  bool latched(uint32_t &latched_us);
+
+  // Longest time spent in the interrupt since the last call, in Timer3 ticks
+  // of 8 CPU cycles. Counted from the compare match, so it includes the
+  // interrupt latency and prologue but not the epilogue. 255 means it was
+  // held off for at least that long, e.g. by FastLED's show()
+  uint8_t take_max_isr_ticks();
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+#include <util/atomic.h>
+
+#include "chatter.h"
+#include "timer.h"
+
+namespace Chatter {
+  struct contact {
+    uint32_t changed_ms;
+    uint8_t short_pulse; // ms, bounce if the next gap turns out short
+    bool after_gap;      // this pulse started after a short gap
+  };
+
+  button_stats stats[BUTTONS];
+  contact contacts[BUTTONS];
+  uint16_t last_raw;
+  bool changed;
+
+  // Set from the control request interrupt, handled in update()
+  volatile bool reset_pending = true;
+
+  void reset() {
+    memset(contacts, 0, sizeof(contacts));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      for (auto &s : stats) {
+        s = { .presses = 0, .bounces = 0, .longest_bounce = 0, .shortest_gap = NO_GAP, .auto_window = MIN_WINDOW };
+      }
+    }
+    changed = true;
+  }
+
+  void bounced(button_stats &s, const uint8_t pulse) {
+    const uint8_t window = MIN(pulse + 1, static_cast<int>(MAX_WINDOW));
+    if (window > s.auto_window) {
+      changed = true;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      s.bounces = MIN(s.bounces + 1, UINT16_MAX);
+      s.longest_bounce = MAX(s.longest_bounce, pulse);
+      s.auto_window = MAX(s.auto_window, window);
+    }
+  }
+
+  void pressed(button_stats &s, contact &c, const uint32_t gap) {
+    const bool short_gap = gap < GAP_MS;
+    if (short_gap && c.short_pulse) {
+      bounced(s, c.short_pulse);
+    }
+    c.short_pulse = 0;
+    c.after_gap = short_gap;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      s.presses = MIN(s.presses + 1, UINT16_MAX);
+      if (gap < NO_GAP) {
+        s.shortest_gap = MIN(s.shortest_gap, static_cast<uint8_t>(gap));
+      }
+    }
+    // Healthy buttons drop to MIN_WINDOW once they've proven themselves
+    if (s.presses == LEARN_PRESSES) {
+      changed = true;
+    }
+  }
+
+  void released(button_stats &s, contact &c, const uint32_t pulse) {
+    if (pulse >= PULSE_MS) {
+      return;
+    }
+    if (c.after_gap) {
+      bounced(s, pulse);
+    } else {
+      // A pulse of 0 ms still needs a window of 1
+      c.short_pulse = MAX(pulse, static_cast<uint32_t>(1));
+    }
+  }
+
+  void update(const uint16_t raw_buttons) {
+    if (reset_pending) {
+      reset_pending = false;
+      reset();
+    }
+
+    const uint16_t toggled = (raw_buttons ^ last_raw) & ((1 << BUTTONS) - 1);
+    last_raw = raw_buttons;
+    if (!toggled) {
+      return;
+    }
+
+    const uint32_t now = milliseconds;
+    for (uint8_t i = 0; i < BUTTONS; i++) {
+      const uint16_t button = 1 << i;
+      if (!(toggled & button)) {
+        continue;
+      }
+
+      auto &c = contacts[i];
+      const uint32_t since = now - c.changed_ms;
+      if (raw_buttons & button) {
+        // The first press after boot or a reset has nothing to measure against
+        pressed(stats[i], c, c.changed_ms ? since : UINT32_MAX);
+      } else {
+        released(stats[i], c, since);
+      }
+      c.changed_ms = now;
+    }
+  }
+
+  uint8_t window(const uint8_t button, const uint8_t configured) {
+    const auto &s = stats[button];
+    return s.presses < LEARN_PRESSES ? MAX(configured, s.auto_window) : s.auto_window;
+  }
+
+  bool windows_changed() {
+    const bool result = changed;
+    changed = false;
+    return result;
+  }
+
+  void fill_report(chatter_report &report) {
+    report.debounce_auto = current_config.debounce_auto;
+    report.buttons = current_config.controller_type == ControllerType::SDVX ? 9 : BUTTONS;
+    memcpy(report.stats, stats, sizeof(report.stats));
+  }
+
+  bool process_report(const Action action) {
+    switch (action) {
+      case Action::Reset:
+        reset_pending = true;
+        return true;
+      default:
+        return false;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <LUFA/Common/Common.h>
+
+#include "config.h"
+
+// Watches the raw switch contacts for bounce, independently of the debounce
+// windows in use. A bounce is a short pulse right next to a short gap, i.e.
+// contact chatter as a switch closes or opens. Nobody can release and press
+// a button again within GAP_MS, and the longest bounce seen on a button is
+// how long its window has to be to hide it. With debounce_auto set each
+// button gets that window instead of its group's.
+namespace Chatter {
+  enum : uint8_t {
+    // Release to press gaps shorter than this are bounce
+    GAP_MS = 10,
+    // A pulse next to a short gap is bounce if it's shorter than this,
+    // anything longer is the real press
+    PULSE_MS = 25,
+    // Auto windows never go below this, so a switch that starts bouncing
+    // after it was learned is still covered for the common 1 ms chatter
+    MIN_WINDOW = 2,
+    // Auto windows never go above this, worse switches need replacing
+    MAX_WINDOW = 20,
+    // Buttons keep their group's window until pressed this many times
+    LEARN_PRESSES = 32,
+
+    NO_GAP = UINT8_MAX
+  };
+
+  struct button_stats {
+    uint16_t presses;        // raw presses, bounces included, saturates
+    uint16_t bounces;        // saturates
+    uint8_t longest_bounce;  // ms
+    uint8_t shortest_gap;    // ms, release to press, NO_GAP until there's been a shorter one
+    uint8_t auto_window;     // ms, the window auto mode picks once learned, MIN_WINDOW at least
+  } ATTR_PACKED;
+
+  struct chatter_report {
+    uint8_t debounce_auto;
+    uint8_t buttons;         // entries in stats that are in use
+    button_stats stats[BUTTONS];
+  } ATTR_PACKED;
+
+  enum class Action : uint8_t {
+    Reset
+  };
+
+  // Called every main loop pass with the raw button bits
+  void update(uint16_t raw_buttons);
+
+  // Window for the button under debounce_auto, configured until it's learned
+  uint8_t window(uint8_t button, uint8_t configured);
+  // True once after a learned window changed
+  bool windows_changed();
+
+  // Called from the control request interrupt
+  void fill_report(chatter_report &report);
+  // Reset is done on the next main loop pass, false for unknown actions
+  bool process_report(Action action);
+}
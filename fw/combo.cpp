@@ -1,19 +1,34 @@
+#include "devices/iidx/iidx_combo.h"
+#include "devices/sdvx/sdvx_combo.h"
+
 #include "beef.h"
 #include "combo.h"
 #include "config.h"
 #include "hid.h"
 #include "rgb_helper.h"
 
+#ifdef CONTROLLER_UNIVERSAL
 combo (*get_button_combo_callback) (uint16_t);
+#endif
 timer combo_lights_timer;
 
+static combo get_button_combo(const uint16_t button_state) {
+#if defined(CONTROLLER_IIDX)
+  return IIDX::get_button_combo(button_state);
+#elif defined(CONTROLLER_SDVX)
+  return SDVX::get_button_combo(button_state);
+#else
+  return get_button_combo_callback(button_state);
+#endif
+}
+
 void process_combos() {
   static timer combo_timer;
   static bool combo_activated = false;
   static bool ignore_combo = false;
   static callback config_update_callback;
 
-  const auto button_combo = get_button_combo_callback(button_state);
+  const auto button_combo = get_button_combo(button_state);
   if (button_combo.config_set != nullptr) {
     combo_activated = true;
     reactive_led = true;
@@ -1,13 +1,16 @@
 #pragma once
 
 #include "config.h"
+#include "controller.h"
 
 struct combo {
   bool continuous;
   callback (*config_set)(config*);
 };
 
+#ifdef CONTROLLER_UNIVERSAL
 extern combo (*get_button_combo_callback) (uint16_t);
+#endif
 extern timer combo_lights_timer;
 
 void process_combos();
@@ -26,17 +26,20 @@
 #include <avr/eeprom.h>
 
 #include "devices/iidx/iidx_rgb_manager.h"
+#include "devices/iidx/iidx_usb.h"
+#include "devices/sdvx/sdvx_usb.h"
 
 #include "analog_button.h"
 #include "beef.h"
 #include "config.h"
+#include "lighting_program.h"
 #include "rgb_helper.h"
+#include "tt_calibration.h"
 
 enum {
   MAGIC = 0xBEEF,
-
-  DEADZONE_MAX = 6,
-  DEADZONE_MIN = 1,
+  // Bump along with every new case in config_update
+  VERSION = 19,
 
   RATIO_MAX = 6,
   RATIO_MIN = 1
@@ -77,7 +80,27 @@ const SDVXKeyMapping DEFAULT_SDVX_KEYS = {
   }
 };
 
+// 0 leaves a button unmapped. The error codes would have the host drop every
+// key held, and nothing past Right GUI is a key
+static bool validate_key_codes(const uint8_t* const key_codes, const uint8_t n) {
+  for (uint8_t i = 0; i < n; i++) {
+    const uint8_t code = key_codes[i];
+    if (code >= HID_KEYBOARD_SC_ERROR_ROLLOVER && code <= HID_KEYBOARD_SC_ERROR_UNDEFINED) {
+      return false;
+    }
+    if (code > HID_KEYBOARD_SC_RIGHT_GUI) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool validate_config(const config &self) {
+  // An older version would rerun migrations on the next boot. A newer one was
+  // saved by newer firmware, only the fields this firmware knows are checked
+  if (self.version < VERSION) {
+    return false;
+  }
   if (self.tt_effect >= TurntableMode::Count) {
     return false;
   }
@@ -90,6 +113,13 @@ bool validate_config(const config &self) {
   if (self.tt_ratio < RATIO_MIN || self.tt_ratio > RATIO_MAX) {
     return false;
   }
+  if (self.tt_sustain_ms > SUSTAIN_MAX_MS) {
+    return false;
+  }
+  if (!validate_key_codes(self.iidx_keys.key_codes, sizeof(self.iidx_keys.key_codes)) ||
+      !validate_key_codes(self.sdvx_keys.key_codes, sizeof(self.sdvx_keys.key_codes))) {
+    return false;
+  }
   if (self.controller_type > ControllerType::SDVX) {
     return false;
   }
@@ -105,7 +135,10 @@ bool validate_config(const config &self) {
   if (self.rainbow_spin_speed == 0) {
     return false;
   }
-  if (self.tt_leds == 0) {
+  if (self.tt_leds == 0 || self.tt_leds > MAX_TT_LEDS) {
+    return false;
+  }
+  if (self.tt_layout.segments == 0 || self.bar_layout.segments == 0) {
     return false;
   }
 
@@ -122,6 +155,13 @@ void config_init(config* self) {
   }
 
   config_update(self);
+
+  // Corrupt EEPROM, or a newer config using a setting this firmware doesn't
+  // have, like a newer effect. Start again from the defaults
+  if (!validate_config(*self)) {
+    self->version = 0;
+    config_update(self);
+  }
 }
 
 void config_update(config* self) {
@@ -192,9 +232,24 @@ void config_update(config* self) {
       self->rainbow_spin_speed = 1;
       self->tt_leds = 24;
       self->version++;
+    case 16:
+      self->tt_layout = { .offset = 0, .flags = 0, .segments = 1 };
+      self->bar_layout = { .offset = 0, .flags = 0, .segments = 1 };
+      self->version++;
+    case 17:
+      self->debounce_auto = 0;
+      self->version++;
+    case 18:
+      // 1 Hz and 0.025 Hz per LSB/s, see knob-bench
+      self->knob_min_cutoff = 10;
+      self->knob_beta = 25;
+      self->version++;
     default: break;
   }
 
+  // Don't overrun the LED arena if this build supports fewer TT LEDs
+  self->tt_leds = MIN(self->tt_leds, static_cast<uint8_t>(MAX_TT_LEDS));
+
   eeprom_update_block(self, CONFIG_BASE_ADDR, sizeof(config));
 }
 
@@ -208,15 +263,17 @@ void config_save(const config &new_config) {
   }
 
   if (new_config.disable_leds) {
-    FastLED.clear(true);
+    RgbHelper::clear();
   }
 
   RgbHelper::update(new_config);
+  LightingProgram::update();
   usb_handler->config_update(new_config);
 
   memcpy(&current_config, &new_config, sizeof(config));
   current_config.reverse_tt &= 1;
   current_config.disable_leds &= 1;
+  current_config.debounce_auto &= 1;
   eeprom_update_block(&current_config, CONFIG_BASE_ADDR, sizeof(config));
 }
 
@@ -238,6 +295,7 @@ void set_input_mode(config &self, InputMode mode) {
   }
 }
 
+#if CONTROLLER_HAS_IIDX
 callback toggle_reverse_tt(config* self) {
   self->reverse_tt ^= 1;
   eeprom_write_byte(CONFIG_REVERSE_TT_ADDR, self->reverse_tt);
@@ -398,6 +456,12 @@ callback decrease_deadzone(config* self) {
   return callback{};
 }
 
+callback calibrate_tt(config* self) {
+  TtCalibration::start();
+
+  return callback{};
+}
+
 void update_ratio(const uint8_t ratio) {
   eeprom_update_byte(CONFIG_TT_RATIO_ADDR, ratio);
 
@@ -422,10 +486,7 @@ callback decrease_ratio(config* self) {
 }
 
 callback cycle_bar_effects(config* self) {
-  do {
-    self->bar_effect = BarMode((uint8_t(self->bar_effect) + 1) % uint8_t(BarMode::Count));
-  } while (self->bar_effect == BarMode::Placeholder1 ||
-           self->bar_effect == BarMode::Placeholder3);
+  self->bar_effect = BarMode((uint8_t(self->bar_effect) + 1) % uint8_t(BarMode::Count));
   eeprom_write_byte(CONFIG_BAR_EFFECT_ADDR, uint8_t(self->bar_effect));
 
   IIDX::RgbManager::Bar::set_leds_off();
@@ -433,6 +494,7 @@ callback cycle_bar_effects(config* self) {
 
   return callback{};
 }
+#endif
 
 callback toggle_disable_leds(config* self) {
   self->disable_leds ^= 1;
@@ -440,7 +502,7 @@ callback toggle_disable_leds(config* self) {
   eeprom_write_byte(CONFIG_DISABLE_LEDS_ADDR, self->disable_leds);
 
   if (self->disable_leds) {
-    FastLED.clear(true);
+    RgbHelper::clear();
   }
 
   return callback{};
@@ -16,10 +16,19 @@
   CONFIG_HW_PIN(C2, C3),  /* BUTTON 11 */ \
 }
 
+#ifndef MAX_TT_LEDS
+#define MAX_TT_LEDS 128
+#endif
+
 enum {
   BUTTONS = 11,
 
-  CONFIG_CHANGE_NOTIFY_TIME = 1000
+  CONFIG_CHANGE_NOTIFY_TIME = 1000,
+
+  DEADZONE_MAX = 6,
+  DEADZONE_MIN = 1,
+
+  SUSTAIN_MAX_MS = 250
 };
 
 #ifndef FW_VER
@@ -39,7 +48,8 @@ enum class InputMode : uint8_t {
 enum class Command : uint8_t {
   None,
   Bootloader,
-  ResetConfig
+  ResetConfig,
+  CalibrateTurntable
 };
 
 // Key mapping structures
@@ -82,6 +92,11 @@ struct config {
   uint8_t led_refresh;
   uint8_t rainbow_spin_speed;
   uint8_t tt_leds;
+  LedLayout tt_layout;
+  LedLayout bar_layout;
+  uint8_t debounce_auto;
+  uint8_t knob_min_cutoff;
+  uint8_t knob_beta;
 };
 
 struct callback {
@@ -91,6 +106,7 @@ struct callback {
 
 extern config current_config;
 
+bool validate_config(const config &self);
 void config_init(config* self);
 void config_update(config* self);
 void config_update_setting(uint8_t* addr, uint8_t val);
@@ -105,6 +121,7 @@ callback tt_hsv_set_sat(config* self);
 callback tt_hsv_set_val(config* self);
 callback increase_deadzone(config* self);
 callback decrease_deadzone(config* self);
+callback calibrate_tt(config* self);
 callback increase_ratio(config* self);
 callback decrease_ratio(config* self);
 callback cycle_bar_effects(config* self);
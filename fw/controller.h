@@ -0,0 +1,39 @@
+#pragma once
+
+#include "config.h"
+
+// Controller-specific builds (make CONTROLLER=iidx or CONTROLLER=sdvx) only
+// link in one controller and call straight into it, whereas the universal
+// build picks the controller at runtime through virtual/function pointer calls
+#if defined(CONTROLLER_IIDX) && defined(CONTROLLER_SDVX)
+#error "Only one of CONTROLLER_IIDX and CONTROLLER_SDVX can be defined"
+#endif
+
+#if defined(CONTROLLER_IIDX)
+#define CONTROLLER_HAS_IIDX 1
+#define CONTROLLER_HAS_SDVX 0
+#elif defined(CONTROLLER_SDVX)
+#define CONTROLLER_HAS_IIDX 0
+#define CONTROLLER_HAS_SDVX 1
+#else
+#define CONTROLLER_UNIVERSAL
+#define CONTROLLER_HAS_IIDX 1
+#define CONTROLLER_HAS_SDVX 1
+#endif
+
+#if defined(CONTROLLER_IIDX)
+namespace IIDX {
+  class UsbHandler;
+}
+typedef IIDX::UsbHandler ControllerUsbHandler;
+constexpr auto BUILD_CONTROLLER_TYPE = ControllerType::IIDX;
+#elif defined(CONTROLLER_SDVX)
+namespace SDVX {
+  class UsbHandler;
+}
+typedef SDVX::UsbHandler ControllerUsbHandler;
+constexpr auto BUILD_CONTROLLER_TYPE = ControllerType::SDVX;
+#else
+class AbstractUsbHandler;
+typedef AbstractUsbHandler ControllerUsbHandler;
+#endif
@@ -10,11 +10,21 @@ public:
 
   void init(const uint8_t new_window) {
     memset(counters, 0, sizeof(counters));
-    window = new_window;
+    memset(windows, new_window, sizeof(windows));
+    any_window = new_window;
     last_state = 0;
     sample_time = 0;
   }
 
+  // Per-button override of the window passed to init()
+  void set_window(const uint8_t bit, const uint8_t window) {
+    windows[bit] = window;
+    any_window = 0;
+    for (const auto w : windows) {
+      any_window |= w;
+    }
+  }
+
   uint16_t debounce(const uint16_t buttons, const uint16_t mask) {
     return (buttons & ~mask) | (debounce(buttons & mask));
   }
@@ -23,14 +33,15 @@ public:
 
 private:
   uint8_t counters[BUTTONS]{};
-  uint8_t window{};
+  uint8_t windows[BUTTONS]{};
+  uint8_t any_window{};
   uint16_t last_state{};
   uint32_t sample_time{};
 };
 
 template<int BUTTONS>
 uint16_t Debouncer<BUTTONS>::debounce(const uint16_t buttons) {
-  if (window == 0)
+  if (any_window == 0)
     return buttons; // TODO: Make a noop class for no debounce?
 
   const auto now = milliseconds;
@@ -47,11 +58,12 @@ uint16_t Debouncer<BUTTONS>::debounce(const uint16_t buttons) {
     const uint16_t button_pressed = buttons & button;
 
     if (button_pressed) {
-      if (counter >= window) {
+      if (counter >= windows[bit]) {
         stable |= button;
         continue;
       }
-      counter += delta;
+      // Saturate so a long gap between polls can't wrap a big window
+      counter = delta < static_cast<uint8_t>(UINT8_MAX - counter) ? counter + delta : UINT8_MAX;
     } else {
       counter = 0;
     }
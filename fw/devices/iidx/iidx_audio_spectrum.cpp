@@ -0,0 +1,100 @@
+#include "iidx_audio_spectrum.h"
+#include "../rgb_helper.h"
+#include "../ticker.h"
+#include "../timer.h"
+
+namespace IIDX {
+  namespace AudioSpectrum {
+    uint8_t num_bands = 0;
+    uint8_t levels[MAX_BANDS];
+    uint8_t peaks[MAX_BANDS];
+    uint32_t peak_times[MAX_BANDS];
+    bool dirty = false;
+
+    Ticker decay_ticker(DECAY_TICK_MS);
+
+    bool update(const TapeLed::segment_report &report) {
+      if (report.version != TapeLed::PROTOCOL_VERSION ||
+          !(report.flags & TapeLed::FLAG_SPECTRUM)) {
+        return false;
+      }
+
+      const uint8_t n = MIN(report.length, static_cast<uint8_t>(MAX_BANDS));
+      if (n != num_bands) {
+        memset(levels, 0, sizeof(levels));
+        memset(peaks, 0, sizeof(peaks));
+        num_bands = n;
+      }
+
+      const uint32_t now = milliseconds;
+      for (uint8_t i = 0; i < n; i++) {
+        const uint8_t level = report.data[i];
+        if (level > levels[i]) {
+          levels[i] = level;
+        }
+        if (level >= peaks[i]) {
+          peaks[i] = level;
+          peak_times[i] = now;
+        }
+      }
+
+      dirty = true;
+      return true;
+    }
+
+    bool decay() {
+      const uint8_t ticks = decay_ticker.get_ticks();
+      if (ticks == 0) {
+        return false;
+      }
+
+      const uint32_t now = milliseconds;
+      bool changed = false;
+      for (uint8_t i = 0; i < num_bands; i++) {
+        const uint16_t level_decay = ticks * LEVEL_DECAY;
+        if (levels[i] > 0) {
+          levels[i] = levels[i] > level_decay ? levels[i] - level_decay : 0;
+          changed = true;
+        }
+
+        if (peaks[i] > 0 && now - peak_times[i] >= PEAK_HOLD_MS) {
+          const uint16_t peak_decay = ticks * PEAK_DECAY;
+          peaks[i] = peaks[i] > peak_decay ? peaks[i] - peak_decay : 0;
+          changed = true;
+        }
+      }
+      return changed;
+    }
+
+    bool render(CRGB* leds, const uint8_t n) {
+      if (!(decay() || dirty)) {
+        return false;
+      }
+      dirty = false;
+
+      if (num_bands == 0) {
+        return RgbHelper::set_rgb(leds, n, CRGB::Black);
+      }
+
+      // Each LED shows the loudest band it covers, bands are spread
+      // across the whole bar whether there are more or fewer of them
+      for (uint8_t i = 0; i < n; i++) {
+        const uint8_t first = static_cast<uint16_t>(i) * num_bands / n;
+        const uint8_t last = MAX(static_cast<uint16_t>(i + 1) * num_bands / n,
+                                 static_cast<uint16_t>(first + 1));
+        uint8_t band = first;
+        for (uint8_t b = first + 1; b < last; b++) {
+          if (levels[b] > levels[band]) {
+            band = b;
+          }
+        }
+
+        // Bass is red through to treble in violet, with the held peak as a white glow
+        CRGB colour = CHSV(band * 192 / num_bands, 255, levels[band]);
+        colour += CRGB(peaks[band] / 4, peaks[band] / 4, peaks[band] / 4);
+        leds[i] = colour;
+      }
+      return true;
+    }
+  }
+}
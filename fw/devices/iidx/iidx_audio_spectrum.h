@@ -0,0 +1,31 @@
+#pragma once
+
+#include <FastLED/src/FastLED.h>
+
+#include "iidx_tape_led.h"
+
+namespace IIDX {
+  namespace AudioSpectrum {
+    // Spectrum frames reuse the tape LED segment header with FLAG_SPECTRUM set,
+    // length is the number of bands and data holds one 8-bit level per band,
+    // lowest frequency first. offset and sequence are ignored.
+    // Levels only ever jump up, the fall off and peak hold happen on the board
+    // so the host can send at whatever rate it likes.
+    enum : uint8_t {
+      MAX_BANDS = 16,
+
+      // Levels fall LEVEL_DECAY per DECAY_TICK_MS, so full scale to off in ~250ms
+      DECAY_TICK_MS = 4,
+      LEVEL_DECAY = 4,
+      // Peaks hang around a bit before falling, at a quarter of the level rate
+      PEAK_HOLD_MS = 250,
+      PEAK_DECAY = 1
+    };
+
+    // Returns false if the report isn't a spectrum frame
+    bool update(const TapeLed::segment_report &report);
+
+    // Applies decay and draws the bands across leds, returns true if anything changed
+    bool render(CRGB* leds, uint8_t n);
+  }
+}
@@ -9,6 +9,7 @@ namespace IIDX {
     TT_DEADZONE_DECR = BUTTON_5 | BUTTON_8 | BUTTON_11,
     TT_RATIO_INCR    = BUTTON_1 | BUTTON_8 | BUTTON_11,
     TT_RATIO_DECR    = BUTTON_3 | BUTTON_8 | BUTTON_11,
+    TT_CALIBRATE     = BUTTON_4 | BUTTON_8 | BUTTON_10,
     BAR_EFFECTS      = BUTTON_6 | BUTTON_8 | BUTTON_10,
     DISABLE_LEDS     = BUTTON_4 | BUTTON_8 | BUTTON_11,
     TT_HSV_HUE       = BUTTON_2 | BUTTON_11,
@@ -45,6 +46,10 @@ namespace IIDX {
         return {
           .config_set = decrease_ratio
         };
+      case TT_CALIBRATE:
+        return {
+          .config_set = calibrate_tt
+        };
       case BAR_EFFECTS:
         return {
           .config_set = cycle_bar_effects
@@ -1,13 +1,20 @@
 #include "../beef.h"
 #include "../bpm.h"
 #include "config.h"
+#include "iidx_audio_spectrum.h"
 #include "iidx_rgb_manager.h"
+#include "iidx_tape_led.h"
+#include "../latency.h"
+#include "../lighting_program.h"
+#include "../tempo.h"
 
 enum {
   SPIN_TIMER = 50,
   FAST_SPIN_TIMER = 25,
   REACT_TIMER = 500,
-  BREATHING_TIMER = 3000
+  BREATHING_TIMER = 3000,
+  // Longest host frame interval we'll blend over, slower feeds just snap
+  MAX_TAPE_LED_BLEND_MS = 100
 };
 
 namespace IIDX {
@@ -54,28 +61,48 @@ namespace IIDX {
         return false;
       }
 
-      bool render_rainbow(const HSV &hsv, const uint8_t pos) {
-        static uint8_t prev_pos;
-        bool update = false;
-        if (force_update || prev_pos != pos) {
-          fill_rainbow_circular(tt_leds,
-                                RgbHelper::num_tt_leds,
-                                -pos);
-          update = true;
-        }
-        prev_pos = pos;
+      // Rainbow with HSV adjustments already applied, only rebuilt when saturation/value change
+      bool rainbow_cached = false;
+      HSV rainbow_hsv{};
+      void build_rainbow(const HSV &hsv) {
+        fill_rainbow_circular(tt_rainbow_leds,
+                              RgbHelper::num_tt_leds,
+                              0);
 
         // Emulate HSV adjustments
         for (uint8_t i = 0; i < RgbHelper::num_tt_leds; i++) {
-          auto &led = tt_leds[i];
-          const auto prev_led = tt_leds[i];
-          tt_leds[i] += (CRGB::White - tt_leds[i]).
-            scale8(255 - hsv.s);
+          auto &led = tt_rainbow_leds[i];
+          led += (CRGB::White - led).scale8(255 - hsv.s);
           led.nscale8(hsv.v);
-          update |= prev_led != led;
         }
 
-        return update;
+        rainbow_hsv = hsv;
+        rainbow_cached = true;
+      }
+
+      bool render_rainbow(const HSV &hsv, const uint8_t pos) {
+        static uint8_t prev_offset;
+        const uint8_t n = RgbHelper::num_tt_leds;
+
+        bool update = force_update;
+        if (!rainbow_cached ||
+            rainbow_hsv.s != hsv.s ||
+            rainbow_hsv.v != hsv.v) {
+          build_rainbow(hsv);
+          update = true;
+        }
+
+        // Rotating the hue by pos is the same as rotating the cached frame by this many LEDs
+        const uint8_t offset = (static_cast<uint16_t>(pos) * n) >> 8;
+        if (!update && offset == prev_offset) {
+          return false;
+        }
+        prev_offset = offset;
+
+        memcpy(tt_leds, tt_rainbow_leds + n - offset, offset * sizeof(CRGB));
+        memcpy(tt_leds + offset, tt_rainbow_leds, (n - offset) * sizeof(CRGB));
+
+        return true;
       }
 
       Ticker rainbow_react_ticker(3);
@@ -86,8 +113,7 @@ namespace IIDX {
         const auto ticks = rainbow_react_ticker.get_ticks();
         if (ticks > 0) {
           pos += ticks * tt_report * current_config.rainbow_spin_speed;
-          render_rainbow(hsv, pos);
-          return true;
+          return render_rainbow(hsv, pos);
         }
         return false;
       }
@@ -168,6 +194,20 @@ namespace IIDX {
         return reverse_tt ? tt_report : -tt_report;
       }
 
+      bool custom(const int8_t tt_report) {
+        static uint8_t tt_pos;
+        tt_pos += tt_report;
+
+        const LightingProgram::inputs in = {
+          .time = milliseconds,
+          .tt_velocity = tt_report,
+          .tt_pos = tt_pos,
+          .buttons = button_state
+        };
+        return LightingProgram::render(LightingProgram::Slot::Turntable,
+                                       tt_leds, RgbHelper::num_tt_leds, in);
+      }
+
       bool update(int8_t tt_report,
                   const rgb_light &lights) {
         auto update = force_update;
@@ -219,6 +259,10 @@ namespace IIDX {
           case TurntableMode::Disable:
             update |= set_leds_off();
             break;
+          case TurntableMode::Custom:
+            update |= custom(normalise_tt_report(current_config.reverse_tt,
+                                                 tt_report));
+            break;
           default:
             break;
         }
@@ -240,15 +284,9 @@ namespace IIDX {
         return RgbHelper::set_rgb(bar_leds, LIGHT_BAR_LEDS, CRGB::Black);
       }
 
-      void flip_leds(const PlayerSide side) {
-        if (side == PlayerSide::P1) {
-          // Flip for P1
-          for (uint8_t i = 0; i < LIGHT_BAR_LEDS / 2; i++) {
-            const auto tmp = bar_leds[i];
-            bar_leds[i] = bar_leds[LIGHT_BAR_LEDS-1-i];
-            bar_leds[LIGHT_BAR_LEDS-1-i] = tmp;
-          }
-        }
+      // P1 and P2 variants render the same frame, the LED map flips it
+      bool set_side(const PlayerSide side, const PlayerSide reversed_side) {
+        return RgbHelper::set_bar_reversed(side == reversed_side);
       }
 
       Bpm bpm(LIGHT_BAR_LEDS);
@@ -257,55 +295,169 @@ namespace IIDX {
 
         const auto level = bpm.update(button_state);
 
-        bool update = false;
+        bool update = set_side(side, PlayerSide::P1);
         if (last_level != level) {
           update = true;
           set_leds_off();
           fill_rainbow(bar_leds, level, 0, -16);
-          flip_leds(side);
         }
 
         last_level = level;
         return update;
       }
 
+      // Each predicted beat flashes the bar in a new colour, which then
+      // shrinks in towards the centre and fades until the next beat
+      Ticker beat_ticker(10);
+      bool beat() {
+        bool update = RgbHelper::set_bar_reversed(false);
+        if (beat_ticker.get_ticks() == 0) {
+          return update;
+        }
+
+        if (!Tempo::locked()) {
+          return set_leds_off() || update;
+        }
+
+        const uint8_t fade = 255 - Tempo::phase();
+        const CRGB colour = CHSV(Tempo::beat_count() * 40, 255, scale8(fade, fade));
+        const uint8_t half_width = scale8(LIGHT_BAR_LEDS / 2, fade) + 1;
+
+        for (uint8_t i = 0; i < LIGHT_BAR_LEDS; i++) {
+          const uint8_t from_centre = i < LIGHT_BAR_LEDS / 2 ?
+            LIGHT_BAR_LEDS / 2 - 1 - i : i - LIGHT_BAR_LEDS / 2;
+          const CRGB led = from_centre < half_width ? colour : CRGB(CRGB::Black);
+          if (bar_leds[i] != led) {
+            bar_leds[i] = led;
+            update = true;
+          }
+        }
+        return update;
+      }
+
+      // Shared by tape LED and audio spectrum frames, they use the same header
+      TapeLed::segment_report lights_out_report;
+
       Ticker tape_led_ticker(50);
-      rgb_light tape_leds[LIGHT_BAR_LEDS];
+      uint32_t tape_led_commit_ms;
+      uint16_t tape_led_interval_ms;
+      bool tape_led_blending = false;
+
+      void commit_tape_led() {
+        const uint32_t now = milliseconds;
+        tape_led_interval_ms = MIN(now - tape_led_commit_ms,
+                                   static_cast<uint32_t>(MAX_TAPE_LED_BLEND_MS));
+        tape_led_commit_ms = now;
+
+        // Blend from whatever is on the bar right now towards the new frame
+        memcpy(bar_prev_leds, bar_leds, LIGHT_BAR_LEDS * sizeof(CRGB));
+        const uint8_t n = TapeLed::committed_length > 0 ?
+          TapeLed::committed_length : LIGHT_BAR_LEDS;
+        RgbHelper::resample(bar_next_leds, LIGHT_BAR_LEDS, bar_staging_leds, n);
+        tape_led_blending = true;
+      }
+
+      // Host frames are shown one host frame interval late, which lets us
+      // ease into each one at led_refresh instead of stepping at the host rate
+      bool blend_tape_led() {
+        const uint32_t elapsed = milliseconds - tape_led_commit_ms;
+        fract8 amount = 255;
+        if (elapsed < tape_led_interval_ms) {
+          amount = elapsed * 255 / tape_led_interval_ms;
+        } else {
+          tape_led_blending = false;
+        }
+        return RgbHelper::blend_frames(bar_leds, LIGHT_BAR_LEDS,
+                                       bar_prev_leds, bar_next_leds, amount);
+      }
+
+      // Every lights report is read as soon as it's popped, rather than one
+      // per LED frame, so a frame split into segments arrives in one go
+      void receive() {
+        while (HID_Task(lights_out_report, lights_out_state)) {
+          if (current_config.disable_leds) {
+            continue;
+          }
+
+          switch (current_config.bar_effect) {
+            case BarMode::TapeLedP1:
+            case BarMode::TapeLedP2:
+              // Segments are assembled in the staging frame,
+              // and only scaled onto the bar once the host commits the whole frame
+              if (TapeLed::assemble(lights_out_report, bar_staging_leds, LIGHT_BAR_LEDS)) {
+                Latency::received(Latency::Path::Bar, TapeLed::committed_sequence,
+                                  lights_out_state.front_us);
+                commit_tape_led();
+              }
+              break;
+            case BarMode::AudioSpectrum:
+              if (AudioSpectrum::update(lights_out_report)) {
+                Latency::received(Latency::Path::Bar, lights_out_report.sequence,
+                                  lights_out_state.front_us);
+              }
+              break;
+            default:
+              // Nothing shows them, but they still have to make room in the ring
+              break;
+          }
+        }
+      }
+
       bool tape_led(const PlayerSide side) {
-        auto update = false;
-        HID_Task(tape_leds, lights_out_state);
+        // Tape LED frames are in P1 order
+        bool update = set_side(side, PlayerSide::P2);
+
+        if (tape_led_blending) {
+          return blend_tape_led() || update;
+        }
 
         if (lights_out_state.on_standby()) {
           static uint8_t i = 0;
           const auto ticks = tape_led_ticker.get_ticks();
-          update = ticks > 0;
-          if (update) {
+          if (ticks > 0) {
             set_leds_off();
             i = (i + ticks) % LIGHT_BAR_LEDS;
-            bar_leds[LIGHT_BAR_LEDS - 1 - i] = CRGB::White;
-          }
-        } else {
-          for (uint8_t i = 0; i < LIGHT_BAR_LEDS; ++i) {
-            const auto rgb = CRGB(tape_leds[i].r, tape_leds[i].g, tape_leds[i].b);
-            update |= bar_leds[LIGHT_BAR_LEDS - 1 - i] != rgb;
-            bar_leds[LIGHT_BAR_LEDS - 1 - i] = rgb;
+            bar_leds[i] = CRGB::White;
+            return true;
           }
         }
 
-        flip_leds(side);
         return update;
       }
 
+      bool audio_spectrum() {
+        bool update = RgbHelper::set_bar_reversed(false);
+
+        return AudioSpectrum::render(bar_leds, LIGHT_BAR_LEDS) || update;
+      }
+
+      bool custom() {
+        const LightingProgram::inputs in = {
+          .time = milliseconds,
+          .tt_velocity = 0,
+          .tt_pos = 0,
+          .buttons = button_state
+        };
+        return LightingProgram::render(LightingProgram::Slot::Bar,
+                                       bar_leds, LIGHT_BAR_LEDS, in);
+      }
+
       bool update(const rgb_light &lights) {
         auto update = force_update;
 
         switch(current_config.bar_effect) {
+          case BarMode::Beat:
+            update |= beat();
+            break;
           case BarMode::KeySpectrumP1:
             update |= spectrum(PlayerSide::P1);
             break;
           case BarMode::KeySpectrumP2:
             update |= spectrum(PlayerSide::P2);
             break;
+          case BarMode::AudioSpectrum:
+            update |= audio_spectrum();
+            break;
           case BarMode::HID:
             update |= RgbHelper::hid(bar_leds, LIGHT_BAR_LEDS, lights);
             break;
@@ -318,6 +470,10 @@ namespace IIDX {
           case BarMode::Disable:
             update |= set_leds_off();
             break;
+          case BarMode::Custom:
+            update |= RgbHelper::set_bar_reversed(false);
+            update |= custom();
+            break;
           default:
             break;
         }
@@ -330,23 +486,31 @@ namespace IIDX {
     void init(const config &cfg) {
       Turntable::spin_pattern.init(SPIN_TIMER * RgbHelper::tt_anim_normalise,
                                    FAST_SPIN_TIMER * RgbHelper::tt_anim_normalise,
-                                   RgbHelper::num_tt_leds / 2);
+                                   MAX(RgbHelper::num_tt_leds / 2, 1));
+    }
+
+    void receive() {
+      Bar::receive();
     }
 
     void update(const int8_t tt_report,
                 const hid_lights &led_state_from_hid_report) {
-      if (!RgbHelper::ready_to_present()) {
+      if (current_config.disable_leds) {
         return;
       }
 
-      if (Turntable::update(tt_report,
-                            led_state_from_hid_report.tt_lights)) {
-        RgbHelper::show_tt();
+      const bool tt_changed = Turntable::update(tt_report,
+                                                led_state_from_hid_report.tt_lights);
+      if (tt_changed || RgbHelper::tt_needs_show()) {
+        RgbHelper::show_tt(tt_changed);
+        Latency::latched(Latency::Path::Turntable, timer_micros());
       }
 
 #if LIGHT_BAR_LEDS > 0
-      if (Bar::update(led_state_from_hid_report.bar_lights)) {
-        RgbHelper::show_bar();
+      const bool bar_changed = Bar::update(led_state_from_hid_report.bar_lights);
+      if (bar_changed || RgbHelper::bar_needs_show()) {
+        RgbHelper::show_bar(bar_changed);
+        Latency::latched(Latency::Path::Bar, timer_micros());
       }
 #endif
     }
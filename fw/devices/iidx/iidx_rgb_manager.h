@@ -6,13 +6,22 @@
 
 namespace IIDX {
   struct hid_lights {
+#if BUTTON_LIGHT_LEVELS
+    uint8_t buttons[11];
+#else
     uint16_t buttons;
+#endif
     rgb_light tt_lights;
     rgb_light bar_lights;
+#if LATENCY_PROBE
+    uint8_t sequence;
+#endif
   } ATTR_PACKED;
 
   namespace RgbManager {
     void init(const config &cfg);
+    // Called every main loop pass to read lights reports
+    void receive();
     void update(int8_t tt_report, const hid_lights &led_state_from_hid_report);
     namespace Turntable {
       extern bool force_update;
@@ -0,0 +1,88 @@
+#include "iidx_tape_led.h"
+
+namespace IIDX {
+  namespace TapeLed {
+    uint8_t committed_sequence = 0;
+    uint8_t committed_length = 0;
+    uint8_t pending_length = 0;
+    uint8_t pending_sequence = 0;
+    // Where the next segment of the pending frame has to start
+    uint16_t pending_end = 0;
+    // Every segment of the pending frame so far has arrived
+    bool pending_whole = false;
+
+    // Both return the LED after the last one written
+    uint8_t decode_raw(const segment_report &report, CRGB* staging, const uint8_t end) {
+      const uint8_t* data = report.data;
+      const uint8_t* const data_end = report.data + DATA_SIZE;
+      uint8_t i = report.offset;
+      for (; i < end && data + 3 <= data_end; i++) {
+        staging[i] = CRGB(data[0], data[1], data[2]);
+        data += 3;
+      }
+      return i;
+    }
+
+    uint8_t decode_rle(const segment_report &report, CRGB* staging, const uint8_t end) {
+      const uint8_t* data = report.data;
+      const uint8_t* const data_end = report.data + DATA_SIZE;
+      uint8_t i = report.offset;
+      while (i < end && data + 4 <= data_end) {
+        const uint8_t count = data[0];
+        if (count == 0) {
+          break;
+        }
+
+        const CRGB rgb(data[1], data[2], data[3]);
+        for (uint8_t j = 0; j < count && i < end; j++) {
+          staging[i++] = rgb;
+        }
+        data += 4;
+      }
+      return i;
+    }
+
+    bool assemble(const segment_report &report, CRGB* staging, const uint8_t n) {
+      if (report.version != PROTOCOL_VERSION ||
+          report.flags & FLAG_SPECTRUM) {
+        return false;
+      }
+
+      if (report.offset == 0) {
+        // First segment of a new frame, whatever was pending is gone
+        pending_sequence = report.sequence;
+        pending_end = 0;
+        pending_length = 0;
+        pending_whole = true;
+      } else if (!pending_whole ||
+                 report.sequence != pending_sequence ||
+                 report.offset != pending_end) {
+        pending_whole = false;
+        return false;
+      }
+      pending_end = static_cast<uint16_t>(report.offset) + report.length;
+
+      if (report.offset < n) {
+        const uint8_t end = MIN(static_cast<uint16_t>(report.offset) + report.length, n);
+        const uint8_t written = report.flags & FLAG_RLE ?
+          decode_rle(report, staging, end) :
+          decode_raw(report, staging, end);
+        if (written < end) {
+          // The segment doesn't carry all the LEDs it claims to, that's a hole
+          pending_whole = false;
+          return false;
+        }
+        pending_length = MAX(pending_length, end);
+      }
+
+      if (report.flags & FLAG_COMMIT) {
+        pending_whole = false;
+        committed_sequence = report.sequence;
+        committed_length = pending_length;
+        pending_length = 0;
+        return true;
+      }
+      return false;
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <FastLED/src/FastLED.h>
+
+#include "../Descriptors.h"
+
+namespace IIDX {
+  namespace TapeLed {
+    // Lights OUT reports carry a segment of the tape LED frame, so bars
+    // with more LEDs than fit into a single report can still be driven.
+    // A frame is sent as segments from LED 0 up, in order, all with the same
+    // sequence number, and the last one commits it. A frame with a segment
+    // missing, out of order or from another frame is dropped, never shown torn
+    enum : uint8_t {
+      PROTOCOL_VERSION = 1,
+
+      // Present the assembled frame after this segment
+      FLAG_COMMIT = 1 << 0,
+      // data holds (count, r, g, b) runs instead of raw RGB
+      FLAG_RLE = 1 << 1,
+      // Audio spectrum frame instead, see iidx_audio_spectrum.h
+      FLAG_SPECTRUM = 1 << 2,
+
+      HEADER_SIZE = 5,
+      DATA_SIZE = HID_EPSIZE - HEADER_SIZE
+    };
+
+    struct segment_report {
+      uint8_t version;
+      uint8_t flags;
+      uint8_t sequence; // frame sequence number, shared by all segments of a frame
+      uint8_t offset;   // first LED in this segment
+      uint8_t length;   // number of LEDs in this segment
+      uint8_t data[DATA_SIZE];
+    } ATTR_PACKED;
+
+    static_assert(sizeof(segment_report) == HID_EPSIZE, "Segment must fill a whole report");
+
+    extern uint8_t committed_sequence;
+    // Number of LEDs the host sent in the last committed frame,
+    // may be less than the bar has, in which case it gets upscaled
+    extern uint8_t committed_length;
+
+    // Writes the segment into staging, returns true if a whole frame should be presented
+    bool assemble(const segment_report &report, CRGB* staging, uint8_t n);
+  }
+}
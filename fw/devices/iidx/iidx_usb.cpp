@@ -1,6 +1,8 @@
 #include "../analog_button.h"
 #include "../axis.h"
 #include "../beef.h"
+#include "../chatter.h"
+#include "../latency.h"
 #include "iidx_combo.h"
 #include "iidx_usb.h"
 #include "iidx_usb_desc.h"
@@ -11,8 +13,13 @@ namespace IIDX {
     uint8_t  X;
     uint8_t  Y; // Needed for LR2 compatibility
     uint16_t Button; // bit-field representing which buttons have been pressed
+#if LATENCY_PROBE
+    uint8_t sequence; // last lights OUT sequence received
+#endif
   } ATTR_PACKED;
 
+  static_assert(sizeof(hid_lights) <= JOYSTICK_OUT_SIZE, "Lights report doesn't fit in the OUT buffers");
+
   HidReport<USB_JoystickReport_Data_t, INTERFACE_ID_Joystick, JOYSTICK_IN_EPADDR> joystick_hid_report;
   HidReport<Beef::USB_KeyboardReport_Data_t, INTERFACE_ID_Keyboard, KEYBOARD_IN_EPADDR> keyboard_hid_report;
   UsbHandler usb_handler;
@@ -35,6 +42,24 @@ namespace IIDX {
     button_state = effectors_debounce.debounce(button_state, EFFECTORS_ALL);
   }
 
+  void set_auto_debounce(const config &config) {
+    for (uint8_t i = 0; i < BUTTONS; i++) {
+      if ((1 << i) & MAIN_BUTTONS_ALL) {
+        buttons_debounce.set_window(i, Chatter::window(i, config.iidx_buttons_debounce));
+      } else {
+        effectors_debounce.set_window(i, Chatter::window(i, config.iidx_effectors_debounce));
+      }
+    }
+  }
+
+  void init_debounce(const config &config) {
+    buttons_debounce.init(config.iidx_buttons_debounce);
+    effectors_debounce.init(config.iidx_effectors_debounce);
+    if (config.debounce_auto) {
+      set_auto_debounce(config);
+    }
+  }
+
   bool UsbHandler::create_hid_report(USB_ClassInfo_HID_Device_t* const hid_interface_info,
                                      uint8_t* const report_id,
                                      void* report_data,
@@ -51,6 +76,9 @@ namespace IIDX {
         joystick_report->X = tt_x.get();
         joystick_report->Y = 127;
         joystick_report->Button = (upper << 8) | lower;
+#if LATENCY_PROBE
+        joystick_report->sequence = led_data.sequence;
+#endif
 
         return true;
       }
@@ -82,16 +110,43 @@ namespace IIDX {
   }
 
   void UsbHandler::update(const config &config) {
+#if LATENCY_PROBE
+    if (HID_Task(led_data, joystick_out_state)) {
+      // Strips only show the host's colours in HID mode
+      const auto at = joystick_out_state.front_us;
+      Latency::received(Latency::Path::Lamps, led_data.sequence, at);
+      if (config.tt_effect == TurntableMode::HID) {
+        Latency::received(Latency::Path::Turntable, led_data.sequence, at);
+      }
+      if (config.bar_effect == BarMode::HID) {
+        Latency::received(Latency::Path::Bar, led_data.sequence, at);
+      }
+    }
+#else
     HID_Task(led_data, joystick_out_state);
+#endif
+    RgbManager::receive();
+
+    if (config.debounce_auto && Chatter::windows_changed()) {
+      set_auto_debounce(config);
+    }
 
     tt_x.poll();
-    const auto tt1_report = button_x.poll(config.tt_deadzone,
-                                          config.tt_sustain_ms,
-                                          tt_x.get());
+    tt1_report = button_x.poll(config.tt_deadzone,
+                               config.tt_sustain_ms,
+                               tt_x.get());
     process_buttons(tt1_report);
 
+#if BUTTON_LIGHT_LEVELS
+    update_button_brightness(led_data.buttons, sizeof(led_data.buttons));
+#else
     update_button_lighting(led_data.buttons);
-    RgbManager::update(tt1_report, led_data);
+#endif
+  }
+
+  void UsbHandler::render(void* self) {
+    const auto handler = static_cast<UsbHandler*>(self);
+    RgbManager::update(handler->tt1_report, handler->led_data);
   }
 
   void UsbHandler::config_update(const config &new_config) {
@@ -104,22 +159,23 @@ namespace IIDX {
       RgbManager::Bar::force_update = true;
     }
     update_tt_transitions(new_config.reverse_tt);
-    buttons_debounce.init(new_config.iidx_buttons_debounce);
-    effectors_debounce.init(new_config.iidx_effectors_debounce);
+    init_debounce(new_config);
   }
 
   void usb_init(const config &config) {
     usb_desc_init();
 
     ::usb_handler = &usb_handler;
+#ifdef CONTROLLER_UNIVERSAL
     get_button_combo_callback = get_button_combo;
+#endif
 
     button_x.init(config.tt_deadzone, true, tt_x.get());
-    buttons_debounce.init(config.iidx_buttons_debounce);
-    effectors_debounce.init(config.iidx_effectors_debounce);
+    init_debounce(config);
 
     update_tt_transitions(config.reverse_tt);
 
     RgbManager::init(config);
+    RgbHelper::start(UsbHandler::render, &usb_handler);
   }
 }
@@ -6,7 +6,7 @@
 #include "iidx_rgb_manager.h"
 
 namespace IIDX {
-  class UsbHandler : public AbstractUsbHandler {
+  class UsbHandler final : public AbstractUsbHandler {
   public:
     UsbHandler() = default;
 
@@ -18,8 +18,11 @@ namespace IIDX {
     void update(const config &config) override;
     void config_update(const config &new_config) override;
 
+    static void render(void* self);
+
   private:
     hid_lights led_data{};
+    int8_t tt1_report{};
   };
 
   void usb_init(const config &config);
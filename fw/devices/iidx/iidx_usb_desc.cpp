@@ -1,4 +1,5 @@
 #include "../Descriptors.h"
+#include "iidx_tape_led.h"
 #include "iidx_usb_desc.h"
 
 namespace IIDX {
@@ -25,6 +26,19 @@ namespace IIDX {
       HID_BUTTONS(14),
 
       // Button lighting
+#if BUTTON_LIGHT_LEVELS
+      HID_BUTTON_LIGHT_LEVEL(1),
+      HID_BUTTON_LIGHT_LEVEL(2),
+      HID_BUTTON_LIGHT_LEVEL(3),
+      HID_BUTTON_LIGHT_LEVEL(4),
+      HID_BUTTON_LIGHT_LEVEL(5),
+      HID_BUTTON_LIGHT_LEVEL(6),
+      HID_BUTTON_LIGHT_LEVEL(7),
+      HID_BUTTON_LIGHT_LEVEL(8),
+      HID_BUTTON_LIGHT_LEVEL(9),
+      HID_BUTTON_LIGHT_LEVEL(10),
+      HID_BUTTON_LIGHT_LEVEL(11),
+#else
       HID_BUTTON_LIGHT(1),
       HID_BUTTON_LIGHT(2),
       HID_BUTTON_LIGHT(3),
@@ -37,12 +51,18 @@ namespace IIDX {
       HID_BUTTON_LIGHT(10),
       HID_BUTTON_LIGHT(11),
       HID_PADDING_OUTPUT(5),
+#endif
 
       // TT WS2812
       HID_RGB(12),
 
       // Bar WS2812
       HID_RGB(15),
+
+#if LATENCY_PROBE
+      HID_LIGHTS_SEQUENCE,
+      HID_INPUT_SEQUENCE,
+#endif
     HID_RI_END_COLLECTION(0)
   };
 
@@ -52,10 +72,10 @@ namespace IIDX {
     HID_RI_LOGICAL_MINIMUM(8, 0x00),
     HID_RI_LOGICAL_MAXIMUM(16, 0xFF),
     HID_RI_COLLECTION(8, 0x01),
-      // Tape LED
+      // Tape LED frame segment, see iidx_tape_led.h
       HID_RI_USAGE(8, 1),
-      HID_RI_REPORT_SIZE(8, 0x08 * 3),
-      HID_RI_REPORT_COUNT(8, LIGHT_BAR_LEDS),
+      HID_RI_REPORT_SIZE(8, 0x08),
+      HID_RI_REPORT_COUNT(8, sizeof(TapeLed::segment_report)),
       HID_RI_OUTPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
     HID_RI_END_COLLECTION(0)
   };
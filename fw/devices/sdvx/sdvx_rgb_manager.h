@@ -2,6 +2,13 @@
 
 namespace SDVX {
   struct hid_lights {
+#if BUTTON_LIGHT_LEVELS
+    uint8_t buttons[9]; // 7 and 8 are padding
+#else
     uint16_t buttons;
+#endif
+#if LATENCY_PROBE
+    uint8_t sequence;
+#endif
   } ATTR_PACKED;
 }
@@ -1,6 +1,9 @@
 #include "../analog_button.h"
 #include "../axis.h"
 #include "../beef.h"
+#include "../chatter.h"
+#include "../knob_filter.h"
+#include "../latency.h"
 #include "sdvx_combo.h"
 #include "sdvx_usb.h"
 #include "sdvx_usb_desc.h"
@@ -10,16 +13,42 @@ namespace SDVX {
     uint8_t  X;
     uint8_t  Y;
     uint16_t Button; // bit-field representing which buttons have been pressed
+#if LATENCY_PROBE
+    uint8_t sequence; // last lights OUT sequence received
+#endif
   } ATTR_PACKED;
 
+  static_assert(sizeof(hid_lights) <= JOYSTICK_OUT_SIZE, "Lights report doesn't fit in the OUT buffers");
+
   HidReport<USB_JoystickReport_Data_t, INTERFACE_ID_Joystick, JOYSTICK_IN_EPADDR> joystick_hid_report;
   HidReport<Beef::USB_KeyboardReport_Data_t, INTERFACE_ID_Keyboard, KEYBOARD_IN_EPADDR> keyboard_hid_report;
   HidReport<Beef::USB_MouseReport_Data_t, INTERFACE_ID_Mouse, MOUSE_IN_EPADDR> mouse_hid_report;
   UsbHandler usb_handler;
   Debouncer<9> debouncer;
 
-  Axis* axis_x;
-  Axis* axis_y;
+#ifdef CONTROLLER_SDVX
+  // Knobs are always analog in SDVX builds, so poll()/get() can be inlined
+  typedef AnalogAxis KnobAxis;
+#else
+  typedef Axis KnobAxis;
+#endif
+  KnobAxis* axis_x;
+  KnobAxis* axis_y;
+  KnobFilter filter_x;
+  KnobFilter filter_y;
+
+  void set_auto_debounce(const config &config) {
+    for (uint8_t i = 0; i < 9; i++) {
+      debouncer.set_window(i, Chatter::window(i, config.sdvx_buttons_debounce));
+    }
+  }
+
+  void init_debounce(const config &config) {
+    debouncer.init(config.sdvx_buttons_debounce);
+    if (config.debounce_auto) {
+      set_auto_debounce(config);
+    }
+  }
 
   bool UsbHandler::create_hid_report(USB_ClassInfo_HID_Device_t* const hid_interface_info,
                                      uint8_t* const report_id,
@@ -30,9 +59,12 @@ namespace SDVX {
         auto joystick_report = (USB_JoystickReport_Data_t*)report_data;
         *report_size = sizeof(*joystick_report);
 
-        joystick_report->X = axis_x->get();
-        joystick_report->Y = axis_y->get();
+        joystick_report->X = filter_x.get();
+        joystick_report->Y = filter_y.get();
         joystick_report->Button = button_state;
+#if LATENCY_PROBE
+        joystick_report->sequence = led_data.sequence;
+#endif
 
         return true;
       }
@@ -74,33 +106,56 @@ namespace SDVX {
   }
 
   void UsbHandler::update(const config &config) {
+#if LATENCY_PROBE
+    if (HID_Task(led_data, joystick_out_state)) {
+      Latency::received(Latency::Path::Lamps, led_data.sequence, joystick_out_state.front_us);
+    }
+#else
     HID_Task(led_data, joystick_out_state);
+#endif
+    // SDVX has no light bar, this keeps the host from being held up
+    HID_Discard(lights_out_state);
 
     axis_x->poll();
     axis_y->poll();
-    button_x.poll(1, 0, axis_x->get());
-    button_y.poll(1, 0, axis_y->get());
+    filter_x.update(axis_x->get(), milliseconds);
+    filter_y.update(axis_y->get(), milliseconds);
+    button_x.poll(1, 0, filter_x.get());
+    button_y.poll(1, 0, filter_y.get());
 
+    if (config.debounce_auto && Chatter::windows_changed()) {
+      set_auto_debounce(config);
+    }
     button_state = debouncer.debounce(button_state);
 
+#if BUTTON_LIGHT_LEVELS
+    update_button_brightness(led_data.buttons, sizeof(led_data.buttons));
+#else
     update_button_lighting(led_data.buttons);
+#endif
   }
 
   void UsbHandler::config_update(const config &new_config) {
-    debouncer.init(new_config.sdvx_buttons_debounce);
+    init_debounce(new_config);
+    filter_x.init(new_config.knob_min_cutoff, new_config.knob_beta, filter_x.get());
+    filter_y.init(new_config.knob_min_cutoff, new_config.knob_beta, filter_y.get());
   }
 
   void usb_init(const config &config) {
     usb_desc_init();
 
     ::usb_handler = &usb_handler;
+#ifdef CONTROLLER_UNIVERSAL
     get_button_combo_callback = get_button_combo;
+#endif
 
     axis_x = &analog_x;
     axis_y = &analog_y;
-    button_x.init(1, false, axis_x->get());
-    button_y.init(1, false, axis_y->get());
-    debouncer.init(config.sdvx_buttons_debounce);
+    filter_x.init(config.knob_min_cutoff, config.knob_beta, axis_x->get());
+    filter_y.init(config.knob_min_cutoff, config.knob_beta, axis_y->get());
+    button_x.init(1, false, filter_x.get());
+    button_y.init(1, false, filter_y.get());
+    init_debounce(config);
 
     update_tt_transitions(false);
   }
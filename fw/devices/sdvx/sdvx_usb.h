@@ -5,7 +5,7 @@
 #include "sdvx_rgb_manager.h"
 
 namespace SDVX {
-  class UsbHandler : public AbstractUsbHandler {
+  class UsbHandler final : public AbstractUsbHandler {
   public:
     UsbHandler() = default;
 
@@ -25,6 +25,16 @@ namespace SDVX {
       HID_BUTTONS(9),
 
       // Button lighting
+#if BUTTON_LIGHT_LEVELS
+      HID_BUTTON_LIGHT_LEVEL(1),
+      HID_BUTTON_LIGHT_LEVEL(2),
+      HID_BUTTON_LIGHT_LEVEL(3),
+      HID_BUTTON_LIGHT_LEVEL(4),
+      HID_BUTTON_LIGHT_LEVEL(5),
+      HID_BUTTON_LIGHT_LEVEL(6),
+      HID_PADDING_OUTPUT(16),
+      HID_BUTTON_LIGHT_LEVEL(7),
+#else
       HID_BUTTON_LIGHT(1),
       HID_BUTTON_LIGHT(2),
       HID_BUTTON_LIGHT(3),
@@ -34,6 +44,12 @@ namespace SDVX {
       HID_PADDING_OUTPUT(2),
       HID_BUTTON_LIGHT(7),
       HID_PADDING_OUTPUT(7),
+#endif
+
+#if LATENCY_PROBE
+      HID_LIGHTS_SEQUENCE,
+      HID_INPUT_SEQUENCE,
+#endif
     HID_RI_END_COLLECTION(0)
   };
 
@@ -1,11 +1,128 @@
+#include <util/atomic.h>
+
 #include "hid.h"
+#include "timer.h"
 
 bool reactive_led = true;
+
+uint8_t joystick_out_buffer[JOYSTICK_OUT_SIZE];
+uint32_t joystick_out_us[1];
+uint8_t lights_out_buffer[LIGHTS_OUT_SLOTS][LIGHTS_OUT_SIZE];
+uint32_t lights_out_us[LIGHTS_OUT_SLOTS];
+
+// Each lamp report replaces the last one, so only the newest is kept
 hid_state joystick_out_state = {
   .endpoint = JOYSTICK_OUT_EPADDR,
-  .hid_expiry_timer = {}
+  .size = JOYSTICK_OUT_SIZE,
+  .slots = 1,
+  .buffer = joystick_out_buffer,
+  .slot_us = joystick_out_us
 };
 hid_state lights_out_state = {
   .endpoint = LIGHTS_OUT_EPADDR,
-  .hid_expiry_timer = {}
+  .size = LIGHTS_OUT_SIZE,
+  .slots = LIGHTS_OUT_SLOTS,
+  .buffer = lights_out_buffer[0],
+  .slot_us = lights_out_us
 };
+
+bool hid_state::on_standby() const {
+  bool standby;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    standby = !received || milliseconds - report_ms > HID_EXPIRY_TIME;
+  }
+  return standby;
+}
+
+uint8_t* hid_back_buffer(hid_state &state) {
+  if (state.count == state.slots) {
+    if (state.slots > 1) {
+      return nullptr;
+    }
+    // A newer report replaces one the main loop hasn't picked up yet
+    state.count = 0;
+  }
+
+  const uint8_t slot = (state.head + state.count) % state.slots;
+  return state.buffer + slot * state.size;
+}
+
+void hid_push(hid_state &state, const uint8_t length) {
+  const uint8_t slot = (state.head + state.count) % state.slots;
+  // Shorter reports than we expect leave the rest zeroed, rather than stale
+  memset(state.buffer + slot * state.size + length, 0, state.size - length);
+  state.slot_us[slot] = timer_micros();
+  state.count++;
+
+  state.received = true;
+  state.report_ms = milliseconds;
+}
+
+void receive(hid_state &state) {
+  Endpoint_SelectEndpoint(state.endpoint);
+
+  // Both banks might be full if we were held up
+  while (Endpoint_IsOUTReceived()) {
+    const uint8_t length = MIN(Endpoint_BytesInEndpoint(), static_cast<uint16_t>(state.size));
+    if (length > 0) {
+      uint8_t* const buffer = hid_back_buffer(state);
+      if (!buffer) {
+        // Stays in the bank until the main loop has made room
+        break;
+      }
+      for (uint8_t i = 0; i < length; i++) {
+        buffer[i] = Endpoint_Read_8();
+      }
+      hid_push(state, length);
+    }
+
+    Endpoint_ClearOUT();
+  }
+}
+
+void hid_receive() {
+  if (USB_DeviceState != DEVICE_STATE_Configured) {
+    return;
+  }
+
+  const uint8_t prev_endpoint = Endpoint_GetCurrentEndpoint();
+  receive(joystick_out_state);
+  receive(lights_out_state);
+  Endpoint_SelectEndpoint(prev_endpoint);
+}
+
+bool HID_Task(void* led_state, const uint16_t size, hid_state &state) {
+  const uint16_t length = MIN(size, static_cast<uint16_t>(state.size));
+  const uint8_t* report = nullptr;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (state.count > 0) {
+      report = state.buffer + state.head * state.size;
+      state.front_us = state.slot_us[state.head];
+      // A single slot gets overwritten by the next report, so take it now
+      if (state.slots == 1) {
+        memcpy(led_state, report, length);
+        state.count = 0;
+      }
+    }
+  }
+
+  if (!report) {
+    return false;
+  }
+
+  if (state.slots > 1) {
+    // The interrupt doesn't touch a queued slot, so this can't tear
+    memcpy(led_state, report, length);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      state.head = (state.head + 1) % state.slots;
+      state.count--;
+    }
+  }
+  return true;
+}
+
+void HID_Discard(hid_state &state) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    state.count = 0;
+  }
+}
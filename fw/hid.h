@@ -1,15 +1,41 @@
 #pragma once
 
 #include "Descriptors.h"
-#include "timer.h"
 
+enum {
+  HID_EXPIRY_TIME = 1000,
+
+  // Largest OUT reports we buffer, devices static_assert theirs fit
+  JOYSTICK_OUT_SIZE = 24,
+  LIGHTS_OUT_SIZE = HID_EPSIZE,
+  // Tape LED frames come in several segments that all have to be shown
+  LIGHTS_OUT_SLOTS = 4
+};
+
+// OUT reports are drained from the endpoint in the Start of Frame interrupt,
+// so they don't sit NAKed while the main loop is busy showing LEDs.
+// They're queued in a ring of whole reports, which the main loop pops one at a time.
+// A ring of one slot only keeps the newest report, for reports that fully
+// replace the last one. A longer ring that's full leaves new reports in the
+// endpoint, so the host is NAKed until the main loop catches up and nothing is lost.
 struct hid_state {
   uint8_t endpoint;
-  timer hid_expiry_timer;
+  uint8_t size;
+  uint8_t slots;
+  uint8_t* const buffer;
+  // When each queued report arrived, from timer_micros()
+  uint32_t* const slot_us;
+  // Oldest queued report
+  volatile uint8_t head;
+  volatile uint8_t count;
+  volatile bool received;
+  // When the newest report arrived, the lights go back on standby
+  // once the host hasn't sent anything for HID_EXPIRY_TIME
+  volatile uint32_t report_ms;
+  // When the last report HID_Task popped arrived, from timer_micros()
+  uint32_t front_us;
 
-  bool on_standby() {
-    return timer_is_expired(&hid_expiry_timer);
-  }
+  bool on_standby() const;
 };
 
 // flag to represent whether the LEDs are controlled by host or not
@@ -55,19 +81,18 @@ struct HidReport {
 };
 
 // HID functions
-template<typename T>
-void HID_Task(T &led_state, hid_state &state) {
-  Endpoint_SelectEndpoint(state.endpoint);
+// Called from the Start of Frame interrupt
+void hid_receive();
+// Where the next report goes, or nullptr if the ring is full. Interrupts must be off
+uint8_t* hid_back_buffer(hid_state &state);
+// Queues the report written to hid_back_buffer(). Interrupts must be off
+void hid_push(hid_state &state, uint8_t length);
+// Returns true if the oldest queued report was popped and copied to led_state
+bool HID_Task(void* led_state, uint16_t size, hid_state &state);
+// Drops every queued report, for endpoints nothing reads right now
+void HID_Discard(hid_state &state);
 
-  // check if a packet has been sent from the host
-  if (Endpoint_IsOUTReceived()) {
-    // check if packet contains data
-    if (Endpoint_IsReadWriteAllowed()) { // read generic report data
-      Endpoint_Read_Stream_LE(&led_state, sizeof(T), nullptr);
-      timer_arm(&state.hid_expiry_timer, 1000);
-    }
-
-    // finalize the stream transfer to send the last packet
-    Endpoint_ClearOUT();
-  }
+template<typename T>
+bool HID_Task(T &led_state, hid_state &state) {
+  return HID_Task(&led_state, sizeof(T), state);
 }
@@ -0,0 +1,62 @@
+#include <LUFA/Common/Common.h>
+
+#include "knob_filter.h"
+
+namespace {
+  // Smoothing factor for a cutoff in 0.1 Hz over elapsed_ms, in 0.16 fixed point.
+  // alpha = w / (1 + w) with w = 2π * cutoff * elapsed, which is
+  // 1 - 1 / (1 + w), so it only takes one division
+  uint16_t alpha(const uint16_t cutoff, const uint8_t elapsed_ms) {
+    // 2π / 10 Hz / 1000 ms in 0.16 fixed point
+    constexpr uint32_t W_SCALE = 41;
+    const uint32_t w = static_cast<uint32_t>(cutoff) * elapsed_ms * W_SCALE;
+    return 65536 - UINT32_MAX / (w + 65536);
+  }
+
+  // Scales delta by an alpha from alpha(), rounding to nearest
+  int32_t scale(const uint16_t a, const int32_t delta) {
+    return (static_cast<int32_t>(a) * delta + 32768) >> 16;
+  }
+}
+
+void KnobFilter::init(const uint8_t min_cutoff, const uint8_t beta, const uint8_t current_value) {
+  this->min_cutoff = min_cutoff;
+  this->beta = beta;
+  value = current_value << 8;
+  speed = 0;
+  output = current_value;
+}
+
+void KnobFilter::update(const uint8_t raw, const uint32_t now_ms) {
+  if (min_cutoff == 0) {
+    output = raw;
+    return;
+  }
+
+  const uint32_t elapsed = now_ms - last_ms;
+  if (elapsed == 0) {
+    return;
+  }
+  last_ms = now_ms;
+  const uint8_t elapsed_ms = MIN(elapsed, static_cast<uint32_t>(UINT8_MAX));
+
+  // Shortest way round from the filtered value to the reading
+  const int16_t delta = static_cast<int16_t>((raw << 8) - value);
+
+  int32_t raw_speed = (static_cast<int32_t>(delta) * 1000 >> 8) / elapsed_ms;
+  raw_speed = MAX(MIN(raw_speed, static_cast<int32_t>(MAX_SPEED)), -static_cast<int32_t>(MAX_SPEED));
+  speed += scale(alpha(SPEED_CUTOFF, elapsed_ms), raw_speed - speed);
+
+  const uint16_t abs_speed = speed < 0 ? -speed : speed;
+  const uint16_t cutoff = min_cutoff + static_cast<uint32_t>(beta) * abs_speed / 100;
+  value += scale(alpha(cutoff, elapsed_ms), delta);
+
+  const int16_t from_output = static_cast<int16_t>(value - (output << 8));
+  if (from_output > DEAD_BAND || from_output < -DEAD_BAND) {
+    output = (value + 128) >> 8;
+  }
+}
+
+uint8_t KnobFilter::get() const {
+  return output;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// 1€ filter (Casiez et al.) for the SDVX knob ADC readings, in fixed point.
+// The cutoff frequency rises with the knob's speed, so a knob at rest is
+// filtered hard enough to hide ADC flicker, while a fast turn barely lags.
+// Readings wrap around like the knobs do. Only one update per millisecond
+// tick does any work, so it's cheap to call every main loop pass.
+class KnobFilter {
+public:
+  enum : uint16_t {
+    // Cutoff for the speed estimate, in 0.1 Hz
+    SPEED_CUTOFF = 10,
+    // Speeds are clamped to this, in LSB/s, so the maths fits in 32 bits
+    MAX_SPEED = 16383,
+    // How far the filtered value has to be from the output before the output
+    // moves, in 1/256 LSB: half a step to where it rounds to the next value,
+    // plus a quarter LSB so a value sitting between two steps doesn't flicker.
+    // 3/4 LSB either side in all
+    DEAD_BAND = 128 + 64
+  };
+
+  KnobFilter() = default;
+
+  // min_cutoff in 0.1 Hz, 0 turns filtering off.
+  // beta in 0.001 Hz added to the cutoff per LSB/s of speed
+  void init(uint8_t min_cutoff, uint8_t beta, uint8_t current_value);
+  void update(uint8_t raw, uint32_t now_ms);
+  uint8_t get() const;
+
+private:
+  uint8_t min_cutoff{};
+  uint8_t beta{};
+  uint16_t value{};  // 8.8 fixed point, wraps around with the reading
+  int16_t speed{};   // LSB/s
+  uint8_t output{};
+  uint32_t last_ms{};
+};
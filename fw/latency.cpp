@@ -0,0 +1,74 @@
+#include <util/atomic.h>
+
+#include "latency.h"
+#include "timer.h"
+
+namespace Latency {
+  struct pending_frame {
+    uint8_t sequence;
+    uint32_t received_us;
+  };
+
+  pending_frame pending[uint8_t(Path::Count)];
+
+  // Single bytes, so the interrupt can read them without locking
+  volatile uint8_t last_latched[uint8_t(Path::Count)];
+
+  sample queue[QUEUE_SIZE];
+  uint8_t queue_head = 0;
+  uint8_t queue_count = 0;
+  uint8_t dropped = 0;
+
+  void received(const Path path, const uint8_t sequence, const uint32_t received_us) {
+    pending[uint8_t(path)] = {
+      .sequence = sequence,
+      .received_us = received_us
+    };
+  }
+
+  void latched(const Path path, const uint32_t latched_us) {
+    auto &frame = pending[uint8_t(path)];
+    if (frame.sequence == 0) {
+      return;
+    }
+
+    const sample s = {
+      .path = path,
+      .sequence = frame.sequence,
+      .received_us = frame.received_us,
+      .latch_us = static_cast<uint16_t>(MIN(latched_us - frame.received_us, static_cast<uint32_t>(UINT16_MAX)))
+    };
+    frame.sequence = 0;
+    last_latched[uint8_t(path)] = s.sequence;
+
+    // The report is filled from an interrupt
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (queue_count == QUEUE_SIZE) {
+        dropped = MIN(dropped + 1, UINT8_MAX);
+        return;
+      }
+      queue[(queue_head + queue_count) % QUEUE_SIZE] = s;
+      queue_count++;
+    }
+  }
+
+  void fill_report(latency_report &report) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      report.now_us = timer_micros();
+      report.count = MIN(queue_count, static_cast<uint8_t>(REPORT_SAMPLES));
+      report.dropped = dropped;
+      for (uint8_t i = 0; i < report.count; i++) {
+        report.samples[i] = queue[queue_head];
+        queue_head = (queue_head + 1) % QUEUE_SIZE;
+      }
+      queue_count -= report.count;
+      dropped = 0;
+    }
+  }
+
+  void fill_latched_report(latched_report &report) {
+    for (uint8_t i = 0; i < uint8_t(Path::Count); i++) {
+      report.sequence[i] = last_latched[i];
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <LUFA/Common/Common.h>
+
+// Records how long light frames take from arriving over USB to reaching the
+// lamps or LED strips. Frames are matched up by the host's sequence number,
+// from the tape LED header or the joystick report's sequence field in
+// LATENCY_PROBE builds. Sequence 0 means the host isn't tagging frames.
+namespace Latency {
+  enum class Path : uint8_t {
+    Lamps,
+    Turntable,
+    Bar,
+    Count
+  };
+
+  struct sample {
+    Path path;
+    uint8_t sequence;
+    uint32_t received_us; // when the report was drained from the endpoint
+    uint16_t latch_us;    // received to latched, saturates at 65535
+  } ATTR_PACKED;
+
+  enum : uint8_t {
+    REPORT_SAMPLES = 7,
+    QUEUE_SIZE = 16
+  };
+
+  // Returned by the Latency feature report, oldest samples first.
+  // Samples are only returned once, so poll faster than frames arrive
+  struct latency_report {
+    uint32_t now_us; // for lining the device clock up with the host
+    uint8_t count;
+    uint8_t dropped; // samples lost to a full queue since the last report
+    sample samples[REPORT_SAMPLES];
+  } ATTR_PACKED;
+
+  // Returned by the Latched feature report. Reading it doesn't use anything up,
+  // so a host can pace itself on it while another reads the Latency report
+  struct latched_report {
+    uint8_t sequence[uint8_t(Path::Count)]; // last tagged frame latched on each path, 0 before any
+  } ATTR_PACKED;
+
+  // A tagged frame arrived. Replaces any earlier frame on the path that never made it out
+  void received(Path path, uint8_t sequence, uint32_t received_us);
+  // The latest frame on the path reached the output
+  void latched(Path path, uint32_t latched_us);
+
+  // Called from the control request interrupt
+  void fill_report(latency_report &report);
+  void fill_latched_report(latched_report &report);
+}
@@ -0,0 +1,259 @@
+#include <avr/eeprom.h>
+#include <string.h>
+#include <util/atomic.h>
+
+#include "config.h"
+#include "lighting_program.h"
+#include "rgb_helper.h"
+
+// Reserved EEPROM area after the config
+#define PROGRAM_BASE_ADDR (uint8_t*)512
+static_assert(2 + sizeof(config) <= 512, "Config overlaps lighting programs in EEPROM");
+
+namespace LightingProgram {
+  struct program {
+    uint8_t length;
+    uint8_t code[MAX_PROGRAM_SIZE];
+  };
+
+  program programs[uint8_t(Slot::Count)];
+  // One bit per slot, so a program switched off for not fitting stays in EEPROM
+  volatile uint8_t save_pending = 0;
+  volatile bool reload_pending = false;
+
+  uint8_t* eeprom_addr(const Slot slot) {
+    return PROGRAM_BASE_ADDR + uint8_t(slot) * sizeof(program);
+  }
+
+  bool has_imm(const Op op) {
+    switch (op) {
+      case Op::Push:
+      case Op::Time:
+      case Op::Button:
+      case Op::Jz:
+      case Op::Jmp:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  uint8_t num_leds(const Slot slot) {
+    return slot == Slot::Turntable ? RgbHelper::num_tt_leds : LIGHT_BAR_LEDS;
+  }
+
+  bool validate(const uint8_t* code, const uint8_t length, const uint8_t n) {
+    if (length > MAX_PROGRAM_SIZE) {
+      return false;
+    }
+
+    // Where each op starts, and where jumps land. Jumps only go forwards, so
+    // the targets are checked once every op is known
+    uint8_t starts[MAX_PROGRAM_SIZE / 8 + 1] = {};
+    uint8_t targets[MAX_PROGRAM_SIZE / 8 + 1] = {};
+    uint8_t ops = 0;
+    for (uint8_t pc = 0; pc < length; pc++) {
+      const auto op = Op(code[pc]);
+      if (op >= Op::Count) {
+        return false;
+      }
+      starts[pc / 8] |= 1 << (pc % 8);
+      ops++;
+      if (!has_imm(op)) {
+        continue;
+      }
+
+      if (++pc >= length) {
+        return false;
+      }
+      if (op == Op::Jz || op == Op::Jmp) {
+        // Jumping to the end is the same as End
+        const uint16_t target = pc + 1 + code[pc];
+        if (target > length) {
+          return false;
+        }
+        targets[target / 8] |= 1 << (target % 8);
+      }
+    }
+    starts[length / 8] |= 1 << (length % 8);
+
+    for (uint8_t i = 0; i < sizeof(targets); i++) {
+      if (targets[i] & ~starts[i]) {
+        return false;
+      }
+    }
+
+    // No op runs twice, so this is the most a frame can take
+    return static_cast<uint16_t>(ops) * n <= OP_BUDGET;
+  }
+
+  void read(const uint8_t slot) {
+    auto &p = programs[slot];
+    eeprom_read_block(&p, eeprom_addr(Slot(slot)), sizeof(program));
+    // Blank EEPROM or a program that no longer fits the LED count
+    if (!validate(p.code, p.length, num_leds(Slot(slot)))) {
+      p.length = 0;
+    }
+  }
+
+  void init() {
+    for (uint8_t i = 0; i < uint8_t(Slot::Count); i++) {
+      read(i);
+    }
+  }
+
+  bool load(const program_report &report) {
+    if (report.slot >= Slot::Count ||
+        !validate(report.code, report.length, num_leds(report.slot))) {
+      return false;
+    }
+
+    auto &p = programs[uint8_t(report.slot)];
+    p.length = report.length;
+    memcpy(p.code, report.code, report.length);
+    save_pending |= 1 << uint8_t(report.slot);
+    return true;
+  }
+
+  void update() {
+    // Config reports arrive in the USB interrupt, save() does it from the main loop
+    reload_pending = true;
+  }
+
+  void save() {
+    // Taken together, so a program loaded from the USB interrupt is either
+    // written below or arrives after the reload and gets its own save()
+    uint8_t pending;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      pending = save_pending;
+      save_pending = 0;
+      if (reload_pending) {
+        reload_pending = false;
+        // From EEPROM, so a program that stopped fitting comes back if the LED
+        // count goes back down. Slots about to be saved are newer than EEPROM
+        for (uint8_t i = 0; i < uint8_t(Slot::Count); i++) {
+          if (!(pending & (1 << i))) {
+            read(i);
+          }
+        }
+      }
+    }
+
+    for (uint8_t i = 0; i < uint8_t(Slot::Count); i++) {
+      if (pending & (1 << i)) {
+        eeprom_update_block(&programs[i], eeprom_addr(Slot(i)), sizeof(program));
+      }
+    }
+  }
+
+  // Returns false if the op budget ran out or the stack over/underflowed
+  bool run(const program &p, const inputs &in,
+           const uint8_t i, const uint8_t n, const uint8_t pos,
+           CRGB &out, uint16_t &ops) {
+    uint8_t stack[STACK_SIZE];
+    uint8_t sp = 0;
+
+#define POP(x) if (sp == 0) return false; const uint8_t x = stack[--sp]
+#define PUSH(x) if (sp == STACK_SIZE) return false; stack[sp++] = (x)
+
+    out = CRGB::Black;
+    for (uint8_t pc = 0; pc < p.length; pc++) {
+      if (ops == 0) {
+        return false;
+      }
+      ops--;
+
+      const auto op = Op(p.code[pc]);
+      const uint8_t imm = has_imm(op) ? p.code[++pc] : 0;
+      switch (op) {
+        case Op::End:
+          return true;
+        case Op::Push: { PUSH(imm); break; }
+        case Op::Led: { PUSH(i); break; }
+        case Op::Leds: { PUSH(n); break; }
+        case Op::Pos: { PUSH(pos); break; }
+        case Op::Time: { PUSH(static_cast<uint8_t>(in.time >> (imm & 0x1F))); break; }
+        case Op::TtVelocity: { PUSH(128 + in.tt_velocity * 127); break; }
+        case Op::TtPos: { PUSH(in.tt_pos); break; }
+        case Op::Button: { PUSH((in.buttons >> (imm & 0x0F)) & 1 ? 255 : 0); break; }
+        case Op::Dup: { POP(a); PUSH(a); PUSH(a); break; }
+        case Op::Swap: { POP(b); POP(a); PUSH(b); PUSH(a); break; }
+        case Op::Drop: { POP(a); (void)a; break; }
+        case Op::Add: { POP(b); POP(a); PUSH(a + b); break; }
+        case Op::Sub: { POP(b); POP(a); PUSH(a - b); break; }
+        case Op::AddSat: { POP(b); POP(a); PUSH(qadd8(a, b)); break; }
+        case Op::SubSat: { POP(b); POP(a); PUSH(qsub8(a, b)); break; }
+        case Op::Mul: { POP(b); POP(a); PUSH(scale8(a, b)); break; }
+        case Op::Mod: { POP(b); POP(a); PUSH(b ? a % b : 0); break; }
+        case Op::Min: { POP(b); POP(a); PUSH(MIN(a, b)); break; }
+        case Op::Max: { POP(b); POP(a); PUSH(MAX(a, b)); break; }
+        case Op::Sin: { POP(a); PUSH(sin8(a)); break; }
+        case Op::Tri: { POP(a); PUSH(triwave8(a)); break; }
+        case Op::Lt: { POP(b); POP(a); PUSH(a < b ? 255 : 0); break; }
+        case Op::Eq: { POP(b); POP(a); PUSH(a == b ? 255 : 0); break; }
+        case Op::Jz: {
+          POP(a);
+          if (a == 0) {
+            pc += imm;
+          }
+          break;
+        }
+        case Op::Jmp:
+          pc += imm;
+          break;
+        case Op::Hsv: {
+          POP(v); POP(s); POP(h);
+          hsv2rgb_rainbow(CHSV(h, s, v), out);
+          break;
+        }
+        case Op::Rgb: {
+          POP(b); POP(g); POP(r);
+          out = CRGB(r, g, b);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+
+#undef POP
+#undef PUSH
+
+    return true;
+  }
+
+  bool render(const Slot slot, CRGB* leds, const uint8_t n, const inputs &in) {
+    const auto &p = programs[uint8_t(slot)];
+    if (p.length == 0) {
+      return RgbHelper::set_rgb(leds, n, CRGB::Black);
+    }
+    if (n == 0) {
+      return false;
+    }
+
+    bool update = false;
+    uint16_t ops = OP_BUDGET;
+    // Pos is (i << 8) / n, stepped along the strip instead of dividing per op
+    const uint16_t pos_step = 256 / n;
+    const uint16_t pos_carry = 256 % n;
+    uint16_t pos = 0;
+    uint16_t pos_remainder = 0;
+    for (uint8_t i = 0; i < n; i++) {
+      CRGB rgb;
+      if (!run(p, in, i, n, pos, rgb, ops)) {
+        // Leave the rest of the frame as it was
+        break;
+      }
+      update |= leds[i] != rgb;
+      leds[i] = rgb;
+
+      pos += pos_step;
+      pos_remainder += pos_carry;
+      if (pos_remainder >= n) {
+        pos_remainder -= n;
+        pos++;
+      }
+    }
+    return update;
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <FastLED/src/FastLED.h>
+#include <LUFA/Common/Common.h>
+
+// Tiny stack machine for user defined lighting effects.
+// A program runs once per LED per frame, leaving the colour for that LED.
+// Jumps only go forwards and land on ops, so a program never runs more ops
+// than it has.
+namespace LightingProgram {
+  enum : uint8_t {
+    MAX_PROGRAM_SIZE = 64,
+    STACK_SIZE = 8
+  };
+
+  // Ops evaluated per strip per frame. Not measured on hardware: from the code,
+  // an op costs about 35 cycles to dispatch, and the worst ones add up to
+  // ~150 more (Time's 32 bit shift, hsv2rgb), so a program made of them
+  // averages under 120 cycles an op. That keeps a strip under 2 ms at 16 MHz
+  constexpr uint16_t OP_BUDGET = 256;
+
+  enum class Slot : uint8_t {
+    Turntable,
+    Bar,
+    Count
+  };
+
+  // Ops marked with imm take a one byte immediate
+  enum class Op : uint8_t {
+    End,
+    Push,       // imm: push value
+    Led,        // push index of the LED being rendered
+    Leds,       // push number of LEDs
+    Pos,        // push LED index scaled to 0-255 around the strip
+    Time,       // imm: push milliseconds >> imm
+    TtVelocity, // push 128 at rest, 255 for +1, 1 for -1
+    TtPos,      // push accumulated turntable position
+    Button,     // imm: push 255 if button imm is pressed, otherwise 0
+    Dup,
+    Swap,
+    Drop,
+    Add,
+    Sub,
+    AddSat,
+    SubSat,
+    Mul,        // scale8
+    Mod,        // a % b, 0 if b is 0
+    Min,
+    Max,
+    Sin,        // sin8
+    Tri,        // triwave8
+    Lt,         // 255 if a < b, otherwise 0
+    Eq,         // 255 if a == b, otherwise 0
+    Jz,         // imm: pop, skip imm bytes forwards if zero
+    Jmp,        // imm: skip imm bytes forwards
+    Hsv,        // pop h, s, v and set the LED colour
+    Rgb,        // pop r, g, b and set the LED colour
+    Count
+  };
+
+  struct program_report {
+    Slot slot;
+    uint8_t length;
+    uint8_t code[MAX_PROGRAM_SIZE];
+  } ATTR_PACKED;
+
+  struct inputs {
+    uint32_t time;
+    int8_t tt_velocity;
+    uint8_t tt_pos;
+    uint16_t buttons;
+  };
+
+  void init();
+  // Validates and loads a program, it is saved to EEPROM later by save()
+  bool load(const program_report &report);
+  void save();
+  // Checks the programs again on the next save(), the LED counts may have changed
+  void update();
+
+  bool render(Slot slot, CRGB* leds, uint8_t n, const inputs &in);
+}
@@ -6,6 +6,19 @@ struct HSV {
   uint8_t h, s, v;
 };
 
+enum : uint8_t {
+  LED_LAYOUT_REVERSE = 1 << 0,
+  LED_LAYOUT_MIRROR = 1 << 1
+};
+
+// How a strip is physically wired, effects render as if LED 0 is at
+// offset and the strip runs in one direction
+struct LedLayout {
+  uint8_t offset;   // physical LED where effects start, e.g. TT start angle
+  uint8_t flags;    // LED_LAYOUT_*
+  uint8_t segments; // equal length pieces, every other one backwards if mirrored
+};
+
 enum class TurntableMode : uint8_t {
   Static,
   Spin,
@@ -17,17 +30,19 @@ enum class TurntableMode : uint8_t {
   Breathing,
   HID,
   Disable,
+  Custom, // lighting program
   Count
 };
 
 enum class BarMode : uint8_t {
-  Placeholder1, // beat
+  Beat,
   KeySpectrumP1,
   KeySpectrumP2,
-  Placeholder3, // audio spectrum
+  AudioSpectrum,
   HID,
   TapeLedP1,
   TapeLedP2,
   Disable,
+  Custom, // lighting program
   Count
 };
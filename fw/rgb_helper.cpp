@@ -2,8 +2,15 @@
 #include "hid.h"
 #include "rgb_helper.h"
 
+CRGB led_arena[LED_ARENA_SIZE];
 CRGB* tt_leds;
-CRGB bar_leds[LIGHT_BAR_LEDS];
+CRGB* tt_rainbow_leds;
+CRGB* bar_leds;
+CRGB* bar_staging_leds;
+CRGB* bar_prev_leds;
+CRGB* bar_next_leds;
+CRGB* tt_out_leds;
+CRGB* bar_out_leds;
 
 namespace RgbHelper {
   // Pin mapping can be found in FastLED/src/platforms/avr/fastpin_avr.h
@@ -13,33 +20,217 @@ namespace RgbHelper {
   };
 
   timer combo_timer{};
-  uint32_t min_micros = 0;
   uint8_t tt_anim_normalise = 0;
   uint8_t num_tt_leds = 0;
 
-  CLEDController* tt_controller;
-  CLEDController* bar_controller;
+  enum {
+    // WS2812 draw roughly 20mA per channel at full brightness, and 1mA idle
+    MILLIAMPS_PER_CHANNEL = 20,
+    MILLIAMPS_IDLE = 1,
+
+    // A frame that stopped changing is dithered for one full cycle of
+    // thresholds, then shown rounded once and left alone
+    DITHER_FRAMES = 16
+  };
+
+  // Gamma 2.2, scaled to 12 bits so the low 4 bits can be dithered
+  const uint16_t gamma_lut[256] PROGMEM = {
+    0, 0, 0, 0, 0, 1, 1, 1, 2, 3, 3, 4,
+    5, 6, 7, 8, 9, 11, 12, 13, 15, 17, 19, 21,
+    23, 25, 27, 29, 32, 34, 37, 40, 42, 45, 48, 52,
+    55, 58, 62, 66, 69, 73, 77, 81, 85, 90, 94, 99,
+    104, 108, 113, 118, 123, 129, 134, 140, 145, 151, 157, 163,
+    169, 175, 182, 188, 195, 202, 209, 216, 223, 230, 237, 245,
+    253, 260, 268, 276, 284, 293, 301, 310, 318, 327, 336, 345,
+    355, 364, 373, 383, 393, 403, 413, 423, 433, 444, 454, 465,
+    476, 487, 498, 509, 520, 532, 543, 555, 567, 579, 591, 604,
+    616, 629, 642, 655, 668, 681, 694, 708, 721, 735, 749, 763,
+    777, 791, 806, 820, 835, 850, 865, 880, 896, 911, 927, 942,
+    958, 974, 991, 1007, 1023, 1040, 1057, 1074, 1091, 1108, 1125, 1143,
+    1161, 1178, 1196, 1214, 1233, 1251, 1270, 1288, 1307, 1326, 1345, 1365,
+    1384, 1404, 1423, 1443, 1463, 1484, 1504, 1524, 1545, 1566, 1587, 1608,
+    1629, 1651, 1672, 1694, 1716, 1738, 1760, 1782, 1805, 1827, 1850, 1873,
+    1896, 1919, 1943, 1966, 1990, 2014, 2038, 2062, 2087, 2111, 2136, 2160,
+    2185, 2211, 2236, 2261, 2287, 2313, 2338, 2365, 2391, 2417, 2444, 2470,
+    2497, 2524, 2551, 2579, 2606, 2634, 2662, 2690, 2718, 2746, 2774, 2803,
+    2832, 2861, 2890, 2919, 2949, 2978, 3008, 3038, 3068, 3098, 3128, 3159,
+    3190, 3220, 3251, 3283, 3314, 3345, 3377, 3409, 3441, 3473, 3505, 3538,
+    3571, 3603, 3636, 3669, 3703, 3736, 3770, 3804, 3838, 3872, 3906, 3941,
+    3975, 4010, 4045, 4080
+  };
+
+  // Bit reversed order, so thresholds are spread evenly over 16 frames
+  const uint8_t dither_thresholds[16] = {
+    0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15
+  };
+
+  struct strip {
+    CLEDController* controller;
+    const CRGB* leds;
+    CRGB* out;
+    // Which LED in leds each physical LED shows
+    uint8_t* map;
+    uint8_t n;
+    uint16_t max_milliamps;
+    LedLayout layout;
+    bool reversed;
+    bool needs_show;
+    // Dithered frames left before the frame settles
+    uint8_t dither_frames;
+  };
+
+  uint8_t tt_map[MAX_TT_LEDS];
+  uint8_t bar_map[LIGHT_BAR_LEDS];
 
-  void set_refresh_rate(uint8_t rate) {
-    min_micros = 1000000 / rate;
+  strip tt_strip{};
+  strip bar_strip{};
+  uint8_t dither_frame = 0;
+
+  render_fn frame_render = nullptr;
+  void* frame_arg = nullptr;
+  uint32_t frame_us = 0;
+  // Deadlines land on whole milliseconds, the rest is carried over to the next
+  uint32_t frame_deadline = 0;
+  uint16_t frame_carry_us = 0;
+
+  void set_refresh_rate(const uint8_t rate) {
+    // Round up so we never go over the requested refresh rate. In µs, whole
+    // milliseconds would run 120 Hz at 111 Hz
+    frame_us = (1000000UL + rate - 1) / rate;
+    frame_carry_us = 0;
+  }
+
+  // Transforms are undone in order: start offset, reverse, then mirrored segments
+  void build_map(strip &s) {
+    if (s.n == 0) {
+      return;
+    }
+
+    const auto &layout = s.layout;
+    const uint8_t segments = layout.segments > 0 ? MIN(layout.segments, s.n) : 1;
+    const uint8_t segment_len = s.n / segments;
+    const uint8_t offset = layout.offset % s.n;
+    const bool reverse = s.reversed != bool(layout.flags & LED_LAYOUT_REVERSE);
+    const bool mirror = layout.flags & LED_LAYOUT_MIRROR;
+
+    for (uint8_t p = 0; p < s.n; p++) {
+      uint8_t i = p >= offset ? p - offset : p + s.n - offset;
+      if (reverse) {
+        i = s.n - 1 - i;
+      }
+
+      // Every other segment runs backwards, e.g. a strip folded back on itself
+      const uint8_t segment = i / segment_len;
+      if (mirror && (segment & 1) && segment < segments) {
+        const uint8_t start = segment * segment_len;
+        i = start + segment_len - 1 - (i - start);
+      }
+
+      s.map[p] = i;
+    }
+    s.needs_show = true;
+    s.dither_frames = DITHER_FRAMES;
+  }
+
+  void set_layout(strip &s, const LedLayout &layout) {
+    if (memcmp(&s.layout, &layout, sizeof(LedLayout)) != 0) {
+      s.layout = layout;
+      build_map(s);
+    }
   }
 
   void init(const config &cfg) {
     timer_init(&combo_timer);
-    tt_anim_normalise = 24 / cfg.tt_leds;
+    // A zero would give the spin tickers no tick duration on big turntables
+    tt_anim_normalise = MAX(24 / cfg.tt_leds, 1);
     num_tt_leds = cfg.tt_leds;
-    tt_leds = static_cast<CRGB*>(calloc(num_tt_leds, sizeof(CRGB)));
-    update(cfg);
+    tt_leds = led_arena;
+    tt_rainbow_leds = tt_leds + num_tt_leds;
+    bar_leds = tt_rainbow_leds + num_tt_leds;
+    bar_staging_leds = bar_leds + LIGHT_BAR_LEDS;
+    bar_prev_leds = bar_staging_leds + LIGHT_BAR_LEDS;
+    bar_next_leds = bar_prev_leds + LIGHT_BAR_LEDS;
+    tt_out_leds = bar_next_leds + LIGHT_BAR_LEDS;
+    bar_out_leds = tt_out_leds + num_tt_leds;
 
-    tt_controller = &FastLED.addLeds<NEOPIXEL, TT_DATA_PIN>(tt_leds, num_tt_leds)
-      .setDither(DISABLE_DITHER);
-    bar_controller = &FastLED.addLeds<NEOPIXEL, BAR_DATA_PIN>(bar_leds, LIGHT_BAR_LEDS)
-      .setDither(DISABLE_DITHER);
+    // We do our own dithering before FastLED scales by the brightness cap
+    tt_strip = {
+      .controller = &FastLED.addLeds<NEOPIXEL, TT_DATA_PIN>(tt_out_leds, num_tt_leds)
+        .setDither(DISABLE_DITHER),
+      .leds = tt_leds,
+      .out = tt_out_leds,
+      .map = tt_map,
+      .n = num_tt_leds,
+      .max_milliamps = TT_MAX_MILLIAMPS,
+      .layout = cfg.tt_layout,
+      .reversed = false,
+      .needs_show = false,
+      .dither_frames = 0
+    };
+    bar_strip = {
+      .controller = &FastLED.addLeds<NEOPIXEL, BAR_DATA_PIN>(bar_out_leds, LIGHT_BAR_LEDS)
+        .setDither(DISABLE_DITHER),
+      .leds = bar_leds,
+      .out = bar_out_leds,
+      .map = bar_map,
+      .n = LIGHT_BAR_LEDS,
+      .max_milliamps = BAR_MAX_MILLIAMPS,
+      .layout = cfg.bar_layout,
+      .reversed = false,
+      .needs_show = false,
+      .dither_frames = 0
+    };
+    build_map(tt_strip);
+    build_map(bar_strip);
     FastLED.setMaxRefreshRate(0); // We have our own frame rate limiter
+
+    update(cfg);
   }
 
   void update(const config &new_cfg) {
     set_refresh_rate(new_cfg.led_refresh);
+    set_layout(tt_strip, new_cfg.tt_layout);
+    set_layout(bar_strip, new_cfg.bar_layout);
+  }
+
+  bool set_bar_reversed(const bool reversed) {
+    if (bar_strip.reversed == reversed) {
+      return false;
+    }
+
+    bar_strip.reversed = reversed;
+    build_map(bar_strip);
+    return true;
+  }
+
+  // Render lighting on a frame timer to reduce the number of
+  // computationally expensive calls to FastLED.show()
+  void start(const render_fn render, void* arg) {
+    frame_render = render;
+    frame_arg = arg;
+    frame_deadline = milliseconds;
+    frame_carry_us = 0;
+  }
+
+  void run() {
+    const uint32_t now = milliseconds;
+    // Signed, so it still works when milliseconds wraps around
+    if (!frame_render || static_cast<int32_t>(now - frame_deadline) < 0) {
+      return;
+    }
+
+    const uint32_t us = frame_us + frame_carry_us;
+    const uint32_t next = frame_deadline + us / 1000;
+    if (static_cast<int32_t>(now - next) < 0) {
+      frame_deadline = next;
+      frame_carry_us = us % 1000;
+    } else {
+      // Don't try to catch up on missed frames, like the old frame limiter
+      frame_deadline = now + frame_us / 1000;
+      frame_carry_us = frame_us % 1000;
+    }
+
+    frame_render(frame_arg);
   }
 
   bool set_rgb(CRGB* leds, const uint8_t n, const rgb_light &lights) {
@@ -77,27 +268,121 @@ namespace RgbHelper {
     return set_rgb(leds, n, lights);
   }
 
-  // update lighting on a timer to reduce the number of
-  // computationally expensive calls to FastLED.show()
-  // basically what FastLED does but without spin waiting
-  bool ready_to_present() {
-    if (current_config.disable_leds)
-      return false;
+  void resample(CRGB* leds, const uint8_t n, const CRGB* src, const uint8_t src_n) {
+    if (n <= 1 || src_n <= 1) {
+      set_rgb(leds, n, src_n > 0 ? src[0] : CRGB(CRGB::Black));
+      return;
+    }
 
-    static uint32_t last_show = 0;
-    const uint32_t now = micros();
-    if (now-last_show < min_micros)
-      return false;
+    // 8.8 fixed point position in src, (src_n - 1) << 8 always fits
+    const uint16_t step = ((src_n - 1) << 8) / (n - 1);
+    uint16_t pos = 0;
+    for (uint8_t i = 0; i < n; i++, pos += step) {
+      const uint8_t j = pos >> 8;
+      if (j + 1 >= src_n) {
+        leds[i] = src[src_n - 1];
+      } else {
+        leds[i] = blend(src[j], src[j + 1], pos & 0xFF);
+      }
+    }
+  }
 
-    last_show = now;
-    return true;
+  bool blend_frames(CRGB* leds, const uint8_t n,
+                    const CRGB* from, const CRGB* to, const fract8 amount) {
+    bool update = false;
+    for (uint8_t i = 0; i < n; i++) {
+      const auto rgb = blend(from[i], to[i], amount);
+      update |= leds[i] != rgb;
+      leds[i] = rgb;
+    }
+    return update;
+  }
+
+  uint8_t brightness_cap(const uint32_t sum, const strip &s) {
+    if (s.max_milliamps == 0) {
+      return 255;
+    }
+
+    const uint16_t idle = s.n * MILLIAMPS_IDLE;
+    if (s.max_milliamps <= idle) {
+      return 0;
+    }
+
+    // Budget in the same units as the sum of all channel values
+    const uint32_t budget = static_cast<uint32_t>(s.max_milliamps - idle) * 255 / MILLIAMPS_PER_CHANNEL;
+    if (sum <= budget) {
+      return 255;
+    }
+    return budget * 255 / sum;
   }
 
-  void show_tt() {
-    tt_controller->showLeds();
+  // Single pass over the frame, gathering it into hardware order with
+  // gamma and dither applied while summing it up for the current limit,
+  // which FastLED then applies while it sends the frame out
+  void show(strip &s, const bool changed) {
+    if (changed) {
+      s.dither_frames = DITHER_FRAMES;
+    }
+    uint8_t* dst = &s.out[0].r;
+
+    uint32_t sum = 0;
+    // Low bits of every channel, only a frame with some left needs dithering
+    uint8_t residual = 0;
+    uint8_t t = dither_frame;
+    for (uint8_t p = 0; p < s.n; p++) {
+      const uint8_t* src = &s.leds[s.map[p]].r;
+      for (uint8_t c = 0; c < 3; c++) {
+        const uint16_t v = pgm_read_word(&gamma_lut[src[c]]);
+        residual |= v & 0x0F;
+        // Rounded once the frame has settled
+        const uint8_t threshold = s.dither_frames > 0 ? dither_thresholds[t++ & 0x0F] : 8;
+        *dst = (v + threshold) >> 4;
+        sum += *dst++;
+      }
+    }
+
+    // The rounded frame just shown is the last one until something changes
+    if (residual == 0 || s.dither_frames == 0) {
+      s.dither_frames = 0;
+      s.needs_show = false;
+    } else {
+      s.dither_frames--;
+      s.needs_show = true;
+    }
+
+    s.controller->showLeds(brightness_cap(sum, s));
   }
 
-  void show_bar() {
-    bar_controller->showLeds();
+  void show_tt(const bool changed) {
+    show(tt_strip, changed);
+    dither_frame++;
+  }
+
+  void show_bar(const bool changed) {
+    show(bar_strip, changed);
+    dither_frame++;
+  }
+
+  bool tt_needs_show() {
+    return tt_strip.needs_show;
+  }
+
+  bool bar_needs_show() {
+    return bar_strip.needs_show;
+  }
+
+  void clear() {
+    // Clear what effects render into too, so they all redraw afterwards
+    if (tt_leds) {
+      set_rgb(tt_leds, num_tt_leds, CRGB::Black);
+    }
+    if (bar_leds) {
+      set_rgb(bar_leds, LIGHT_BAR_LEDS, CRGB::Black);
+    }
+    tt_strip.needs_show = false;
+    bar_strip.needs_show = false;
+    tt_strip.dither_frames = 0;
+    bar_strip.dither_frames = 0;
+    FastLED.clear(true);
   }
 }
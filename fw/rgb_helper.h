@@ -1,6 +1,7 @@
 #pragma once
 
 #include <FastLED/src/FastLED.h>
+#include <LUFA/Common/Common.h>
 
 #include "config.h"
 #include "rgb.h"
@@ -14,8 +15,25 @@
 #endif
 
 constexpr auto DEFAULT_COLOUR = HSV{ 128, 255, 255 }; // Aqua
+
+// Per strip current limits in mA, 0 for no limit
+#ifndef TT_MAX_MILLIAMPS
+#define TT_MAX_MILLIAMPS 0
+#endif
+#ifndef BAR_MAX_MILLIAMPS
+#define BAR_MAX_MILLIAMPS 0
+#endif
+
+// All LED frames live in one statically sized arena, carved up at boot
+// according to config, so the worst case RAM usage is known at link time
+constexpr uint16_t LED_ARENA_SIZE = MAX_TT_LEDS * 3 + LIGHT_BAR_LEDS * 5;
 extern CRGB* tt_leds;
-extern CRGB bar_leds[LIGHT_BAR_LEDS];
+extern CRGB* tt_rainbow_leds;
+extern CRGB* bar_leds;
+extern CRGB* bar_staging_leds;
+// Previous and next host frames, already scaled to the bar, for blending between
+extern CRGB* bar_prev_leds;
+extern CRGB* bar_next_leds;
 
 struct rgb_light {
   uint8_t r, g, b;
@@ -23,12 +41,17 @@ struct rgb_light {
 
 namespace RgbHelper {
   extern timer combo_timer;
-  extern uint32_t min_micros;
   extern uint8_t tt_anim_normalise;
   extern uint8_t num_tt_leds;
 
   void init(const config &cfg);
   void update(const config &new_cfg);
+  typedef void (*render_fn)(void* arg);
+  // Renders a frame at led_refresh from run(), which the main loop calls every pass
+  void start(render_fn render, void* arg);
+  void run();
+  // Flip the bar on top of its layout, for effects with a P1 and P2 variant
+  bool set_bar_reversed(bool reversed);
 
   bool set_rgb(CRGB* leds, uint8_t n, const rgb_light &lights);
   bool set_rgb(CRGB* leds, uint8_t n, const CRGB &rgb);
@@ -37,7 +60,20 @@ namespace RgbHelper {
                  CRGB* leds, uint8_t n, const HSV &hsv);
   bool hid(CRGB* leds, uint8_t n, const rgb_light &lights);
 
-  bool ready_to_present();
-  void show_tt();
-  void show_bar();
+  // Linearly resample src_n LEDs onto n LEDs
+  void resample(CRGB* leds, uint8_t n, const CRGB* src, uint8_t src_n);
+  bool blend_frames(CRGB* leds, uint8_t n,
+                    const CRGB* from, const CRGB* to, fract8 amount);
+
+  // Effects render linear colours into tt_leds/bar_leds, showing a strip
+  // gamma corrects, dithers and current limits it into a separate output frame.
+  // changed is whether the effect drew anything new since the last show
+  void show_tt(bool changed);
+  void show_bar(bool changed);
+  // Temporal dithering only works if the strip keeps getting shown, until a
+  // frame that stopped changing settles, and layout changes need showing even
+  // if the effect hasn't changed
+  bool tt_needs_show();
+  bool bar_needs_show();
+  void clear();
 }
@@ -66,7 +66,9 @@ bool SpinPattern::update(const int8_t tt_report) {
   } else {
     spin_counter += ticks;
   }
-  spin_counter %= limit;
+  if (limit != 0) {
+    spin_counter %= limit;
+  }
 
   return ticks > 0;
 }
@@ -20,6 +20,7 @@ private:
 class SpinPattern {
 public:
   SpinPattern();
+  // A limit of 0 wraps around at 256
   SpinPattern(uint8_t spin_duration,
               uint8_t fast_spin_duration,
               uint8_t limit = 0);
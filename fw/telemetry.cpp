@@ -0,0 +1,63 @@
+// Only built in when asked for, the extra IN interface costs a poll every millisecond
+#if TELEMETRY
+
+#include <avr/io.h>
+
+#include "analog_button.h"
+#include "axis.h"
+#include "beef.h"
+#include "button_lights.h"
+#include "telemetry.h"
+#include "timer.h"
+
+namespace Telemetry {
+  uint8_t sequence;
+  uint8_t last_tt_x;
+
+  uint16_t raw_buttons;
+  uint16_t raw_toggled;
+  uint16_t loops;
+  uint16_t max_loop_us;
+  uint32_t last_loop_us;
+
+  void update(const uint16_t raw) {
+    const uint32_t now = timer_micros();
+    if (last_loop_us) {
+      max_loop_us = MAX(max_loop_us, MIN(now - last_loop_us, static_cast<uint32_t>(UINT16_MAX)));
+    }
+    last_loop_us = now;
+
+    loops = MIN(loops + 1, UINT16_MAX);
+    raw_toggled |= raw ^ raw_buttons;
+    raw_buttons = raw;
+  }
+
+  void fill_report(telemetry_report &report) {
+    // This runs at the start of the main loop, so button_state and the
+    // turntable are what the last pass worked out, same as the joystick report
+    const uint8_t x = tt_x.get();
+    report = {
+      .sequence = sequence++,
+      .time_ms = static_cast<uint16_t>(milliseconds),
+      .raw_buttons = raw_buttons,
+      .raw_toggled = raw_toggled,
+      .buttons = button_state,
+      .tt_x = x,
+      .tt_delta = static_cast<int8_t>(x - last_tt_x),
+      .tt_direction = button_x.direction,
+      .encoders = static_cast<uint8_t>(PINF & 0x0F),
+      .analog_x = analog_x.get(),
+      .analog_y = analog_y.get(),
+      .loops = loops,
+      .max_loop_us = max_loop_us,
+      .max_lamp_isr_ticks = ButtonLights::take_max_isr_ticks()
+    };
+
+    last_tt_x = x;
+    raw_toggled = 0;
+    loops = 0;
+    max_loop_us = 0;
+  }
+}
+
+#endif
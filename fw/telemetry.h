@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <LUFA/Common/Common.h>
+
+// Live input telemetry on its own vendor-defined HID interface, for TELEMETRY
+// builds. The host polls it every millisecond like the joystick, and each
+// report sums up the main loop passes since the one before, so nothing that
+// happened between polls is lost.
+namespace Telemetry {
+  struct telemetry_report {
+    uint8_t sequence;      // +1 every report, a gap means the host skipped a poll
+    uint16_t time_ms;      // low bits of milliseconds when the report was filled
+    uint16_t raw_buttons;  // as read from the pins, before debouncing
+    uint16_t raw_toggled;  // raw bits that changed on any pass since the last report
+    uint16_t buttons;      // button_state as sent to the game, with the digital TT bits
+    uint8_t tt_x;          // tt_x.get()
+    int8_t tt_delta;       // tt_x.get() change since the last report
+    int8_t tt_direction;   // button_x.direction
+    uint8_t encoders;      // PINF0-3
+    uint8_t analog_x;      // last ADC readings, only polled for SDVX
+    uint8_t analog_y;
+    uint16_t loops;        // main loop passes since the last report
+    uint16_t max_loop_us;  // longest of them, saturates at 65535
+    uint8_t max_lamp_isr_ticks; // longest button lamp interrupt, 8 CPU cycles a tick
+  } ATTR_PACKED;
+
+  // Called every main loop pass with the raw button bits
+  void update(uint16_t raw_buttons);
+
+  // Called from the telemetry interface's HID_Device_USBTask()
+  void fill_report(telemetry_report &report);
+}
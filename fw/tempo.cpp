@@ -0,0 +1,228 @@
+#include <string.h>
+#include <util/atomic.h>
+
+#include "tempo.h"
+#include "timer.h"
+
+namespace Tempo {
+  enum : uint8_t {
+    // Onsets remembered for pairing up intervals
+    MAX_ONSETS = 12,
+
+    // Histogram weights, in 12.4 fixed point. Neighbouring onsets say more
+    // about the beat than ones further apart
+    ADJACENT_WEIGHT = 4,
+    DISTANT_WEIGHT = 2,
+    // Every onset decays the histogram by 1/2^DECAY_SHIFT
+    DECAY_SHIFT = 4,
+    // Fraction of the phase error corrected per onset, as a shift
+    PHASE_GAIN_SHIFT = 2
+  };
+
+  uint16_t histogram[NUM_BINS];
+  uint32_t onsets[MAX_ONSETS];
+  uint8_t onset_head = 0;
+  uint8_t num_onsets = 0;
+
+  uint16_t last_buttons = 0;
+  uint32_t last_onset_ms = 0;
+
+  // Beat period in 1/16 ms, from the histogram peak
+  uint16_t period_x16 = 0;
+  uint8_t confidence = 0;
+  uint32_t last_beat_ms = 0;
+  uint8_t beats = 0;
+
+  // What fill_report() reads from the USB interrupt, published whole by
+  // update() so a report can't mix halves of two updates
+  struct snapshot {
+    uint16_t period_x16;
+    uint8_t confidence;
+    uint32_t last_beat_ms;
+  };
+  snapshot published{};
+
+  // Shared by the live values and the published snapshot
+  uint16_t period(const uint16_t x16) {
+    return (x16 + 8) >> 4;
+  }
+
+  uint8_t phase(const uint16_t x16, const uint32_t beat_ms) {
+    const uint16_t beat = period(x16);
+    if (beat == 0) {
+      return 0;
+    }
+    const int32_t elapsed = static_cast<int32_t>(milliseconds - beat_ms);
+    if (elapsed <= 0) {
+      return 0;
+    }
+    return static_cast<uint32_t>(MIN(elapsed, static_cast<int32_t>(beat - 1))) * 256 / beat;
+  }
+
+  // Fold an interval into [MIN_PERIOD, MAX_PERIOD), 0 if it's too short to be musical
+  uint16_t fold(uint16_t interval) {
+    if (interval < MIN_PERIOD / 4) {
+      return 0;
+    }
+    while (interval < MIN_PERIOD) {
+      interval *= 2;
+    }
+    while (interval >= MAX_PERIOD) {
+      interval /= 2;
+    }
+    return interval;
+  }
+
+  void add_interval(const uint16_t interval, const uint8_t weight) {
+    const uint16_t period = fold(interval);
+    if (period == 0) {
+      return;
+    }
+
+    // Spread over the neighbouring bins too, so the peak doesn't hop between them
+    const uint8_t bin = (period - MIN_PERIOD) / BIN_MS;
+    histogram[bin] += weight << 4;
+    if (bin > 0) {
+      histogram[bin - 1] += weight << 3;
+    }
+    if (bin + 1 < NUM_BINS) {
+      histogram[bin + 1] += weight << 3;
+    }
+  }
+
+  void find_peak() {
+    uint8_t peak = 0;
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < NUM_BINS; i++) {
+      total += histogram[i];
+      if (histogram[i] > histogram[peak]) {
+        peak = i;
+      }
+    }
+    if (total == 0) {
+      return;
+    }
+
+    // Centre of mass of the peak and its neighbours, for sub-bin precision
+    const uint16_t left = peak > 0 ? histogram[peak - 1] : 0;
+    const uint16_t right = peak + 1 < NUM_BINS ? histogram[peak + 1] : 0;
+    const uint32_t mass = static_cast<uint32_t>(left) + histogram[peak] + right;
+    const int32_t offset_x16 = (static_cast<int32_t>(right) - left) * BIN_MS * 16 / static_cast<int32_t>(mass);
+    period_x16 = (MIN_PERIOD + peak * BIN_MS + BIN_MS / 2) * 16 + offset_x16;
+
+    // Share of the histogram in the peak, a flat histogram being no confidence at all
+    confidence = MIN(mass * 255 / total, static_cast<uint32_t>(255));
+  }
+
+  void decay() {
+    for (auto &bin : histogram) {
+      bin -= bin >> DECAY_SHIFT;
+    }
+  }
+
+  // Nudge the beat grid towards the onset, onsets half a beat out don't move it
+  void correct_phase(const uint32_t now) {
+    const uint16_t beat = period();
+    if (beat == 0) {
+      last_beat_ms = now;
+      return;
+    }
+
+    // The last beat can be slightly in the future after a correction
+    int16_t error = static_cast<int32_t>(now - last_beat_ms) % beat;
+    if (error > beat / 2) {
+      error -= beat;
+    } else if (error < -beat / 2) {
+      error += beat;
+    }
+    last_beat_ms += error >> PHASE_GAIN_SHIFT;
+  }
+
+  void onset(const uint32_t now) {
+    decay();
+
+    for (uint8_t i = 0; i < num_onsets; i++) {
+      const uint8_t index = (onset_head + MAX_ONSETS - 1 - i) % MAX_ONSETS;
+      const uint32_t interval = now - onsets[index];
+      if (interval > MAX_INTERVAL) {
+        break;
+      }
+      add_interval(interval, i == 0 ? ADJACENT_WEIGHT : DISTANT_WEIGHT);
+    }
+
+    onsets[onset_head] = now;
+    onset_head = (onset_head + 1) % MAX_ONSETS;
+    num_onsets = MIN(num_onsets + 1, static_cast<uint8_t>(MAX_ONSETS));
+
+    find_peak();
+    correct_phase(now);
+  }
+
+  void step(const uint32_t now, const uint16_t button_state) {
+    const uint16_t pressed = button_state & ~last_buttons;
+    last_buttons = button_state;
+    // The first onset has nothing to be a chord with, even right after boot
+    if (pressed && (num_onsets == 0 || now - last_onset_ms >= CHORD_TIME)) {
+      last_onset_ms = now;
+      onset(now);
+    }
+
+    if (period_x16 == 0) {
+      return;
+    }
+
+    if (now - last_onset_ms > TIMEOUT) {
+      memset(histogram, 0, sizeof(histogram));
+      num_onsets = 0;
+      period_x16 = 0;
+      confidence = 0;
+      return;
+    }
+
+    // Catch up on the beat grid, predicted beats are the whole point
+    const uint16_t beat = period();
+    while (static_cast<int32_t>(now - last_beat_ms) >= beat) {
+      last_beat_ms += beat;
+      beats++;
+    }
+  }
+
+  void update(const uint16_t button_state) {
+    step(milliseconds, button_state);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      published = {
+        .period_x16 = period_x16,
+        .confidence = confidence,
+        .last_beat_ms = last_beat_ms
+      };
+    }
+  }
+
+  bool locked() {
+    return period_x16 != 0;
+  }
+
+  uint16_t period() {
+    return period(period_x16);
+  }
+
+  uint8_t phase() {
+    return phase(period_x16, last_beat_ms);
+  }
+
+  uint8_t beat_count() {
+    return beats;
+  }
+
+  void fill_report(tempo_report &report) {
+    snapshot s;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      s = published;
+    }
+    // 60000 ms per minute, 10x for a decimal place, 16x for period_x16
+    report.bpm_x10 = s.period_x16 ? 9600000UL / s.period_x16 : 0;
+    report.confidence = s.confidence;
+    report.phase = phase(s.period_x16, s.last_beat_ms);
+  }
+}
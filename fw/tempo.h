@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <LUFA/Common/Common.h>
+
+// Estimates the tempo of the song being played from button presses.
+// Intervals between recent presses are folded into a single octave of beat
+// periods and accumulated in a decaying histogram, whose peak is the beat.
+// A simple phase locked loop keeps the predicted beats in line with the presses.
+namespace Tempo {
+  enum : uint16_t {
+    // Beat periods covered by the histogram, one octave from 200 BPM down to 100 BPM.
+    // Faster or slower songs lock onto half or double time
+    MIN_PERIOD = 300,
+    MAX_PERIOD = 2 * MIN_PERIOD,
+    BIN_MS = 4,
+    NUM_BINS = (MAX_PERIOD - MIN_PERIOD) / BIN_MS,
+
+    // Presses closer together than this are the same onset, e.g. chords
+    CHORD_TIME = 30,
+    // Intervals longer than this aren't worth relating to each other
+    MAX_INTERVAL = 2000,
+    // Lose the lock when nothing has been pressed for this long
+    TIMEOUT = 3000
+  };
+
+  struct tempo_report {
+    uint16_t bpm_x10;   // 0 when there's no lock
+    uint8_t confidence; // 0-255, how much the peak stands out
+    uint8_t phase;      // 0-255 through the current beat
+  } ATTR_PACKED;
+
+  // Cheap enough to call every loop, only does real work on new presses
+  void update(uint16_t button_state);
+
+  bool locked();
+  // Current beat period in ms, 0 when not locked
+  uint16_t period();
+  // 0-255 through the current beat
+  uint8_t phase();
+  // Increments every predicted beat
+  uint8_t beat_count();
+
+  void fill_report(tempo_report &report);
+}
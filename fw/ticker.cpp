@@ -18,6 +18,10 @@ uint8_t Ticker::get_ticks() {
 
   const auto now = milliseconds;
   const uint16_t delta_time = now - last_tick_time;
+  if (delta_time < tick_duration && !first_tick) {
+    // Nothing due yet, skip the division
+    return 0;
+  }
   uint8_t ticks = delta_time / tick_duration;
 
   last_tick_time += ticks * tick_duration;
@@ -1,3 +1,6 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+
 #include "timer.h"
 
 volatile uint32_t milliseconds = 0;
@@ -49,3 +52,22 @@ bool timer_check_if_expired_reset(timer* self) {
   }
   return expired;
 }
+
+uint32_t timer_micros(void) {
+  uint32_t ms;
+  uint8_t ticks;
+  bool overflowed;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ms = milliseconds;
+    ticks = TCNT1;
+    overflowed = TIFR1 & (1 << OCF1A);
+  }
+
+  // The counter cleared but the interrupt hasn't counted it yet
+  if (overflowed && ticks < 125) {
+    ms++;
+  }
+
+  // Timer1 counts 0-249 at 4us a tick
+  return ms * 1000 + ticks * 4u;
+}
@@ -20,6 +20,8 @@ bool timer_is_expired(timer* self);
 bool timer_is_active(timer* self);
 int32_t timer_get_remaining_time(timer* self);
 bool timer_check_if_expired_reset(timer* self);
+// Microseconds since boot, with 4us resolution from Timer1. Wraps every ~71 minutes
+uint32_t timer_micros(void);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,167 @@
+// The buffer takes a good chunk of SRAM, so it's only built in when asked for
+#if INPUT_TRACE
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#include "beef.h"
+#include "combo.h"
+#include "timer.h"
+#include "trace.h"
+
+namespace Trace {
+  // Deltas longer than this are stored in ms, and an unchanged input still
+  // gets a sample this often so the deltas never overflow
+  constexpr uint32_t MAX_DELTA_US = 32000000;
+
+  sample samples[TRACE_SAMPLES];
+  uint16_t head = 0; // next sample to write
+  uint16_t count = 0;
+  volatile State state = State::Recording;
+  settings captured;
+
+  // Set from the control request interrupt, handled in update()
+  volatile Action pending_action = Action::Read;
+  volatile uint16_t read_offset = 0;
+
+  uint32_t last_loop_us;
+  uint32_t last_sample_us;
+  uint16_t last_buttons;
+  uint8_t last_encoders;
+  uint8_t max_loop;
+  timer trigger_timer;
+
+  uint16_t trigger_buttons() {
+    switch (current_config.controller_type) {
+      case ControllerType::SDVX:
+        // FX-L, FX-R and Start
+        return BUTTON_5 | BUTTON_6 | BUTTON_7;
+      case ControllerType::IIDX:
+      default:
+        // E1-E4
+        return BUTTON_8 | BUTTON_9 | BUTTON_10 | BUTTON_11;
+    }
+  }
+
+  void freeze() {
+    captured = {
+      .controller_type = current_config.controller_type,
+      .reverse_tt = current_config.reverse_tt,
+      .tt_deadzone = current_config.tt_deadzone,
+      .tt_sustain_ms = current_config.tt_sustain_ms,
+      .tt_ratio = current_config.tt_ratio,
+      .buttons_debounce = current_config.controller_type == ControllerType::SDVX ?
+        current_config.sdvx_buttons_debounce : current_config.iidx_buttons_debounce,
+      .effectors_debounce = current_config.controller_type == ControllerType::SDVX ?
+        static_cast<uint8_t>(0) : current_config.iidx_effectors_debounce
+    };
+    state = State::Frozen;
+  }
+
+  void arm() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      head = 0;
+      count = 0;
+      read_offset = 0;
+    }
+    state = State::Recording;
+  }
+
+  void add_sample(const uint32_t now, const uint16_t buttons, const uint8_t encoders) {
+    const uint32_t delta_us = count ? now - last_sample_us : 0;
+    samples[head] = {
+      .delta = static_cast<uint16_t>(delta_us < DELTA_MS ?
+        delta_us : DELTA_MS | MIN(delta_us / 1000, static_cast<uint32_t>(DELTA_MS - 1))),
+      .buttons = buttons,
+      .encoders = encoders,
+      .max_loop = max_loop
+    };
+    head = (head + 1) % TRACE_SAMPLES;
+    count = MIN(count + 1, TRACE_SAMPLES);
+
+    last_sample_us = now;
+    last_buttons = buttons;
+    last_encoders = encoders;
+    max_loop = 0;
+  }
+
+  void update(const uint16_t raw_buttons) {
+    const uint32_t now = timer_micros();
+    const uint32_t loop_us = now - last_loop_us;
+    last_loop_us = now;
+
+    Action action;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      action = pending_action;
+      pending_action = Action::Read;
+    }
+    if (action == Action::Freeze) {
+      freeze();
+    } else if (action == Action::Arm) {
+      arm();
+    }
+
+    if (state == State::Frozen) {
+      return;
+    }
+
+    if (count) {
+      max_loop = MAX(max_loop, MIN(loop_us / LOOP_UNIT_US, static_cast<uint32_t>(UINT8_MAX)));
+    }
+
+    const auto trigger = trigger_buttons();
+    if ((raw_buttons & trigger) == trigger) {
+      if (!timer_is_armed(&trigger_timer)) {
+        timer_arm(&trigger_timer, TRIGGER_MS);
+      }
+      if (timer_check_if_expired_reset(&trigger_timer)) {
+        freeze();
+        timer_arm(&combo_lights_timer, CONFIG_CHANGE_NOTIFY_TIME);
+        return;
+      }
+    } else {
+      timer_reset(&trigger_timer);
+    }
+
+    // tt_x on F0/F1, tt_y on F2/F3
+    const uint8_t encoders = PINF & 0x0F;
+    if (count && raw_buttons == last_buttons && encoders == last_encoders &&
+        now - last_sample_us < MAX_DELTA_US) {
+      return;
+    }
+    add_sample(now, raw_buttons, encoders);
+  }
+
+  void fill_report(trace_report &report) {
+    report.state = state;
+    report.count = count;
+    report.offset = read_offset;
+    report.length = 0;
+    report.captured = captured;
+    if (state != State::Frozen) {
+      return;
+    }
+
+    const uint16_t first = (head + TRACE_SAMPLES - count) % TRACE_SAMPLES;
+    for (uint16_t i = report.offset; i < count && report.length < CHUNK_SAMPLES; i++) {
+      report.samples[report.length++] = samples[(first + i) % TRACE_SAMPLES];
+    }
+  }
+
+  bool process_report(const action_report &report) {
+    switch (report.action) {
+      case Action::Read:
+        read_offset = report.offset;
+        return true;
+      case Action::Freeze:
+      case Action::Arm:
+        // Handle outside of interrupt
+        pending_action = report.action;
+        return true;
+      default:
+        return false;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <LUFA/Common/Common.h>
+
+#include "config.h"
+
+#ifndef TRACE_SAMPLES
+#define TRACE_SAMPLES 256
+#endif
+
+// Records raw input samples into a ring buffer, for INPUT_TRACE builds.
+// A sample is only added when the buttons or encoder lines change, so the
+// buffer covers the last few hundred input changes rather than a fixed time.
+// Holding the trigger combo freezes the buffer so the host can download it
+// and replay it through the same axis, analog button and debounce code.
+namespace Trace {
+  enum class State : uint8_t {
+    Recording,
+    Frozen
+  };
+
+  enum class Action : uint8_t {
+    Read,   // following GETs return samples from offset
+    Freeze,
+    Arm     // clear the trace and start recording again
+  };
+
+  enum : uint16_t {
+    // delta is in ms rather than µs
+    DELTA_MS = 1 << 15,
+    // Longest main loop pass is kept in these units
+    LOOP_UNIT_US = 32,
+    // Held this long to freeze the trace
+    TRIGGER_MS = 2000
+  };
+
+  struct sample {
+    uint16_t delta;   // since the previous sample, see DELTA_MS
+    uint16_t buttons; // raw, before debouncing
+    uint8_t encoders; // PINF0-3, both quadrature encoders
+    uint8_t max_loop; // longest main loop pass since the previous sample, in LOOP_UNIT_US
+  } ATTR_PACKED;
+
+  // Settings the input was processed with, captured when the trace froze
+  struct settings {
+    ControllerType controller_type;
+    uint8_t reverse_tt;
+    uint8_t tt_deadzone;
+    uint8_t tt_sustain_ms;
+    uint8_t tt_ratio;
+    uint8_t buttons_debounce;
+    uint8_t effectors_debounce;
+  } ATTR_PACKED;
+
+  enum : uint8_t {
+    CHUNK_SAMPLES = 12
+  };
+
+  // GET returns a chunk of the frozen trace, oldest samples first.
+  // Nothing is returned while recording, as the main loop is still writing
+  struct trace_report {
+    State state;
+    uint16_t count;  // samples in the trace
+    uint16_t offset; // of the first sample in this chunk
+    uint8_t length;  // samples in this chunk
+    settings captured;
+    sample samples[CHUNK_SAMPLES];
+  } ATTR_PACKED;
+
+  struct action_report {
+    Action action;
+    uint16_t offset;
+  } ATTR_PACKED;
+
+  // Called every main loop pass with the raw button bits
+  void update(uint16_t raw_buttons);
+
+  // Called from the control request interrupt
+  void fill_report(trace_report &report);
+  bool process_report(const action_report &report);
+}
@@ -0,0 +1,141 @@
+#include "controller.h"
+
+// The turntable and its lights are only there for IIDX
+#if CONTROLLER_HAS_IIDX
+
+#include "devices/iidx/iidx_rgb_manager.h"
+
+#include "axis.h"
+#include "config.h"
+#include "timer.h"
+#include "tt_calibration.h"
+
+namespace TtCalibration {
+  // How often the phase colour is put back on the turntable
+  constexpr uint16_t FEEDBACK_MS = 500;
+
+  Phase phase = Phase::Idle;
+  timer phase_timer;
+  timer feedback_timer;
+  CRGB phase_colour;
+
+  uint8_t rest_value;
+  int8_t rest_min;
+  int8_t rest_max;
+
+  uint8_t last_value;
+  int8_t last_direction;
+  uint32_t last_tick_ms;
+  uint16_t ticks;
+  uint16_t longest_gap;
+
+  void enter(const Phase next, const uint16_t duration, const CRGB &colour) {
+    phase = next;
+    phase_colour = colour;
+    timer_arm(&phase_timer, duration);
+    timer_arm(&feedback_timer, 0);
+  }
+
+  void finish() {
+    phase = Phase::Idle;
+
+    const uint8_t span = rest_max - rest_min;
+    if (ticks < MIN_TICKS || span > MAX_REST_SPAN) {
+      IIDX::RgbManager::Turntable::display_tt_change(CRGB::Red, 1, 1);
+      return;
+    }
+
+    // Anywhere in the noise band can end up as the centre, so the deadzone
+    // has to be wider than all of it
+    config new_config = current_config;
+    new_config.tt_deadzone = MAX(MIN(span + 1, static_cast<int>(DEADZONE_MAX)), static_cast<int>(DEADZONE_MIN));
+    new_config.tt_sustain_ms = MIN(longest_gap + longest_gap / 4 + 1, static_cast<int>(MAX_GAP_MS));
+    config_save(new_config);
+
+    IIDX::RgbManager::Turntable::display_tt_change(CRGB::Green,
+                                                   new_config.tt_deadzone,
+                                                   DEADZONE_MAX);
+  }
+
+  void rest(const uint8_t value) {
+    const int8_t delta = value - rest_value;
+    rest_min = MIN(rest_min, delta);
+    rest_max = MAX(rest_max, delta);
+  }
+
+  void spin(const uint8_t value) {
+    const int8_t delta = value - last_value;
+    if (delta == 0) {
+      return;
+    }
+
+    const uint32_t now = milliseconds;
+    const int8_t direction = delta > 0 ? 1 : -1;
+    // Wobble reverses, only gaps between ticks the same way count
+    if (direction == last_direction) {
+      const uint32_t gap = now - last_tick_ms;
+      if (gap <= MAX_GAP_MS) {
+        longest_gap = MAX(longest_gap, static_cast<uint16_t>(gap));
+      }
+      ticks++;
+    }
+    last_value = value;
+    last_direction = direction;
+    last_tick_ms = now;
+  }
+
+  void start() {
+    if (phase != Phase::Idle || current_config.controller_type != ControllerType::IIDX) {
+      return;
+    }
+    enter(Phase::Settle, SETTLE_MS, CRGB::Black);
+  }
+
+  bool running() {
+    return phase != Phase::Idle;
+  }
+
+  void update() {
+    if (phase == Phase::Idle) {
+      return;
+    }
+
+    const uint8_t value = tt_x.get();
+    switch (phase) {
+      case Phase::Settle:
+        if (timer_is_expired(&phase_timer)) {
+          rest_value = value;
+          rest_min = 0;
+          rest_max = 0;
+          enter(Phase::Rest, REST_MS, CRGB::Blue);
+        }
+        break;
+      case Phase::Rest:
+        rest(value);
+        if (timer_is_expired(&phase_timer)) {
+          last_value = value;
+          last_direction = 0;
+          ticks = 0;
+          longest_gap = 0;
+          enter(Phase::Spin, SPIN_MS, CRGB::Yellow);
+        }
+        break;
+      case Phase::Spin:
+        spin(value);
+        if (timer_is_expired(&phase_timer)) {
+          finish();
+          return;
+        }
+        break;
+      default:
+        break;
+    }
+
+    if (timer_check_if_expired_reset(&feedback_timer)) {
+      IIDX::RgbManager::Turntable::display_tt_change(phase_colour, 1, 1);
+      timer_arm(&feedback_timer, FEEDBACK_MS);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Works out the smallest turntable deadzone and sustain this cabinet gets
+// away with. The deadzone has to cover the encoder noise and wobble seen
+// with the turntable left alone, and the sustain has to bridge the longest
+// gap between ticks while it's spun slowly, or the digital TT would flicker.
+// The results are saved like any other config change.
+namespace TtCalibration {
+  enum : uint16_t {
+    // Time to let go of the combo, turntable lights off
+    SETTLE_MS = 1000,
+    // Leave the turntable alone, blue turntable lights
+    REST_MS = 3000,
+    // Spin the turntable slowly in one direction, yellow turntable lights
+    SPIN_MS = 6000,
+
+    // Gaps between ticks longer than this are the player pausing
+    MAX_GAP_MS = 250,
+    // Fewer ticks than this while spinning and nothing is saved
+    MIN_TICKS = 16,
+    // More noise than this at rest means the turntable was touched
+    MAX_REST_SPAN = 16
+  };
+
+  enum class Phase : uint8_t {
+    Idle,
+    Settle,
+    Rest,
+    Spin
+  };
+
+  // Only for IIDX, does nothing if it's already running
+  void start();
+  bool running();
+
+  // Called every main loop pass, after the turntable is polled
+  void update();
+}
@@ -0,0 +1,403 @@
+// Measures how regularly a Linux host polls the board's input reports, and in
+// loopback mode how long a lamp OUT report takes to come back in an IN report
+//
+//   ./input-probe
+//   ./input-probe --interface keyboard --seconds 30
+//   ./input-probe --loopback
+//
+// Reads the hidraw node directly and timestamps every report with
+// CLOCK_MONOTONIC_RAW, so hidapi's buffering doesn't get in the way.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  constexpr unsigned BEEF_VID = 0x1CCF;
+  constexpr unsigned IIDX_PID = 0x8048;
+  constexpr unsigned SDVX_PID = 0x101C;
+
+  const char* const interface_names[] = { "joystick", "keyboard", "mouse" };
+  constexpr int JOYSTICK_INTERFACE = 0;
+  constexpr int NUM_INTERFACES = 3;
+
+  // LATENCY_PROBE builds echo the lights sequence after X, Y and the buttons
+  constexpr size_t IN_SEQUENCE_OFFSET = 4;
+
+  // Reports this much closer together than usual arrived in the same poll
+  constexpr double BUNCHED = 0.5;
+  // and this much further apart missed at least one
+  constexpr double LATE = 1.5;
+
+  struct options {
+    std::string device;
+    int interface = JOYSTICK_INTERFACE;
+    uint32_t seconds = 10;
+    bool loopback = false;
+    bool levels = false;
+    uint32_t rate = 100;
+    bool realtime = false;
+  };
+
+  struct hidraw {
+    std::string path;
+    std::string name;
+    std::string phys;
+    unsigned pid = 0;
+  };
+
+  struct report {
+    int64_t at_ns;
+    bool changed;
+  };
+
+  volatile std::sig_atomic_t stopping = 0;
+
+  int64_t now_ns() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+  }
+
+  // Reads HID_ID, HID_NAME and HID_PHYS for a hidraw node from sysfs
+  bool read_uevent(const std::string &node, hidraw &out, unsigned &vid) {
+    std::ifstream uevent("/sys/class/hidraw/" + node + "/device/uevent");
+    if (!uevent) {
+      return false;
+    }
+
+    std::string line;
+    unsigned bus;
+    bool have_id = false;
+    while (std::getline(uevent, line)) {
+      if (line.compare(0, 7, "HID_ID=") == 0) {
+        have_id = std::sscanf(line.c_str() + 7, "%x:%x:%x", &bus, &vid, &out.pid) == 3;
+      } else if (line.compare(0, 9, "HID_NAME=") == 0) {
+        out.name = line.substr(9);
+      } else if (line.compare(0, 9, "HID_PHYS=") == 0) {
+        out.phys = line.substr(9);
+      }
+    }
+    out.path = "/dev/" + node;
+    return have_id;
+  }
+
+  // USB HID devices end their phys in /inputN with the interface number, and
+  // so do the virtual board's uhid devices
+  int interface_number(const std::string &phys) {
+    const auto at = phys.rfind("/input");
+    return at == std::string::npos ? -1 : std::atoi(phys.c_str() + at + 6);
+  }
+
+  bool find_device(const int interface, hidraw &out) {
+    DIR* dir = opendir("/sys/class/hidraw");
+    if (!dir) {
+      return false;
+    }
+
+    bool found = false;
+    while (dirent* entry = readdir(dir)) {
+      hidraw candidate;
+      unsigned vid;
+      if (entry->d_name[0] == '.' || !read_uevent(entry->d_name, candidate, vid)) {
+        continue;
+      }
+      if (vid == BEEF_VID && (candidate.pid == IIDX_PID || candidate.pid == SDVX_PID) &&
+          interface_number(candidate.phys) == interface) {
+        out = candidate;
+        found = true;
+        break;
+      }
+    }
+    closedir(dir);
+    return found;
+  }
+
+  // Joystick OUT report with every lamp off, see light-latency's build_frame()
+  std::vector<uint8_t> lamp_report(const options &opts, const bool sdvx, const uint8_t sequence) {
+    std::vector<uint8_t> report(1, 0); // no report ID
+    const size_t lamp_bytes = opts.levels ? (sdvx ? 9 : 11) : 2;
+    report.insert(report.end(), lamp_bytes, 0);
+    if (!sdvx) {
+      // Turntable and bar RGB
+      report.insert(report.end(), 6, 0);
+    }
+    report.push_back(sequence);
+    return report;
+  }
+
+  int64_t percentile(std::vector<int64_t> values, const double p) {
+    std::sort(values.begin(), values.end());
+    const size_t i = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    return values[i];
+  }
+
+  void print_distribution(const char* name, const std::vector<int64_t> &values) {
+    if (values.empty()) {
+      return;
+    }
+    std::printf("  %-10s min %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  p99.9 %7.3f  max %7.3f ms\n", name,
+                percentile(values, 0) / 1e6, percentile(values, 0.5) / 1e6,
+                percentile(values, 0.95) / 1e6, percentile(values, 0.99) / 1e6,
+                percentile(values, 0.999) / 1e6, percentile(values, 1) / 1e6);
+  }
+
+  void print_polling(const std::vector<report> &reports) {
+    if (reports.size() < 2) {
+      std::printf("Fewer than 2 reports, nothing to measure. Keyboard and mouse reports only\n"
+                  "come when something changes, so press some buttons while measuring\n");
+      return;
+    }
+
+    std::vector<int64_t> intervals;
+    for (size_t i = 1; i < reports.size(); i++) {
+      intervals.push_back(reports[i].at_ns - reports[i - 1].at_ns);
+    }
+    const int64_t median = percentile(intervals, 0.5);
+
+    std::vector<int64_t> jitter;
+    uint32_t unchanged = 0;
+    uint32_t duplicates = 0;
+    uint32_t bunched = 0;
+    uint32_t late = 0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+      const int64_t interval = intervals[i];
+      jitter.push_back(std::abs(interval - median));
+      const bool same = !reports[i + 1].changed;
+      unchanged += same;
+      if (interval < median * BUNCHED) {
+        bunched++;
+        duplicates += same;
+      }
+      late += interval > median * LATE;
+    }
+
+    const double seconds = (reports.back().at_ns - reports.front().at_ns) / 1e9;
+    const double n = intervals.size();
+    std::printf("%zu reports in %.2f s, %.1f reports/s, median interval %.3f ms (%.0f Hz)\n",
+                reports.size(), seconds, n / seconds, median / 1e6, 1e9 / median);
+    print_distribution("interval", intervals);
+    print_distribution("jitter", jitter);
+    std::printf("  unchanged %.2f%%, duplicates %.2f%%, bunched %.2f%%, late %.2f%%\n",
+                100 * unchanged / n, 100 * duplicates / n, 100 * bunched / n, 100 * late / n);
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: input-probe [--device /dev/hidrawN] [--interface joystick|keyboard|mouse]\n"
+                 "                   [--seconds n] [--loopback] [--levels] [--rate hz] [--realtime]\n"
+                 "--loopback needs firmware built with LATENCY_PROBE=1,\n"
+                 "--levels is for firmware built with BUTTON_LIGHT_LEVELS=1\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--loopback") {
+        opts.loopback = true;
+        continue;
+      }
+      if (arg == "--levels") {
+        opts.levels = true;
+        continue;
+      }
+      if (arg == "--realtime") {
+        opts.realtime = true;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--device") {
+        opts.device = value;
+      } else if (arg == "--interface") {
+        opts.interface = -1;
+        for (int n = 0; n < NUM_INTERFACES; n++) {
+          if (value == interface_names[n]) {
+            opts.interface = n;
+          }
+        }
+        if (opts.interface < 0) {
+          return false;
+        }
+      } else if (arg == "--seconds") {
+        opts.seconds = std::atoi(value.c_str());
+      } else if (arg == "--rate") {
+        opts.rate = std::atoi(value.c_str());
+      } else {
+        return false;
+      }
+    }
+
+    if (opts.loopback && opts.interface != JOYSTICK_INTERFACE) {
+      std::fprintf(stderr, "Loopback only works on the joystick interface\n");
+      return false;
+    }
+    return opts.seconds > 0 && opts.rate > 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  hidraw device;
+  if (!opts.device.empty()) {
+    device.path = opts.device;
+    unsigned vid;
+    const auto slash = opts.device.rfind('/');
+    read_uevent(opts.device.substr(slash == std::string::npos ? 0 : slash + 1), device, vid);
+  } else if (!find_device(opts.interface, device)) {
+    std::fprintf(stderr, "Beef Board %s interface not found\n", interface_names[opts.interface]);
+    return 1;
+  }
+
+  const int fd = open(device.path.c_str(), (opts.loopback ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0) {
+    std::fprintf(stderr, "Can't open %s: %s\n", device.path.c_str(), std::strerror(errno));
+    return 1;
+  }
+  if (device.name.empty()) {
+    std::printf("%s\n", device.path.c_str());
+  } else {
+    std::printf("%s: %s (%s)\n", device.path.c_str(), device.name.c_str(), device.phys.c_str());
+  }
+
+  if (opts.realtime) {
+    sched_param param{};
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) / 2;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0 || mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      std::fprintf(stderr, "Can't run realtime: %s\n", std::strerror(errno));
+    }
+  }
+
+  // Send time of the latest OUT report with each sequence number,
+  // written from the sender thread so writes don't hold up timestamping
+  std::atomic<int64_t> sent_at[256];
+  for (auto &s : sent_at) {
+    s = 0;
+  }
+  std::atomic<bool> sending{ opts.loopback };
+  std::atomic<int> write_error{ 0 };
+  std::thread sender;
+  if (opts.loopback) {
+    sender = std::thread([&]() {
+      const int64_t interval = 1000000000LL / opts.rate;
+      int64_t next = now_ns();
+      uint8_t sequence = 0;
+      while (sending) {
+        // 0 means untagged to the board
+        sequence = sequence == 255 ? 1 : sequence + 1;
+        const auto out = lamp_report(opts, device.pid == SDVX_PID, sequence);
+        sent_at[sequence] = now_ns();
+        if (write(fd, out.data(), out.size()) < 0) {
+          write_error = errno;
+          return;
+        }
+        next += interval;
+        const int64_t wait = next - now_ns();
+        if (wait > 0) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        }
+      }
+    });
+  }
+
+  std::signal(SIGINT, [](int) { stopping = 1; });
+  std::printf("Measuring for %u s, press Ctrl+C to stop early\n", opts.seconds);
+  std::fflush(stdout);
+
+  std::vector<report> reports;
+  reports.reserve(opts.seconds * 1000 + 1000);
+  std::vector<int64_t> round_trips;
+  uint8_t last_echo = 0;
+  bool echo_checked = false;
+  uint8_t previous[64];
+  size_t previous_size = 0;
+
+  const int64_t end = now_ns() + opts.seconds * 1000000000LL;
+  while (!stopping && !write_error && now_ns() < end) {
+    pollfd p{ fd, POLLIN, 0 };
+    if (::poll(&p, 1, 100) <= 0) {
+      continue;
+    }
+
+    uint8_t data[64];
+    const ssize_t n = read(fd, data, sizeof(data));
+    const int64_t at = now_ns();
+    if (n <= 0) {
+      std::fprintf(stderr, "Read failed, was the board unplugged?\n");
+      break;
+    }
+
+    const bool changed = static_cast<size_t>(n) != previous_size || std::memcmp(data, previous, n) != 0;
+    std::memcpy(previous, data, n);
+    previous_size = n;
+    reports.push_back({ at, changed });
+
+    if (!opts.loopback) {
+      continue;
+    }
+    if (!echo_checked) {
+      echo_checked = true;
+      if (static_cast<size_t>(n) <= IN_SEQUENCE_OFFSET) {
+        std::fprintf(stderr, "Reports don't echo a sequence number, is the firmware built with LATENCY_PROBE=1?\n");
+        break;
+      }
+    }
+
+    // Only the first report with each new sequence counts
+    const uint8_t echo = data[IN_SEQUENCE_OFFSET];
+    if (echo != 0 && echo != last_echo) {
+      last_echo = echo;
+      const int64_t sent = sent_at[echo];
+      if (sent != 0 && at > sent && at - sent < 1000000000LL) {
+        round_trips.push_back(at - sent);
+      }
+    }
+  }
+
+  sending = false;
+  if (sender.joinable()) {
+    sender.join();
+  }
+  if (write_error) {
+    std::fprintf(stderr, "Failed to send lamp report: %s\n", std::strerror(write_error));
+  }
+
+  print_polling(reports);
+  if (opts.loopback) {
+    std::printf("Loopback, %zu frames at %u Hz\n", round_trips.size(), opts.rate);
+    print_distribution("OUT to IN", round_trips);
+  }
+
+  close(fd);
+  // Fails if nothing was measured, so scripts and CI can tell
+  if (reports.empty() || (opts.loopback && round_trips.empty()) || write_error) {
+    return 1;
+  }
+  return 0;
+}
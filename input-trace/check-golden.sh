@@ -0,0 +1,33 @@
+#!/bin/sh
+# Replays every trace in golden/ and compares the output with the .expected
+# file next to it, then replays each again starting just before the 49.7 day
+# wrap of the millisecond counter, which has to print exactly the same
+#
+#   ./check-golden.sh [trace-replay]
+#
+# After a deliberate change to what trace-replay prints, regenerate the
+# expected output with ./trace-replay golden/name.trace > golden/name.expected
+
+REPLAY=${1:-./trace-replay}
+# 1 s, 296 ms and 1 ms before the wrap
+UPTIMES="4294966296 4294967000 4294967295"
+
+cd "$(dirname "$0")" || exit 1
+failed=0
+for trace in golden/*.trace; do
+  expected=${trace%.trace}.expected
+  for uptime in default $UPTIMES; do
+    if [ "$uptime" = default ]; then
+      set --
+    else
+      set -- --uptime "$uptime"
+    fi
+    if "$REPLAY" "$trace" "$@" | diff -u "$expected" - >&2; then
+      echo "ok   $trace $*"
+    else
+      echo "FAIL $trace $*"
+      failed=1
+    fi
+  done
+done
+exit $failed
@@ -0,0 +1,240 @@
+// Downloads the input trace recorded by firmware built with INPUT_TRACE=1,
+// see fw/trace.h
+//
+//   ./trace-dump --arm
+//   ./trace-dump --output phantom-flip.trace
+//   ./trace-dump --freeze --controller sdvx --output -
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <hidapi.h>
+
+#include "trace.h"
+
+namespace {
+  constexpr unsigned short BEEF_VID = 0x1CCF;
+  constexpr unsigned short IIDX_PID = 0x8048;
+  constexpr unsigned short SDVX_PID = 0x101C;
+
+  constexpr int CONFIG_INTERFACE = 3;
+
+  constexpr uint8_t REPORT_ID_TRACE = 7;
+  constexpr size_t CHUNK_SAMPLES = 12;
+  constexpr size_t SAMPLE_SIZE = 6;
+  constexpr size_t SETTINGS_SIZE = 7;
+  constexpr size_t HEADER_SIZE = 6 + SETTINGS_SIZE;
+  constexpr size_t TRACE_REPORT_SIZE = HEADER_SIZE + CHUNK_SAMPLES * SAMPLE_SIZE;
+
+  constexpr uint16_t DELTA_MS = 1 << 15;
+  constexpr uint32_t LOOP_UNIT_US = 32;
+
+  enum class State : uint8_t {
+    Recording,
+    Frozen
+  };
+
+  enum class Action : uint8_t {
+    Read,
+    Freeze,
+    Arm
+  };
+
+  enum class Mode {
+    Download,
+    Freeze,
+    Arm
+  };
+
+  struct options {
+    Mode mode = Mode::Download;
+    bool sdvx = false;
+    std::string output = "input.trace";
+  };
+
+  struct chunk {
+    State state;
+    uint16_t count;
+    uint16_t offset;
+    uint8_t length;
+    TraceFile::settings captured;
+    const uint8_t* samples;
+  };
+
+  hid_device* open_interface(const unsigned short pid, const int interface) {
+    hid_device* device = nullptr;
+    hid_device_info* devices = hid_enumerate(BEEF_VID, pid);
+    for (auto d = devices; d; d = d->next) {
+      if (d->interface_number == interface) {
+        device = hid_open_path(d->path);
+        break;
+      }
+    }
+    hid_free_enumeration(devices);
+    return device;
+  }
+
+  bool send_action(hid_device* config, const Action action, const uint16_t offset = 0) {
+    const uint8_t report[] = {
+      REPORT_ID_TRACE, static_cast<uint8_t>(action),
+      static_cast<uint8_t>(offset), static_cast<uint8_t>(offset >> 8)
+    };
+    return hid_send_feature_report(config, report, sizeof(report)) == static_cast<int>(sizeof(report));
+  }
+
+  // report must outlive out.samples
+  bool read_chunk(hid_device* config, uint8_t (&report)[1 + TRACE_REPORT_SIZE], chunk &out) {
+    report[0] = REPORT_ID_TRACE;
+    if (hid_get_feature_report(config, report, sizeof(report)) < static_cast<int>(sizeof(report))) {
+      return false;
+    }
+
+    const uint8_t* data = report + 1;
+    out.state = static_cast<State>(data[0]);
+    std::memcpy(&out.count, data + 1, sizeof(out.count));
+    std::memcpy(&out.offset, data + 3, sizeof(out.offset));
+    out.length = std::min<uint8_t>(data[5], CHUNK_SAMPLES);
+
+    const uint8_t* s = data + 6;
+    out.captured.sdvx = s[0] == 1;
+    out.captured.reverse_tt = s[1];
+    out.captured.deadzone = s[2];
+    out.captured.sustain_ms = s[3];
+    out.captured.ratio = s[4];
+    out.captured.buttons_debounce = s[5];
+    out.captured.effectors_debounce = s[6];
+
+    out.samples = data + HEADER_SIZE;
+    return true;
+  }
+
+  bool download(hid_device* config, TraceFile::trace &t) {
+    uint8_t report[1 + TRACE_REPORT_SIZE];
+    uint64_t time_us = 0;
+    uint16_t count = 1;
+    for (uint16_t offset = 0; offset < count; ) {
+      chunk c;
+      if (!send_action(config, Action::Read, offset) || !read_chunk(config, report, c)) {
+        std::fprintf(stderr, "Failed to read the trace, is the firmware built with INPUT_TRACE=1?\n");
+        return false;
+      }
+      if (c.state != State::Frozen) {
+        std::fprintf(stderr, "The trace isn't frozen, hold the trigger combo or use --freeze first\n");
+        return false;
+      }
+      // Re-armed and frozen again underneath us
+      if (c.offset != offset || (offset > 0 && c.count != count)) {
+        std::fprintf(stderr, "The trace changed while downloading it\n");
+        return false;
+      }
+      count = c.count;
+      t.captured = c.captured;
+      if (c.length == 0) {
+        break;
+      }
+
+      for (uint8_t i = 0; i < c.length; i++) {
+        const uint8_t* s = c.samples + i * SAMPLE_SIZE;
+        uint16_t delta, buttons;
+        std::memcpy(&delta, s, sizeof(delta));
+        std::memcpy(&buttons, s + 2, sizeof(buttons));
+        time_us += delta & DELTA_MS ? (delta & (DELTA_MS - 1)) * 1000ull : delta;
+        t.samples.push_back({ time_us, buttons, static_cast<uint8_t>(s[4] & 0x0F), s[5] * LOOP_UNIT_US });
+      }
+      offset += c.length;
+    }
+    return true;
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: trace-dump [--arm | --freeze] [--controller iidx|sdvx] [--output file]\n"
+                 "Needs firmware built with INPUT_TRACE=1. With no --arm or --freeze,\n"
+                 "downloads the frozen trace to --output, input.trace by default\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--arm") {
+        opts.mode = Mode::Arm;
+        continue;
+      }
+      if (arg == "--freeze") {
+        opts.mode = Mode::Freeze;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--controller") {
+        opts.sdvx = value == "sdvx";
+      } else if (arg == "--output") {
+        opts.output = value;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  if (hid_init() != 0) {
+    std::fprintf(stderr, "Failed to start hidapi\n");
+    return 1;
+  }
+
+  hid_device* config = open_interface(opts.sdvx ? SDVX_PID : IIDX_PID, CONFIG_INTERFACE);
+  if (!config) {
+    std::fprintf(stderr, "Beef Board not found\n");
+    return 1;
+  }
+
+  int result = 0;
+  switch (opts.mode) {
+    case Mode::Arm:
+    case Mode::Freeze: {
+      const bool arm = opts.mode == Mode::Arm;
+      if (!send_action(config, arm ? Action::Arm : Action::Freeze)) {
+        std::fprintf(stderr, "Failed to send the command, is the firmware built with INPUT_TRACE=1?\n");
+        result = 1;
+      } else if (arm) {
+        std::printf("Recording, hold the trigger combo for 2 seconds to freeze the trace\n");
+      } else {
+        std::printf("Frozen, run trace-dump again to download it\n");
+      }
+      break;
+    }
+    case Mode::Download: {
+      TraceFile::trace t;
+      if (!download(config, t)) {
+        result = 1;
+      } else if (!TraceFile::write(opts.output, t)) {
+        std::fprintf(stderr, "Can't write %s\n", opts.output.c_str());
+        result = 1;
+      } else if (opts.output != "-") {
+        const double seconds = t.samples.empty() ? 0 : t.samples.back().time_us / 1e6;
+        std::printf("Saved %zu samples covering %.1f s to %s\n",
+                    t.samples.size(), seconds, opts.output.c_str());
+      }
+      break;
+    }
+  }
+
+  hid_close(config);
+  hid_exit();
+  return result;
+}
@@ -0,0 +1,345 @@
+// Replays an input trace from trace-dump through the firmware's own turntable
+// and debounce code, compiled natively, so settings can be tried against
+// inputs recorded on a real cabinet
+//
+//   ./trace-replay phantom-flip.trace
+//   ./trace-replay phantom-flip.trace --deadzone 6 --sustain 200 --summary
+//   ./trace-replay phantom-flip.trace --uptime 4294966296
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "analog_button.h"
+#include "axis.h"
+#include "config.h"
+#include "debounce.h"
+#include "timer.h"
+
+#include "trace.h"
+
+// What the firmware reads, see virtual-board/shim/avr/io.h
+#define AVR_DEFINE_8(name) volatile uint8_t name;
+#define AVR_DEFINE_16(name) volatile uint16_t name;
+AVR_REGISTERS_8(AVR_DEFINE_8)
+AVR_REGISTERS_16(AVR_DEFINE_16)
+#undef AVR_DEFINE_8
+#undef AVR_DEFINE_16
+
+config current_config;
+
+namespace {
+  constexpr uint16_t MAIN_BUTTONS_ALL = 0x7F;
+  constexpr uint16_t EFFECTORS_ALL = 0x780;
+  constexpr uint8_t IIDX_BUTTONS = 11;
+  constexpr uint8_t SDVX_BUTTONS = 9;
+
+  // A main loop pass this long can skip encoder states
+  constexpr uint32_t LONG_LOOP_US = 1000;
+  // Turntable direction reversals quicker than this are reported as flips
+  constexpr uint32_t FLIP_MS = 50;
+  // The clock starts here by default so the debouncer's first pass isn't taken as a repeat
+  constexpr uint32_t START_MS = 1000;
+  // After this long with no input change nothing can still be settling
+  constexpr uint32_t SETTLE_MS = 1000;
+
+  struct options {
+    std::string path;
+    TraceFile::settings overrides;
+    bool deadzone = false;
+    bool sustain = false;
+    bool ratio = false;
+    bool debounce = false;
+    bool effectors_debounce = false;
+    bool reverse = false;
+    bool summary = false;
+    uint32_t uptime_ms = START_MS;
+  };
+
+  struct stats {
+    uint32_t raw_presses[IIDX_BUTTONS] = {};
+    uint32_t presses[IIDX_BUTTONS] = {};
+    uint32_t tt_starts = 0;
+    uint32_t reversals = 0;
+    uint32_t flips = 0;
+    uint32_t long_loops = 0;
+    uint32_t longest_loop_us = 0;
+  };
+
+  // Same as update_tt_transitions() in fw/beef.cpp
+  void set_tt_transitions(const bool reverse_tt) {
+    const int8_t direction = reverse_tt ? -1 : 1;
+    const int8_t opposite_direction = -direction;
+    const int8_t values[4][4] = {
+        {0, direction, opposite_direction, 0},
+        {opposite_direction, 0, 0, direction},
+        {direction, 0, 0, opposite_direction},
+        {0, opposite_direction, direction, 0}
+    };
+    std::memcpy(tt_transitions, values, sizeof(tt_transitions));
+  }
+
+  // Board uptime when the trace starts, so a replay can cross the 49.7 day wrap
+  uint32_t start_ms = START_MS;
+
+  void set_clock(const uint64_t us) {
+    milliseconds = start_ms + static_cast<uint32_t>(us / 1000);
+    TCNT1 = us % 1000 / 4;
+  }
+
+  class Replay {
+  public:
+    Replay(const TraceFile::settings &s, const bool quiet) : s(s), quiet(quiet) {
+      current_config.reverse_tt = s.reverse_tt;
+      current_config.tt_deadzone = s.deadzone;
+      current_config.tt_sustain_ms = s.sustain_ms;
+      current_config.tt_ratio = s.ratio;
+      set_tt_transitions(s.reverse_tt);
+      buttons_debounce.init(s.buttons_debounce);
+      effectors_debounce.init(s.effectors_debounce);
+      sdvx_debounce.init(s.buttons_debounce);
+    }
+
+    void start(const TraceFile::sample &first) {
+      set_clock(0);
+      PINF = first.encoders;
+      tt_x.poll();
+      button_x.init(s.deadzone, true, tt_x.get());
+      last_raw = first.buttons;
+    }
+
+    // One main loop pass, the same as IIDX::UsbHandler::update() or SDVX's
+    void pass(const uint64_t us, const uint16_t raw) {
+      set_clock(us);
+      uint16_t state = raw;
+      if (s.sdvx) {
+        state = sdvx_debounce.debounce(state);
+      } else {
+        tt_x.poll();
+        const int8_t tt = button_x.poll(s.deadzone, s.sustain_ms, tt_x.get());
+        turntable(us, tt);
+        state = buttons_debounce.debounce(state, MAIN_BUTTONS_ALL);
+        state = effectors_debounce.debounce(state, EFFECTORS_ALL);
+      }
+
+      const uint8_t buttons = s.sdvx ? SDVX_BUTTONS : IIDX_BUTTONS;
+      for (uint8_t i = 0; i < buttons; i++) {
+        const uint16_t bit = 1 << i;
+        if ((raw & bit) && !(last_raw & bit)) {
+          results.raw_presses[i]++;
+        }
+        if ((state & bit) != (last_state & bit)) {
+          if (state & bit) {
+            results.presses[i]++;
+          }
+          print(us, "B%u %s", i + 1, state & bit ? "pressed" : "released");
+        }
+      }
+      last_raw = raw;
+      last_state = state;
+    }
+
+    void long_loop(const uint64_t us, const uint32_t loop_us) {
+      results.longest_loop_us = std::max(results.longest_loop_us, loop_us);
+      if (loop_us >= LONG_LOOP_US) {
+        results.long_loops++;
+        print(us, "main loop pass took %.2f ms", loop_us / 1000.0);
+      }
+    }
+
+    const stats &get_stats() const {
+      return results;
+    }
+
+  private:
+    void turntable(const uint64_t us, const int8_t tt) {
+      if (tt == last_tt) {
+        return;
+      }
+      if (tt == 0) {
+        print(us, "TT stopped");
+      } else if (last_tt == 0) {
+        results.tt_starts++;
+        print(us, "TT %c", tt > 0 ? '+' : '-');
+      } else {
+        results.reversals++;
+        const uint64_t held_ms = (us - tt_since_us) / 1000;
+        const bool flip = held_ms < FLIP_MS;
+        results.flips += flip;
+        print(us, "TT %c -> %c after %" PRIu64 " ms%s", last_tt > 0 ? '+' : '-', tt > 0 ? '+' : '-',
+              held_ms, flip ? "  <-- flip" : "");
+      }
+      last_tt = tt;
+      tt_since_us = us;
+    }
+
+    [[gnu::format(printf, 3, 4)]] void print(const uint64_t us, const char* format, ...) const {
+      if (quiet) {
+        return;
+      }
+      std::printf("%10.3f ms  ", us / 1000.0);
+      va_list args;
+      va_start(args, format);
+      std::vprintf(format, args);
+      va_end(args);
+      std::printf("\n");
+    }
+
+    const TraceFile::settings s;
+    const bool quiet;
+    Debouncer<IIDX_BUTTONS> buttons_debounce;
+    Debouncer<IIDX_BUTTONS> effectors_debounce;
+    Debouncer<SDVX_BUTTONS> sdvx_debounce;
+    uint16_t last_raw = 0;
+    uint16_t last_state = 0;
+    int8_t last_tt = 0;
+    uint64_t tt_since_us = 0;
+    stats results;
+  };
+
+  void print_settings(const char* name, const TraceFile::settings &s) {
+    if (s.sdvx) {
+      std::printf("%s: sdvx, debounce %u ms\n", name, s.buttons_debounce);
+      return;
+    }
+    std::printf("%s: iidx, reverse_tt %u, deadzone %u, sustain %u ms, ratio %u, "
+                "debounce %u ms, effectors debounce %u ms\n",
+                name, s.reverse_tt, s.deadzone, s.sustain_ms, s.ratio,
+                s.buttons_debounce, s.effectors_debounce);
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: trace-replay <trace file> [--deadzone n] [--sustain ms] [--ratio n]\n"
+                 "                    [--debounce ms] [--effectors-debounce ms] [--reverse 0|1]\n"
+                 "                    [--uptime ms] [--summary]\n"
+                 "Settings default to the ones the trace was recorded with\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--summary") {
+        opts.summary = true;
+        continue;
+      }
+      if (arg.compare(0, 2, "--") != 0) {
+        if (!opts.path.empty()) {
+          return false;
+        }
+        opts.path = arg;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const uint32_t value = std::strtoul(argv[++i], nullptr, 10);
+      auto &o = opts.overrides;
+      if (arg == "--deadzone") {
+        o.deadzone = value;
+        opts.deadzone = true;
+      } else if (arg == "--sustain") {
+        o.sustain_ms = value;
+        opts.sustain = true;
+      } else if (arg == "--ratio") {
+        o.ratio = value;
+        opts.ratio = true;
+      } else if (arg == "--debounce") {
+        o.buttons_debounce = value;
+        opts.debounce = true;
+      } else if (arg == "--effectors-debounce") {
+        o.effectors_debounce = value;
+        opts.effectors_debounce = true;
+      } else if (arg == "--reverse") {
+        o.reverse_tt = value;
+        opts.reverse = true;
+      } else if (arg == "--uptime") {
+        opts.uptime_ms = value;
+      } else {
+        return false;
+      }
+    }
+
+    const auto &o = opts.overrides;
+    return !opts.path.empty() && o.deadzone > 0 && o.ratio > 0 &&
+      o.sustain_ms <= UINT8_MAX && o.buttons_debounce <= UINT8_MAX && o.effectors_debounce <= UINT8_MAX;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  TraceFile::trace t;
+  if (!TraceFile::read(opts.path, t)) {
+    return 1;
+  }
+  if (t.samples.empty()) {
+    std::fprintf(stderr, "%s has no samples\n", opts.path.c_str());
+    return 1;
+  }
+
+  TraceFile::settings s = t.captured;
+  const auto &o = opts.overrides;
+  s.deadzone = opts.deadzone ? o.deadzone : s.deadzone;
+  s.sustain_ms = opts.sustain ? o.sustain_ms : s.sustain_ms;
+  s.ratio = opts.ratio ? o.ratio : s.ratio;
+  s.buttons_debounce = opts.debounce ? o.buttons_debounce : s.buttons_debounce;
+  s.effectors_debounce = opts.effectors_debounce ? o.effectors_debounce : s.effectors_debounce;
+  s.reverse_tt = opts.reverse ? o.reverse_tt : s.reverse_tt;
+  if (s.ratio == 0) {
+    std::fprintf(stderr, "The trace has a turntable ratio of 0, pass --ratio\n");
+    return 1;
+  }
+
+  start_ms = opts.uptime_ms;
+  print_settings("Recorded with", t.captured);
+  print_settings("Replaying with", s);
+
+  Replay replay(s, opts.summary);
+  replay.start(t.samples.front());
+
+  // The board polls many times a millisecond, but nothing changes between
+  // samples apart from the clock, which the timers only read in whole ms
+  for (size_t i = 0; i < t.samples.size(); i++) {
+    const auto &sample = t.samples[i];
+    replay.long_loop(sample.time_us, sample.max_loop_us);
+    PINF = sample.encoders;
+    replay.pass(sample.time_us, sample.buttons);
+
+    const uint64_t next_us = i + 1 < t.samples.size() ?
+      t.samples[i + 1].time_us : sample.time_us + SETTLE_MS * 1000;
+    const uint64_t settled_us = sample.time_us + SETTLE_MS * 1000;
+    for (uint64_t us = (sample.time_us / 1000 + 1) * 1000; us < next_us && us < settled_us; us += 1000) {
+      replay.pass(us, sample.buttons);
+    }
+  }
+
+  const stats &r = replay.get_stats();
+  const double seconds = t.samples.back().time_us / 1e6;
+  std::printf("\n%zu samples over %.1f s\n", t.samples.size(), seconds);
+  std::printf("Button    raw presses  presses\n");
+  const uint8_t buttons = s.sdvx ? SDVX_BUTTONS : IIDX_BUTTONS;
+  for (uint8_t i = 0; i < buttons; i++) {
+    if (r.raw_presses[i] || r.presses[i]) {
+      std::printf("B%-2u       %11u  %7u\n", i + 1, r.raw_presses[i], r.presses[i]);
+    }
+  }
+  if (!s.sdvx) {
+    std::printf("Turntable: %u spins, %u reversals, %u flips under %u ms\n",
+                r.tt_starts, r.reversals, r.flips, FLIP_MS);
+  }
+  std::printf("Longest main loop pass %.2f ms, %u over %.2f ms\n",
+              r.longest_loop_us / 1000.0, r.long_loops, LONG_LOOP_US / 1000.0);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "trace.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace TraceFile {
+  namespace {
+    const char HEADER[] = "# beef-board input trace v1";
+
+    // Fills in whichever key=value pairs are known, ignores the rest
+    void parse_settings(const char* line, settings &s) {
+      char key[32];
+      char value[16];
+      int consumed;
+      while (std::sscanf(line, " %31[^=]=%15s%n", key, value, &consumed) == 2) {
+        line += consumed;
+        const std::string k = key;
+        const uint32_t v = std::strtoul(value, nullptr, 10);
+        if (k == "controller") {
+          s.sdvx = std::strcmp(value, "sdvx") == 0;
+        } else if (k == "reverse_tt") {
+          s.reverse_tt = v;
+        } else if (k == "deadzone") {
+          s.deadzone = v;
+        } else if (k == "sustain_ms") {
+          s.sustain_ms = v;
+        } else if (k == "ratio") {
+          s.ratio = v;
+        } else if (k == "buttons_debounce") {
+          s.buttons_debounce = v;
+        } else if (k == "effectors_debounce") {
+          s.effectors_debounce = v;
+        }
+      }
+    }
+  }
+
+  bool write(const std::string &path, const trace &t) {
+    std::FILE* f = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+    if (!f) {
+      return false;
+    }
+
+    const settings &s = t.captured;
+    std::fprintf(f, "%s\n", HEADER);
+    std::fprintf(f, "settings controller=%s reverse_tt=%u deadzone=%u sustain_ms=%u ratio=%u "
+                 "buttons_debounce=%u effectors_debounce=%u\n",
+                 s.sdvx ? "sdvx" : "iidx", s.reverse_tt, s.deadzone, s.sustain_ms, s.ratio,
+                 s.buttons_debounce, s.effectors_debounce);
+    std::fprintf(f, "# time_us buttons encoders max_loop_us\n");
+    for (const auto &sample : t.samples) {
+      std::fprintf(f, "%" PRIu64 " %04x %x %u\n",
+                   sample.time_us, sample.buttons, sample.encoders, sample.max_loop_us);
+    }
+
+    const bool ok = !std::ferror(f);
+    if (f != stdout) {
+      std::fclose(f);
+    }
+    return ok;
+  }
+
+  bool read(const std::string &path, trace &t) {
+    std::FILE* f = path == "-" ? stdin : std::fopen(path.c_str(), "r");
+    if (!f) {
+      std::fprintf(stderr, "Can't open %s\n", path.c_str());
+      return false;
+    }
+
+    char line[256];
+    uint32_t number = 0;
+    bool ok = true;
+    while (ok && std::fgets(line, sizeof(line), f)) {
+      number++;
+      if (number == 1 && std::strncmp(line, HEADER, sizeof(HEADER) - 1) != 0) {
+        std::fprintf(stderr, "%s isn't a Beef Board input trace\n", path.c_str());
+        ok = false;
+      } else if (line[0] == '#' || line[0] == '\n') {
+        continue;
+      } else if (std::strncmp(line, "settings", 8) == 0) {
+        parse_settings(line + 8, t.captured);
+      } else {
+        uint64_t time_us;
+        unsigned buttons, encoders, max_loop_us;
+        if (std::sscanf(line, "%" SCNu64 " %x %x %u", &time_us, &buttons, &encoders, &max_loop_us) != 4 ||
+            (!t.samples.empty() && time_us < t.samples.back().time_us)) {
+          std::fprintf(stderr, "%s:%u: bad sample\n", path.c_str(), number);
+          ok = false;
+        } else {
+          t.samples.push_back({ time_us, static_cast<uint16_t>(buttons),
+                                static_cast<uint8_t>(encoders & 0x0F), max_loop_us });
+        }
+      }
+    }
+
+    if (f != stdin) {
+      std::fclose(f);
+    }
+    return ok;
+  }
+}
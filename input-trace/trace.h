@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Trace files written by trace-dump and read by trace-replay
+//
+//   # beef-board input trace v1
+//   settings controller=iidx reverse_tt=0 deadzone=4 sustain_ms=133 ratio=2 buttons_debounce=0 effectors_debounce=0
+//   <time_us> <buttons hex> <encoders hex> <max_loop_us>
+//   ...
+namespace TraceFile {
+  struct settings {
+    bool sdvx = false;
+    uint32_t reverse_tt = 0;
+    uint32_t deadzone = 4;
+    uint32_t sustain_ms = 133;
+    uint32_t ratio = 2;
+    uint32_t buttons_debounce = 0;
+    uint32_t effectors_debounce = 0;
+  };
+
+  struct sample {
+    uint64_t time_us; // since the first sample
+    uint16_t buttons;
+    uint8_t encoders;
+    uint32_t max_loop_us; // longest main loop pass before this sample
+  };
+
+  struct trace {
+    settings captured;
+    std::vector<sample> samples;
+  };
+
+  bool write(const std::string &path, const trace &t);
+  // Prints why to stderr on failure
+  bool read(const std::string &path, trace &t);
+}
@@ -0,0 +1,329 @@
+// Replays SDVX knob readings through the firmware's knob filter, see
+// fw/knob_filter.h, and measures the noise it removes against the lag it adds
+//
+//   ./knob-bench --synthetic
+//   ./knob-bench --input session.tlm --axis y --min-cutoff 10 --beta 25
+//   ./knob-bench --input session.tlm --sweep
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "knob_filter.h"
+
+namespace {
+  // telemetry-scope recordings, see telemetry-scope/README.md
+  const char FILE_MAGIC[8] = { 'B', 'E', 'E', 'F', 'T', 'L', 'M', '1' };
+  constexpr size_t REPORT_SIZE = 19;
+  constexpr size_t TIME_MS_OFFSET = 1;
+  constexpr size_t ANALOG_X_OFFSET = 13;
+  constexpr size_t ANALOG_Y_OFFSET = 14;
+
+  // Readings within this many LSB of each other for REST_MS either side
+  // are the knob sitting still
+  constexpr int REST_SPAN = 1;
+  constexpr size_t REST_MS = 50;
+  // Shifts tried when lining the output up with the readings
+  constexpr size_t MAX_LAG_MS = 200;
+
+  // Same as the firmware defaults, see fw/config.cpp
+  constexpr uint8_t DEFAULT_MIN_CUTOFF = 10;
+  constexpr uint8_t DEFAULT_BETA = 25;
+
+  struct options {
+    std::string input;
+    bool synthetic = false;
+    bool axis_y = false;
+    bool sweep = false;
+    uint8_t min_cutoff = DEFAULT_MIN_CUTOFF;
+    uint8_t beta = DEFAULT_BETA;
+  };
+
+  struct sample {
+    uint32_t time_ms;
+    uint8_t value;
+  };
+
+  struct result {
+    double flickers_per_s;
+    double onset_ms;
+    size_t lag_ms;
+    double lag_error;
+  };
+
+  bool load_recording(const options &opts, std::vector<sample> &samples) {
+    std::FILE* f = std::fopen(opts.input.c_str(), "rb");
+    if (!f) {
+      std::fprintf(stderr, "Can't open %s\n", opts.input.c_str());
+      return false;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    uint8_t size = 0;
+    if (std::fread(magic, sizeof(magic), 1, f) != 1 || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 ||
+        std::fread(&size, 1, 1, f) != 1 || size < REPORT_SIZE) {
+      std::fprintf(stderr, "%s isn't a telemetry recording\n", opts.input.c_str());
+      std::fclose(f);
+      return false;
+    }
+
+    std::vector<uint8_t> data(size);
+    int64_t host_us;
+    uint32_t time_ms = 0;
+    uint16_t last_time = 0;
+    while (std::fread(&host_us, sizeof(host_us), 1, f) == 1 && std::fread(data.data(), size, 1, f) == 1) {
+      uint16_t t;
+      std::memcpy(&t, data.data() + TIME_MS_OFFSET, sizeof(t));
+      // Reports only carry the low 16 bits of the board's clock
+      time_ms += samples.empty() ? 0 : static_cast<uint16_t>(t - last_time);
+      last_time = t;
+      samples.push_back({ time_ms, data[opts.axis_y ? ANALOG_Y_OFFSET : ANALOG_X_OFFSET] });
+    }
+    std::fclose(f);
+    return true;
+  }
+
+  // Turns at a range of speeds with rests in between, read through an ADC
+  // that flickers by about an LSB. The rests sit close to halfway between
+  // two steps, which is the worst case for flicker
+  std::vector<sample> synthesise() {
+    std::vector<sample> samples;
+    uint32_t seed = 1;
+    const auto noise = [&seed]() {
+      double sum = 0;
+      for (int i = 0; i < 4; i++) {
+        seed = seed * 1664525 + 1013904223;
+        sum += (seed >> 8) / static_cast<double>(1 << 24) - 0.5;
+      }
+      return sum * 0.6;
+    };
+
+    double position = 100.45;
+    uint32_t time_ms = 0;
+    const auto run = [&](const double speed, const uint32_t ms) {
+      for (uint32_t i = 0; i < ms; i++) {
+        position += speed / 1000;
+        const long reading = std::lround(position + noise());
+        samples.push_back({ time_ms++, static_cast<uint8_t>(reading & 0xFF) });
+      }
+    };
+
+    run(0, 1000);
+    int direction = 1;
+    for (const double speed : { 30.0, 150.0, 600.0, 2500.0 }) {
+      run(direction * speed, 400);
+      // Stop just short of halfway between two steps again
+      position = std::floor(position) + 0.45;
+      run(0, 600);
+      direction = -direction;
+    }
+    return samples;
+  }
+
+  // Undoes the wrap around at 0 and 255
+  std::vector<int32_t> unwrap(const std::vector<uint8_t> &values) {
+    std::vector<int32_t> out(values.size());
+    int32_t position = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+      if (i > 0) {
+        position += static_cast<int8_t>(values[i] - values[i - 1]);
+      }
+      out[i] = position;
+    }
+    return out;
+  }
+
+  std::vector<bool> find_rests(const std::vector<int32_t> &raw) {
+    std::vector<bool> rest(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+      const size_t from = i >= REST_MS ? i - REST_MS : 0;
+      const size_t to = std::min(i + REST_MS + 1, raw.size());
+      const auto range = std::minmax_element(raw.begin() + from, raw.begin() + to);
+      rest[i] = *range.second - *range.first <= REST_SPAN;
+    }
+    return rest;
+  }
+
+  result measure(const std::vector<sample> &samples, const uint8_t min_cutoff, const uint8_t beta) {
+    std::vector<uint8_t> raw_values(samples.size());
+    std::vector<uint8_t> filtered_values(samples.size());
+    KnobFilter filter;
+    filter.init(min_cutoff, beta, samples.front().value);
+    for (size_t i = 0; i < samples.size(); i++) {
+      filter.update(samples[i].value, samples[i].time_ms);
+      raw_values[i] = samples[i].value;
+      filtered_values[i] = filter.get();
+    }
+
+    const auto raw = unwrap(raw_values);
+    const auto filtered = unwrap(filtered_values);
+    const auto rest = find_rests(raw);
+
+    result r{};
+
+    // Changes back the other way at rest are flicker, each one a mouse
+    // movement in keyboard mode. Changes the same way are still catching up
+    size_t rest_ms = 0;
+    size_t flickers = 0;
+    int32_t last_step = 0;
+    for (size_t i = 1; i < samples.size(); i++) {
+      const int32_t step = filtered[i] - filtered[i - 1];
+      if (rest[i] && rest[i - 1]) {
+        rest_ms++;
+        flickers += step != 0 && (step > 0) != (last_step > 0);
+      }
+      if (step != 0) {
+        last_step = step;
+      }
+    }
+    r.flickers_per_s = rest_ms ? flickers * 1000.0 / rest_ms : 0;
+
+    // Time from the knob starting to move to the output following it
+    double onset_total = 0;
+    size_t onsets = 0;
+    for (size_t i = 1; i < samples.size(); i++) {
+      if (!rest[i - 1] || rest[i]) {
+        continue;
+      }
+      size_t start = i;
+      while (start < samples.size() && raw[start] == raw[i - 1]) {
+        start++;
+      }
+      for (size_t j = start; j < samples.size() && j - start <= MAX_LAG_MS; j++) {
+        if (filtered[j] != filtered[i - 1]) {
+          onset_total += j - start;
+          onsets++;
+          break;
+        }
+      }
+    }
+    r.onset_ms = onsets ? onset_total / onsets : 0;
+
+    // The shift that lines the output up best with the readings while moving
+    r.lag_error = HUGE_VAL;
+    for (size_t lag = 0; lag <= MAX_LAG_MS; lag++) {
+      double error = 0;
+      size_t n = 0;
+      for (size_t i = lag; i < samples.size(); i++) {
+        if (!rest[i]) {
+          error += std::abs(filtered[i] - raw[i - lag]);
+          n++;
+        }
+      }
+      if (n && error / n < r.lag_error) {
+        r.lag_error = error / n;
+        r.lag_ms = lag;
+      }
+    }
+    if (r.lag_error == HUGE_VAL) {
+      r.lag_error = 0;
+    }
+    return r;
+  }
+
+  void print_header() {
+    std::printf("%10s %6s %16s %10s %8s %10s\n",
+                "min cutoff", "beta", "rest flicker/s", "onset ms", "lag ms", "lag error");
+  }
+
+  void print_row(const uint8_t min_cutoff, const uint8_t beta, const result &r) {
+    char cutoff[16];
+    if (min_cutoff == 0) {
+      std::snprintf(cutoff, sizeof(cutoff), "off");
+    } else {
+      std::snprintf(cutoff, sizeof(cutoff), "%.1f Hz", min_cutoff / 10.0);
+    }
+    std::printf("%10s %6.3f %16.2f %10.1f %8zu %10.2f\n",
+                cutoff, beta / 1000.0, r.flickers_per_s, r.onset_ms, r.lag_ms, r.lag_error);
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: knob-bench --input file [--axis x|y] [--min-cutoff n] [--beta n] [--sweep]\n"
+                 "       knob-bench --synthetic [--min-cutoff n] [--beta n] [--sweep]\n"
+                 "Replays knob readings from a telemetry-scope recording made on SDVX\n");
+  }
+
+  bool parse_byte(const char* value, uint8_t &out) {
+    char* end;
+    const long n = std::strtol(value, &end, 10);
+    if (*end != '\0' || n < 0 || n > 255) {
+      return false;
+    }
+    out = static_cast<uint8_t>(n);
+    return true;
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--synthetic") {
+        opts.synthetic = true;
+        continue;
+      }
+      if (arg == "--sweep") {
+        opts.sweep = true;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const char* value = argv[++i];
+      if (arg == "--input") {
+        opts.input = value;
+      } else if (arg == "--axis") {
+        opts.axis_y = std::string(value) == "y";
+      } else if (arg == "--min-cutoff") {
+        if (!parse_byte(value, opts.min_cutoff)) {
+          return false;
+        }
+      } else if (arg == "--beta") {
+        if (!parse_byte(value, opts.beta)) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+    return opts.synthetic != !opts.input.empty();
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  std::vector<sample> samples;
+  if (opts.synthetic) {
+    samples = synthesise();
+  } else if (!load_recording(opts, samples)) {
+    return 1;
+  }
+  if (samples.size() < 2) {
+    std::fprintf(stderr, "Not enough readings\n");
+    return 1;
+  }
+
+  std::printf("%zu readings over %.1f s\n\n", samples.size(), samples.back().time_ms / 1000.0);
+  print_header();
+  print_row(0, 0, measure(samples, 0, 0));
+  if (opts.sweep) {
+    for (const uint8_t min_cutoff : { 5, 10, 20, 40 }) {
+      for (const uint8_t beta : { 0, 10, 25, 50, 100 }) {
+        print_row(min_cutoff, beta, measure(samples, min_cutoff, beta));
+      }
+    }
+  } else if (opts.min_cutoff != 0) {
+    print_row(opts.min_cutoff, opts.beta, measure(samples, opts.min_cutoff, opts.beta));
+  }
+  return 0;
+}
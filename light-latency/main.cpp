@@ -0,0 +1,388 @@
+// Measures how long light frames take from the host sending them to the board
+// latching them onto the lamps or LED strips, see fw/latency.h
+//
+//   ./light-latency --path tape
+//   ./light-latency --path lamps --controller sdvx
+//   ./light-latency --passive
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hidapi.h>
+
+namespace {
+  constexpr unsigned short BEEF_VID = 0x1CCF;
+  constexpr unsigned short IIDX_PID = 0x8048;
+  constexpr unsigned short SDVX_PID = 0x101C;
+
+  constexpr int JOYSTICK_INTERFACE = 0;
+  constexpr int CONFIG_INTERFACE = 3;
+  constexpr int LIGHTS_INTERFACE = 4;
+
+  constexpr uint8_t REPORT_ID_LATENCY = 6;
+  constexpr size_t REPORT_SAMPLES = 7;
+  constexpr size_t SAMPLE_SIZE = 8;
+  constexpr size_t LATENCY_REPORT_SIZE = 6 + REPORT_SAMPLES * SAMPLE_SIZE;
+
+  // Tape LED protocol, see fw/devices/iidx/iidx_tape_led.h
+  constexpr uint8_t TAPE_LED_VERSION = 1;
+  constexpr uint8_t FLAG_COMMIT = 1 << 0;
+  constexpr size_t TAPE_LED_REPORT_SIZE = 64;
+  constexpr size_t MAX_TAPE_LEDS = (TAPE_LED_REPORT_SIZE - 5) / 3;
+
+  const char* const path_names[] = { "lamps", "turntable", "bar" };
+  constexpr size_t NUM_PATHS = 3;
+
+  enum class Source {
+    Tape,
+    Lamps,
+    Turntable,
+    Bar,
+    Passive
+  };
+
+  struct options {
+    Source source = Source::Tape;
+    bool sdvx = false;
+    bool levels = false;
+    uint32_t rate = 60;
+    uint32_t frames = 1000;
+    uint8_t leds = 16;
+  };
+
+  volatile std::sig_atomic_t stopping = 0;
+
+  int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Maps device timestamps onto the host clock. Each feature report carries the
+  // device's time, which happened somewhere within the round trip. The quickest
+  // recent round trip gives the tightest estimate
+  class ClockSync {
+  public:
+    void add(const uint32_t device_us, const int64_t sent_us, const int64_t received_us) {
+      const int64_t rtt = received_us - sent_us;
+      const int64_t midpoint = sent_us + rtt / 2;
+
+      // Let the best round trip expire, so slow drift between the clocks is tracked
+      if (!valid || rtt <= best_rtt || midpoint - best_host_us > 2000000) {
+        valid = true;
+        best_rtt = rtt;
+        best_device_us = device_us;
+        best_host_us = midpoint;
+      }
+    }
+
+    int64_t to_host(const uint32_t device_us) const {
+      return best_host_us + static_cast<int32_t>(device_us - best_device_us);
+    }
+
+    // How far off to_host() can be
+    int64_t uncertainty() const {
+      return best_rtt / 2;
+    }
+
+    bool valid = false;
+
+  private:
+    int64_t best_rtt = 0;
+    uint32_t best_device_us = 0;
+    int64_t best_host_us = 0;
+  };
+
+  struct sample {
+    uint8_t path;
+    uint8_t sequence;
+    uint32_t received_us;
+    uint16_t latch_us;
+  };
+
+  struct stats {
+    std::vector<int64_t> transfer;
+    std::vector<int64_t> device;
+    std::vector<int64_t> total;
+  };
+
+  hid_device* open_interface(const unsigned short pid, const int interface) {
+    hid_device* device = nullptr;
+    hid_device_info* devices = hid_enumerate(BEEF_VID, pid);
+    for (auto d = devices; d; d = d->next) {
+      if (d->interface_number == interface) {
+        device = hid_open_path(d->path);
+        break;
+      }
+    }
+    hid_free_enumeration(devices);
+    return device;
+  }
+
+  // Returns false if the report couldn't be read
+  bool read_samples(hid_device* config, ClockSync &sync, std::vector<sample> &samples, uint32_t &dropped) {
+    uint8_t report[1 + LATENCY_REPORT_SIZE] = { REPORT_ID_LATENCY };
+    const int64_t sent = now_us();
+    const int n = hid_get_feature_report(config, report, sizeof(report));
+    const int64_t received = now_us();
+    if (n < static_cast<int>(sizeof(report))) {
+      return false;
+    }
+
+    const uint8_t* data = report + 1;
+    uint32_t device_now;
+    std::memcpy(&device_now, data, sizeof(device_now));
+    sync.add(device_now, sent, received);
+
+    const uint8_t count = std::min<uint8_t>(data[4], REPORT_SAMPLES);
+    dropped += data[5];
+    for (uint8_t i = 0; i < count; i++) {
+      const uint8_t* s = data + 6 + i * SAMPLE_SIZE;
+      sample out;
+      out.path = s[0];
+      out.sequence = s[1];
+      std::memcpy(&out.received_us, s + 2, sizeof(out.received_us));
+      std::memcpy(&out.latch_us, s + 6, sizeof(out.latch_us));
+      samples.push_back(out);
+    }
+    return true;
+  }
+
+  // Frames alternate between two states, so every one changes the output
+  std::vector<uint8_t> build_frame(const options &opts, const uint8_t sequence, const bool on) {
+    std::vector<uint8_t> report(1, 0); // no report ID
+    const uint8_t level = on ? 0x40 : 0x00;
+
+    if (opts.source == Source::Tape) {
+      report.resize(1 + TAPE_LED_REPORT_SIZE);
+      report[1] = TAPE_LED_VERSION;
+      report[2] = FLAG_COMMIT;
+      report[3] = sequence;
+      report[4] = 0;
+      report[5] = opts.leds;
+      std::fill(report.begin() + 6, report.begin() + 6 + opts.leds * 3, level);
+      return report;
+    }
+
+    // Joystick OUT report: lamps, then the TT and bar RGB for IIDX, then the sequence
+    const size_t lamp_bytes = opts.levels ? (opts.sdvx ? 9 : 11) : 2;
+    const uint8_t lamps = opts.source == Source::Lamps && on ? 0xFF : 0x00;
+    report.insert(report.end(), lamp_bytes, lamps);
+    if (!opts.sdvx) {
+      const uint8_t tt = opts.source == Source::Turntable ? level : 0;
+      const uint8_t bar = opts.source == Source::Bar ? level : 0;
+      report.insert(report.end(), { tt, tt, tt, bar, bar, bar });
+    }
+    report.push_back(sequence);
+    return report;
+  }
+
+  int64_t percentile(std::vector<int64_t> values, const double p) {
+    std::sort(values.begin(), values.end());
+    const size_t i = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    return values[i];
+  }
+
+  void print_distribution(const char* name, const std::vector<int64_t> &values) {
+    if (values.empty()) {
+      return;
+    }
+    std::printf("  %-18s min %6.2f  p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms\n", name,
+                percentile(values, 0) / 1000.0, percentile(values, 0.5) / 1000.0,
+                percentile(values, 0.95) / 1000.0, percentile(values, 0.99) / 1000.0,
+                percentile(values, 1) / 1000.0);
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: light-latency [--path tape|lamps|tt|bar] [--passive] [--controller iidx|sdvx]\n"
+                 "                     [--levels] [--rate hz] [--frames n] [--leds n]\n"
+                 "lamps, tt and bar need firmware built with LATENCY_PROBE=1,\n"
+                 "--levels is for firmware built with BUTTON_LIGHT_LEVELS=1\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--passive") {
+        opts.source = Source::Passive;
+        continue;
+      }
+      if (arg == "--levels") {
+        opts.levels = true;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--path") {
+        if (value == "tape") {
+          opts.source = Source::Tape;
+        } else if (value == "lamps") {
+          opts.source = Source::Lamps;
+        } else if (value == "tt") {
+          opts.source = Source::Turntable;
+        } else if (value == "bar") {
+          opts.source = Source::Bar;
+        } else {
+          return false;
+        }
+      } else if (arg == "--controller") {
+        opts.sdvx = value == "sdvx";
+      } else if (arg == "--rate") {
+        opts.rate = std::atoi(value.c_str());
+      } else if (arg == "--frames") {
+        opts.frames = std::atoi(value.c_str());
+      } else if (arg == "--leds") {
+        opts.leds = std::atoi(value.c_str());
+      } else {
+        return false;
+      }
+    }
+
+    if (opts.sdvx && opts.source != Source::Lamps && opts.source != Source::Passive) {
+      std::fprintf(stderr, "SDVX only has lamps\n");
+      return false;
+    }
+    return opts.rate > 0 && opts.leds > 0 && opts.leds <= MAX_TAPE_LEDS;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  if (hid_init() != 0) {
+    std::fprintf(stderr, "Failed to start hidapi\n");
+    return 1;
+  }
+
+  const unsigned short pid = opts.sdvx ? SDVX_PID : IIDX_PID;
+  hid_device* config = open_interface(pid, CONFIG_INTERFACE);
+  if (!config) {
+    std::fprintf(stderr, "Beef Board not found\n");
+    return 1;
+  }
+
+  hid_device* output = nullptr;
+  if (opts.source != Source::Passive) {
+    output = open_interface(pid, opts.source == Source::Tape ? LIGHTS_INTERFACE : JOYSTICK_INTERFACE);
+    if (!output) {
+      std::fprintf(stderr, "Can't open the Beef Board's light output\n");
+      return 1;
+    }
+  }
+
+  ClockSync sync;
+  std::vector<sample> samples;
+  uint32_t dropped = 0;
+  stats results[NUM_PATHS];
+
+  // Send time of the latest frame with each sequence number
+  int64_t sent_at[256] = {};
+  uint8_t sequence = 0;
+
+  const int64_t frame_interval = 1000000 / opts.rate;
+  const int64_t start = now_us();
+  int64_t next_frame = start;
+  uint32_t frames_sent = 0;
+  int64_t next_progress = start + 5000000;
+  if (opts.source == Source::Passive) {
+    std::printf("Recording on-device latency of tagged frames, press Ctrl+C to stop\n");
+  }
+  std::signal(SIGINT, [](int) { stopping = 1; });
+
+  // Keep reading for a bit after the last frame, for it to come back
+  while (!stopping &&
+         (opts.source == Source::Passive || frames_sent < opts.frames ||
+          now_us() < next_frame + 500000)) {
+    const int64_t now = now_us();
+    if (output && frames_sent < opts.frames && now >= next_frame) {
+      // 0 means untagged to the board
+      sequence = sequence == 255 ? 1 : sequence + 1;
+      const auto frame = build_frame(opts, sequence, frames_sent % 2 == 0);
+      sent_at[sequence] = now_us();
+      if (hid_write(output, frame.data(), frame.size()) < 0) {
+        std::fprintf(stderr, "Failed to send frame: %ls\n", hid_error(output));
+        return 1;
+      }
+      frames_sent++;
+      next_frame += frame_interval;
+    }
+
+    samples.clear();
+    if (!read_samples(config, sync, samples, dropped)) {
+      std::fprintf(stderr, "Failed to read latency report, is the firmware up to date?\n");
+      return 1;
+    }
+
+    for (const auto &s : samples) {
+      if (s.path >= NUM_PATHS) {
+        continue;
+      }
+      auto &r = results[s.path];
+      r.device.push_back(s.latch_us);
+
+      if (!output) {
+        continue;
+      }
+      const int64_t received = sync.to_host(s.received_us);
+      const int64_t transfer = received - sent_at[s.sequence];
+      // Stale sequence numbers, e.g. from before we started
+      if (sent_at[s.sequence] == 0 || transfer < -sync.uncertainty() || transfer > 1000000) {
+        continue;
+      }
+      r.transfer.push_back(transfer);
+      r.total.push_back(transfer + s.latch_us);
+    }
+
+    if (opts.source == Source::Passive && now >= next_progress) {
+      next_progress += 5000000;
+      for (size_t p = 0; p < NUM_PATHS; p++) {
+        if (!results[p].device.empty()) {
+          std::printf("%s: %zu frames\n", path_names[p], results[p].device.size());
+        }
+      }
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(1000));
+  }
+
+  std::printf("Sent %u frames at %u Hz, clock sync within +/-%.2f ms\n",
+              frames_sent, opts.rate, sync.uncertainty() / 1000.0);
+  for (size_t p = 0; p < NUM_PATHS; p++) {
+    const auto &r = results[p];
+    if (r.device.empty()) {
+      continue;
+    }
+    std::printf("%s (%zu frames)\n", path_names[p], r.device.size());
+    print_distribution("host to received", r.transfer);
+    print_distribution("received to latch", r.device);
+    print_distribution("host to latch", r.total);
+  }
+  if (dropped > 0) {
+    std::printf("%u samples dropped on the board, try a lower --rate\n", dropped);
+  }
+  if (output && results[0].device.empty() && results[1].device.empty() && results[2].device.empty()) {
+    std::printf("No frames were measured, check the lighting mode matches --path\n");
+  }
+
+  if (output) {
+    hid_close(output);
+  }
+  hid_close(config);
+  hid_exit();
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include "frame.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Frame {
+  void Resampler::plan(const size_t source_leds) {
+    planned = source_leds;
+    start.resize(leds);
+    end.resize(leds);
+    reciprocal.resize(leds);
+    for (size_t i = 0; i < leds; i++) {
+      start[i] = i * source_leds / leds;
+      end[i] = (i + 1) * source_leds / leds;
+      // floor(sum / count) == sum * ceil(2^32 / count) >> 32 while sum * count < 2^32,
+      // which holds with sum <= 255 * count and far more source LEDs than a game has
+      const uint64_t count = end[i] - start[i];
+      reciprocal[i] = ((uint64_t{ 1 } << 32) + count - 1) / count;
+    }
+    for (auto &sum : sums) {
+      sum.resize(source_leds + 1);
+    }
+  }
+
+  void Resampler::run(const uint8_t* rgb, const size_t source_leds, uint8_t* out) {
+    if (source_leds <= leds) {
+      std::memcpy(out, rgb, source_leds * 3);
+      std::memset(out + source_leds * 3, 0, (leds - source_leds) * 3);
+      return;
+    }
+    if (planned != source_leds) {
+      plan(source_leds);
+    }
+
+    for (size_t c = 0; c < 3; c++) {
+      uint32_t* sum = sums[c].data();
+      sum[0] = 0;
+      for (size_t j = 0; j < source_leds; j++) {
+        sum[j + 1] = sum[j] + rgb[j * 3 + c];
+      }
+    }
+
+    for (size_t c = 0; c < 3; c++) {
+      const uint32_t* sum = sums[c].data();
+      for (size_t i = 0; i < leds; i++) {
+        out[i * 3 + c] = (sum[end[i]] - sum[start[i]]) * reciprocal[i] >> 32;
+      }
+    }
+  }
+
+  namespace {
+    bool same(const uint8_t* a, const uint8_t* b) {
+      return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    }
+
+    // As many (count, r, g, b) runs as fit into one segment, returns the LEDs covered
+    size_t encode_rle(const uint8_t* rgb, const size_t leds, const size_t offset, uint8_t* data) {
+      size_t i = offset;
+      size_t used = 0;
+      while (i < leds && used + 4 <= DATA_SIZE) {
+        size_t count = 1;
+        while (i + count < leds && count < 255 && same(rgb + (i + count) * 3, rgb + i * 3)) {
+          count++;
+        }
+        data[used] = count;
+        std::memcpy(data + used + 1, rgb + i * 3, 3);
+        used += 4;
+        i += count;
+      }
+      return i - offset;
+    }
+  }
+
+  size_t encode(const uint8_t* rgb, size_t leds, const uint8_t sequence, std::vector<report> &reports) {
+    leds = std::min(leds, MAX_LEDS);
+    size_t n = 0;
+    size_t offset = 0;
+    while (offset < leds) {
+      if (reports.size() <= n) {
+        reports.emplace_back();
+      }
+      report &r = reports[n++];
+      r.fill(0);
+      uint8_t* const data = r.data() + 1 + HEADER_SIZE;
+
+      uint8_t flags = 0;
+      size_t length = encode_rle(rgb, leds, offset, data);
+      const size_t raw_length = std::min(DATA_SIZE / 3, leds - offset);
+      if (length > raw_length) {
+        flags |= FLAG_RLE;
+      } else {
+        length = raw_length;
+        std::memset(data, 0, DATA_SIZE);
+        std::memcpy(data, rgb + offset * 3, length * 3);
+      }
+
+      if (offset + length >= leds) {
+        flags |= FLAG_COMMIT;
+      }
+
+      r[1] = PROTOCOL_VERSION;
+      r[2] = flags;
+      r[3] = sequence;
+      r[4] = offset;
+      r[5] = length;
+      offset += length;
+    }
+    return n;
+  }
+}
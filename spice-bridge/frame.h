@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Frame {
+  // Tape LED protocol, see fw/devices/iidx/iidx_tape_led.h
+  constexpr uint8_t PROTOCOL_VERSION = 1;
+  constexpr uint8_t FLAG_COMMIT = 1 << 0;
+  constexpr uint8_t FLAG_RLE = 1 << 1;
+  constexpr size_t REPORT_SIZE = 64;
+  constexpr size_t HEADER_SIZE = 5;
+  constexpr size_t DATA_SIZE = REPORT_SIZE - HEADER_SIZE;
+  // Segment offsets are a byte
+  constexpr size_t MAX_LEDS = 255;
+
+  // Leading 0 for no report ID, as hidapi wants
+  using report = std::array<uint8_t, 1 + REPORT_SIZE>;
+
+  // Averages the game's tape LEDs down to the bar's, like iidx_light_reader.py.
+  // Each output LED covers a run of source LEDs, summed from per-channel prefix
+  // sums and divided by a precomputed reciprocal, so a frame is two passes with
+  // no per-LED inner loops or divides
+  class Resampler {
+  public:
+    explicit Resampler(size_t leds) : leds(leds) {}
+
+    // rgb holds source_leds interleaved RGB triplets, out gets leds of them.
+    // Fewer source LEDs than the bar are copied as is and the rest are black
+    void run(const uint8_t* rgb, size_t source_leds, uint8_t* out);
+
+  private:
+    void plan(size_t source_leds);
+
+    const size_t leds;
+    size_t planned = 0;
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> end;
+    std::vector<uint64_t> reciprocal;
+    std::vector<uint32_t> sums[3];
+  };
+
+  // Splits a frame into segment reports, raw or RLE, whichever covers more
+  // LEDs. The last one commits the frame. Returns the number of reports used
+  size_t encode(const uint8_t* rgb, size_t leds, uint8_t sequence, std::vector<report> &reports);
+}
@@ -0,0 +1,313 @@
+#include "json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Json {
+  namespace {
+    constexpr int MAX_DEPTH = 32;
+
+    class Parser {
+    public:
+      Parser(const char* text, const size_t length) : p(text), end(text + length) {}
+
+      bool document(Value &out) {
+        if (!value(out, 0)) {
+          return false;
+        }
+        skip_space();
+        return p == end;
+      }
+
+    private:
+      void skip_space() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+          p++;
+        }
+      }
+
+      bool literal(const char* word) {
+        const size_t n = std::strlen(word);
+        if (static_cast<size_t>(end - p) < n || std::memcmp(p, word, n) != 0) {
+          return false;
+        }
+        p += n;
+        return true;
+      }
+
+      bool value(Value &out, const int depth) {
+        skip_space();
+        if (p == end || depth > MAX_DEPTH) {
+          return false;
+        }
+
+        switch (*p) {
+          case '{':
+            out.type = Value::Type::Object;
+            return object(out, depth);
+          case '[':
+            out.type = Value::Type::Array;
+            return array(out, depth);
+          case '"':
+            out.type = Value::Type::String;
+            return string(out.string);
+          case 't':
+            out.type = Value::Type::Bool;
+            out.boolean = true;
+            return literal("true");
+          case 'f':
+            out.type = Value::Type::Bool;
+            out.boolean = false;
+            return literal("false");
+          case 'n':
+            out.type = Value::Type::Null;
+            return literal("null");
+          default:
+            out.type = Value::Type::Number;
+            return number(out.number);
+        }
+      }
+
+      bool number(double &out) {
+        // strtod needs a terminated string, and numbers are short
+        char buffer[32];
+        size_t n = 0;
+        while (p + n < end && n < sizeof(buffer) - 1 && std::strchr("+-0123456789.eE", p[n])) {
+          n++;
+        }
+        if (n == 0) {
+          return false;
+        }
+        std::memcpy(buffer, p, n);
+        buffer[n] = '\0';
+
+        char* parsed;
+        out = std::strtod(buffer, &parsed);
+        if (parsed != buffer + n) {
+          return false;
+        }
+        p += n;
+        return true;
+      }
+
+      static void append_utf8(std::string &out, const unsigned code) {
+        if (code < 0x80) {
+          out += static_cast<char>(code);
+        } else if (code < 0x800) {
+          out += static_cast<char>(0xC0 | code >> 6);
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+          out += static_cast<char>(0xE0 | code >> 12);
+          out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+          out += static_cast<char>(0xF0 | code >> 18);
+          out += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+          out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+      }
+
+      bool hex4(unsigned &out) {
+        if (end - p < 4) {
+          return false;
+        }
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+          const char c = *p++;
+          out <<= 4;
+          if (c >= '0' && c <= '9') {
+            out |= c - '0';
+          } else if (c >= 'a' && c <= 'f') {
+            out |= c - 'a' + 10;
+          } else if (c >= 'A' && c <= 'F') {
+            out |= c - 'A' + 10;
+          } else {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      bool string(std::string &out) {
+        p++; // opening quote
+        out.clear();
+        while (p < end) {
+          const char c = *p++;
+          if (c == '"') {
+            return true;
+          }
+          if (c != '\\') {
+            out += c;
+            continue;
+          }
+
+          if (p == end) {
+            return false;
+          }
+          const char escape = *p++;
+          switch (escape) {
+            case '"':
+            case '\\':
+            case '/':
+              out += escape;
+              break;
+            case 'b':
+              out += '\b';
+              break;
+            case 'f':
+              out += '\f';
+              break;
+            case 'n':
+              out += '\n';
+              break;
+            case 'r':
+              out += '\r';
+              break;
+            case 't':
+              out += '\t';
+              break;
+            case 'u': {
+              unsigned code;
+              if (!hex4(code)) {
+                return false;
+              }
+              // Surrogate pair
+              if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                p += 2;
+                unsigned low;
+                if (!hex4(low)) {
+                  return false;
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+              }
+              append_utf8(out, code);
+              break;
+            }
+            default:
+              return false;
+          }
+        }
+        return false;
+      }
+
+      bool array(Value &out, const int depth) {
+        p++;
+        out.items.clear();
+        skip_space();
+        if (p < end && *p == ']') {
+          p++;
+          return true;
+        }
+
+        while (true) {
+          out.items.emplace_back();
+          if (!value(out.items.back(), depth + 1)) {
+            return false;
+          }
+          skip_space();
+          if (p == end) {
+            return false;
+          }
+          const char c = *p++;
+          if (c == ']') {
+            return true;
+          }
+          if (c != ',') {
+            return false;
+          }
+        }
+      }
+
+      bool object(Value &out, const int depth) {
+        p++;
+        out.members.clear();
+        skip_space();
+        if (p < end && *p == '}') {
+          p++;
+          return true;
+        }
+
+        while (true) {
+          skip_space();
+          if (p == end || *p != '"') {
+            return false;
+          }
+          out.members.emplace_back();
+          auto &member = out.members.back();
+          if (!string(member.first)) {
+            return false;
+          }
+          skip_space();
+          if (p == end || *p++ != ':') {
+            return false;
+          }
+          if (!value(member.second, depth + 1)) {
+            return false;
+          }
+          skip_space();
+          if (p == end) {
+            return false;
+          }
+          const char c = *p++;
+          if (c == '}') {
+            return true;
+          }
+          if (c != ',') {
+            return false;
+          }
+        }
+      }
+
+      const char* p;
+      const char* const end;
+    };
+  }
+
+  const Value* Value::get(const std::string &key) const {
+    for (const auto &member : members) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+
+  bool parse(const char* text, const size_t length, Value &out) {
+    return Parser(text, length).document(out);
+  }
+
+  std::string quote(const std::string &s) {
+    std::string out = "\"";
+    for (const char c : s) {
+      switch (c) {
+        case '"':
+          out += "\\\"";
+          break;
+        case '\\':
+          out += "\\\\";
+          break;
+        case '\n':
+          out += "\\n";
+          break;
+        case '\r':
+          out += "\\r";
+          break;
+        case '\t':
+          out += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char escape[7];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+          } else {
+            out += c;
+          }
+      }
+    }
+    out += '"';
+    return out;
+  }
+}
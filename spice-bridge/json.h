@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON for SpiceAPI messages. Numbers are doubles, which covers
+// everything SpiceAPI sends, and strings are kept as UTF-8
+namespace Json {
+  struct Value {
+    enum class Type {
+      Null,
+      Bool,
+      Number,
+      String,
+      Array,
+      Object
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<Value> items;
+    std::vector<std::pair<std::string, Value>> members;
+
+    // Object member, nullptr if missing
+    const Value* get(const std::string &key) const;
+  };
+
+  bool parse(const char* text, size_t length, Value &out);
+
+  // Quoted and escaped string literal
+  std::string quote(const std::string &s);
+}
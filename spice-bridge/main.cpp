@@ -0,0 +1,369 @@
+// Sends the game's tape LEDs from SpiceAPI to the light bar, see spiceapi/iidx_light_reader.py
+//
+//   ./spice-bridge --port 1337
+//   ./spice-bridge --port 1337 --password hunter2 --leds 32
+//   ./spice-bridge --port 1337 --no-device --duration 10
+//
+// Frames are paced by the board: after sending one, the bridge waits for the
+// board to report it latched through the Latched feature report (fw/latency.h)
+// before fetching the next, so it always sends the newest frame and never
+// queues stale ones. Unchanged frames aren't sent, apart from a keepalive.
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hidapi.h>
+
+#include "frame.h"
+#include "json.h"
+#include "net.h"
+#include "spice.h"
+
+namespace {
+  constexpr unsigned short BEEF_VID = 0x1CCF;
+  constexpr unsigned short BEEF_PID = 0x8048;
+  constexpr int CONFIG_INTERFACE = 3;
+  constexpr int LIGHTS_INTERFACE = 4;
+
+  // Latched feature report, the last tagged frame latched on each path, see
+  // fw/latency.h. Unlike the Latency report, reading it doesn't use up
+  // light-latency's samples
+  constexpr uint8_t REPORT_ID_LATCHED = 9;
+  constexpr size_t LATCHED_REPORT_SIZE = 3;
+  constexpr uint8_t PATH_BAR = 2;
+
+  // The board drops back to its own lighting after a second without reports
+  constexpr int64_t KEEPALIVE_US = 500000;
+  // Give up on a frame's acknowledgement after this long
+  constexpr int64_t ACK_TIMEOUT_US = 50000;
+  // Stop waiting for acknowledgements after this many go missing in a row,
+  // e.g. when the bar isn't in Tape LED mode
+  constexpr uint32_t MAX_MISSED_ACKS = 8;
+  constexpr int64_t RECONNECT_US = 1000000;
+  // Keeps the resampler's fixed point division exact
+  constexpr size_t MAX_SOURCE_LEDS = 4096;
+
+  struct options {
+    std::string host = "localhost";
+    uint16_t port = 0;
+    std::string password;
+    std::string name = "Cabinet Left";
+    uint8_t leds = 16;
+    uint32_t rate = 120;
+    uint32_t duration = 0;
+    bool device = true;
+  };
+
+  struct stats {
+    uint32_t polls = 0;
+    uint32_t sent = 0;
+    uint32_t unchanged = 0;
+    uint32_t acked = 0;
+    uint32_t missed_acks = 0;
+    std::vector<int64_t> request;
+    std::vector<int64_t> process;
+    std::vector<int64_t> write;
+    std::vector<int64_t> ack;
+  };
+
+  volatile std::sig_atomic_t stopping = 0;
+
+  int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  hid_device* open_interface(const int interface) {
+    hid_device* device = nullptr;
+    hid_device_info* devices = hid_enumerate(BEEF_VID, BEEF_PID);
+    for (auto d = devices; d; d = d->next) {
+      if (d->interface_number == interface) {
+        device = hid_open_path(d->path);
+        break;
+      }
+    }
+    hid_free_enumeration(devices);
+    return device;
+  }
+
+  // Reads the last bar frame the board latched. Returns false if the report
+  // couldn't be read, e.g. on firmware from before the Latched report
+  bool read_latched(hid_device* config, uint8_t &sequence) {
+    uint8_t report[1 + LATCHED_REPORT_SIZE] = { REPORT_ID_LATCHED };
+    if (hid_get_feature_report(config, report, sizeof(report)) < static_cast<int>(sizeof(report))) {
+      return false;
+    }
+
+    sequence = report[1 + PATH_BAR];
+    return true;
+  }
+
+  // Flattens the named tape LED array from a tapeled_get response into bytes
+  bool read_tape_leds(const Json::Value &data, const std::string &name, std::vector<uint8_t> &rgb) {
+    if (data.items.empty()) {
+      return false;
+    }
+    const Json::Value* leds = data.items[0].get(name);
+    if (!leds || leds->type != Json::Value::Type::Array) {
+      return false;
+    }
+
+    const size_t n = std::min(leds->items.size() / 3, MAX_SOURCE_LEDS) * 3;
+    rgb.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      rgb[i] = static_cast<int>(leds->items[i].number) & 0xFF;
+    }
+    return true;
+  }
+
+  int64_t percentile(std::vector<int64_t> values, const double p) {
+    std::sort(values.begin(), values.end());
+    const size_t i = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    return values[i];
+  }
+
+  void print_distribution(const char* name, const std::vector<int64_t> &values) {
+    if (values.empty()) {
+      return;
+    }
+    std::printf("  %-18s min %6.2f  p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms\n", name,
+                percentile(values, 0) / 1000.0, percentile(values, 0.5) / 1000.0,
+                percentile(values, 0.95) / 1000.0, percentile(values, 0.99) / 1000.0,
+                percentile(values, 1) / 1000.0);
+  }
+
+  void print_stats(const stats &s, const int64_t elapsed_us) {
+    const double seconds = elapsed_us / 1e6;
+    std::printf("%u polls (%.1f/s), %u frames sent (%.1f/s), %u unchanged frames skipped\n",
+                s.polls, s.polls / seconds, s.sent, s.sent / seconds, s.unchanged);
+    if (s.acked || s.missed_acks) {
+      std::printf("%u frames acknowledged, %u acknowledgements missed\n", s.acked, s.missed_acks);
+    }
+    print_distribution("SpiceAPI request", s.request);
+    print_distribution("resample + encode", s.process);
+    print_distribution("USB write", s.write);
+    print_distribution("send to latch", s.ack);
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: spice-bridge --port port [--host host] [--password password]\n"
+                 "                    [--name \"Cabinet Left\"] [--leds n] [--rate hz]\n"
+                 "                    [--no-device] [--duration s]\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      if (arg == "--no-device") {
+        opts.device = false;
+        continue;
+      }
+
+      if (i + 1 >= argc) {
+        return false;
+      }
+      const std::string value = argv[++i];
+      if (arg == "--port") {
+        opts.port = std::atoi(value.c_str());
+      } else if (arg == "--host") {
+        opts.host = value;
+      } else if (arg == "--password") {
+        opts.password = value;
+      } else if (arg == "--name") {
+        opts.name = value;
+      } else if (arg == "--leds") {
+        const int leds = std::atoi(value.c_str());
+        if (leds < 1 || leds > static_cast<int>(Frame::MAX_LEDS)) {
+          return false;
+        }
+        opts.leds = leds;
+      } else if (arg == "--rate") {
+        opts.rate = std::atoi(value.c_str());
+      } else if (arg == "--duration") {
+        opts.duration = std::atoi(value.c_str());
+      } else {
+        return false;
+      }
+    }
+    return opts.port > 0 && opts.rate > 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  if (!Net::init() || hid_init() != 0) {
+    std::fprintf(stderr, "Failed to start networking or hidapi\n");
+    return 1;
+  }
+
+  hid_device* output = nullptr;
+  hid_device* config = nullptr;
+  if (opts.device) {
+    output = open_interface(LIGHTS_INTERFACE);
+    if (!output) {
+      std::fprintf(stderr, "Beef Board not found\n");
+      return 1;
+    }
+    config = open_interface(CONFIG_INTERFACE);
+    std::printf("Connected to Beef Board\n");
+  }
+
+  Spice::Connection spice;
+  Json::Value data;
+  std::vector<uint8_t> source;
+  Frame::Resampler resampler(opts.leds);
+  std::vector<uint8_t> frame(opts.leds * 3);
+  std::vector<uint8_t> last_sent(opts.leds * 3);
+  std::vector<Frame::report> reports;
+  stats results;
+
+  uint8_t sequence = 0;
+  // Last bar frame the board latched, a change means it's latching frames again
+  uint8_t latched = 0;
+  bool ack_pacing = config != nullptr && read_latched(config, latched);
+  if (config && !ack_pacing) {
+    std::fprintf(stderr, "Can't read the Latched report, pacing frames at %u Hz instead\n", opts.rate);
+  }
+  // Carry on from the board's last frame, so an old one isn't taken as an acknowledgement
+  sequence = latched;
+  bool in_flight = false;
+  uint32_t missed_in_a_row = 0;
+  int64_t sent_at = 0;
+  int64_t next_connect = 0;
+
+  const int64_t frame_interval = 1000000 / opts.rate;
+  const int64_t start = now_us();
+  int64_t next_poll = start;
+
+  std::printf("Press Ctrl+C to exit\n");
+  std::signal(SIGINT, [](int) { stopping = 1; });
+  std::signal(SIGTERM, [](int) { stopping = 1; });
+
+  while (!stopping && (opts.duration == 0 || now_us() - start < opts.duration * 1000000LL)) {
+    int64_t now = now_us();
+
+    // Hold off until the board has latched the last frame
+    if (in_flight) {
+      if (!read_latched(config, latched)) {
+        std::fprintf(stderr, "Can't read the Latched report, pacing frames at %u Hz instead\n", opts.rate);
+        ack_pacing = in_flight = false;
+      } else if (latched == sequence) {
+        in_flight = false;
+        missed_in_a_row = 0;
+        results.acked++;
+        results.ack.push_back(now_us() - sent_at);
+      } else if (now - sent_at > ACK_TIMEOUT_US) {
+        in_flight = false;
+        results.missed_acks++;
+        if (++missed_in_a_row == MAX_MISSED_ACKS) {
+          std::printf("The board isn't acknowledging frames, is the bar in Tape LED mode?\n");
+        }
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        continue;
+      }
+    }
+
+    now = now_us();
+    if (now < next_poll) {
+      std::this_thread::sleep_for(std::chrono::microseconds(std::min<int64_t>(next_poll - now, 1000)));
+      continue;
+    }
+    // Don't try to catch up on polls missed while waiting on the board
+    next_poll = std::max(next_poll + frame_interval, now);
+
+    if (!spice.connected()) {
+      if (now < next_connect) {
+        continue;
+      }
+      if (!spice.connect(opts.host, opts.port, opts.password)) {
+        std::fprintf(stderr, "Error connecting to SpiceAPI (%s), retrying in a bit...\n", spice.error.c_str());
+        next_connect = now + RECONNECT_US;
+        continue;
+      }
+      std::printf("Connected to SpiceAPI at %s:%u\n", opts.host.c_str(), opts.port);
+    }
+
+    const int64_t request_start = now_us();
+    const bool got = spice.request("iidx", "tapeled_get", "[" + Json::quote(opts.name) + "]", data);
+    const int64_t process_start = now_us();
+    results.request.push_back(process_start - request_start);
+    results.polls++;
+    if (!got) {
+      std::fprintf(stderr, "SpiceAPI request failed: %s\n", spice.error.c_str());
+      next_connect = process_start + RECONNECT_US;
+      if (spice.connected()) {
+        // The game answered but doesn't know the name, waiting won't help
+        break;
+      }
+      continue;
+    }
+    if (!read_tape_leds(data, opts.name, source)) {
+      std::fprintf(stderr, "Unknown tape LED device '%s'\n", opts.name.c_str());
+      break;
+    }
+
+    resampler.run(source.data(), source.size() / 3, frame.data());
+    const bool changed = frame != last_sent;
+    if (!changed && process_start - sent_at < KEEPALIVE_US) {
+      results.unchanged++;
+      continue;
+    }
+
+    // 0 means untagged to the board
+    sequence = sequence == 255 ? 1 : sequence + 1;
+    const size_t n = Frame::encode(frame.data(), opts.leds, sequence, reports);
+    const int64_t write_start = now_us();
+    results.process.push_back(write_start - process_start);
+
+    if (output) {
+      bool ok = true;
+      for (size_t i = 0; i < n && ok; i++) {
+        ok = hid_write(output, reports[i].data(), reports[i].size()) == static_cast<int>(reports[i].size());
+      }
+      if (!ok) {
+        std::fprintf(stderr, "Failed to send data to Beef Board: %ls\n", hid_error(output));
+        break;
+      }
+      results.write.push_back(now_us() - write_start);
+    }
+
+    sent_at = write_start;
+    last_sent.swap(frame);
+    results.sent++;
+    in_flight = ack_pacing && missed_in_a_row < MAX_MISSED_ACKS;
+    // Keep listening for acknowledgements after giving up on them, in case the mode changes
+    if (ack_pacing && !in_flight) {
+      const uint8_t before = latched;
+      if (read_latched(config, latched) && latched != before) {
+        missed_in_a_row = 0;
+      }
+    }
+  }
+
+  std::printf("\n");
+  print_stats(results, now_us() - start);
+
+  spice.close();
+  if (output) {
+    hid_close(output);
+  }
+  if (config) {
+    hid_close(config);
+  }
+  hid_exit();
+  return 0;
+}
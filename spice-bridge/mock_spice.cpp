@@ -0,0 +1,240 @@
+// Stands in for a game running spice2x's SpiceAPI server, serving animated
+// tape LEDs so the bridge and iidx_light_reader.py can be tested and
+// benchmarked without the game
+//
+//   ./mock-spice --port 1337
+//   ./mock-spice --port 1337 --password hunter2 --leds 57 --fps 60
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "net.h"
+#include "spice.h"
+
+namespace {
+  const char* const tape_names[] = {
+    "Stage Left", "Stage Right", "Cabinet Left", "Cabinet Right",
+    "Control Panel Under", "Title Left", "Title Right"
+  };
+
+  struct options {
+    uint16_t port = 1337;
+    std::string password;
+    uint32_t leds = 57;
+    uint32_t fps = 60;
+    uint32_t delay_us = 0;
+  };
+
+  options opts;
+  std::atomic<uint32_t> requests{ 0 };
+
+  int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // A hue gradient that scrolls one LED per game frame, different on every tape
+  std::string tape_leds(const size_t tape, const uint64_t frame) {
+    std::string out = "[";
+    for (uint32_t i = 0; i < opts.leds; i++) {
+      const uint8_t hue = (i + frame) * 256 / opts.leds + tape * 36;
+      const uint8_t sector = hue / 43;
+      const uint8_t rise = (hue % 43) * 6;
+      uint8_t rgb[3];
+      switch (sector) {
+        case 0: rgb[0] = 255; rgb[1] = rise; rgb[2] = 0; break;
+        case 1: rgb[0] = 255 - rise; rgb[1] = 255; rgb[2] = 0; break;
+        case 2: rgb[0] = 0; rgb[1] = 255; rgb[2] = rise; break;
+        case 3: rgb[0] = 0; rgb[1] = 255 - rise; rgb[2] = 255; break;
+        case 4: rgb[0] = rise; rgb[1] = 0; rgb[2] = 255; break;
+        default: rgb[0] = 255; rgb[1] = 0; rgb[2] = 255 - rise; break;
+      }
+      for (const uint8_t c : rgb) {
+        out += std::to_string(c);
+        out += ',';
+      }
+    }
+    if (out.back() == ',') {
+      out.back() = ']';
+    } else {
+      out += ']';
+    }
+    return out;
+  }
+
+  std::string random_password() {
+    static const char hex[] = "0123456789abcdef";
+    std::random_device random;
+    std::string password;
+    for (int i = 0; i < 32; i++) {
+      password += hex[random() & 0xF];
+    }
+    return password;
+  }
+
+  // Fills data with the response's data array, or error with why there isn't one
+  void handle(const Json::Value &request, const int64_t start_us, std::string &data, std::string &error,
+              std::string &new_password) {
+    const Json::Value* module = request.get("module");
+    const Json::Value* function = request.get("function");
+    const Json::Value* params = request.get("params");
+    const std::string m = module ? module->string : "";
+    const std::string f = function ? function->string : "";
+
+    if (m == "control" && f == "session_refresh") {
+      new_password = random_password();
+      data = "[" + Json::quote(new_password) + "]";
+      return;
+    }
+
+    if (m != "iidx" || f != "tapeled_get") {
+      error = "Unknown function: " + m + "." + f;
+      return;
+    }
+
+    const uint64_t frame = (now_us() - start_us) * opts.fps / 1000000;
+    data = "[{";
+    bool first = true;
+    for (size_t tape = 0; tape < sizeof(tape_names) / sizeof(tape_names[0]); tape++) {
+      bool wanted = !params || params->items.empty();
+      if (params) {
+        for (const auto &name : params->items) {
+          wanted |= name.string == tape_names[tape];
+        }
+      }
+      if (!wanted) {
+        continue;
+      }
+      if (!first) {
+        data += ',';
+      }
+      first = false;
+      data += Json::quote(tape_names[tape]) + ":" + tape_leds(tape, frame);
+    }
+    data += "}]";
+  }
+
+  void serve(const Net::socket_t client, const int64_t start_us) {
+    const bool encrypted = !opts.password.empty();
+    Spice::Rc4 cipher(opts.password);
+    Spice::MessageReader reader;
+    std::string message;
+
+    while (reader.next(client, encrypted ? &cipher : nullptr, message)) {
+      Json::Value request;
+      std::string data = "[]";
+      std::string error;
+      std::string new_password;
+      uint64_t id = 0;
+      if (!Json::parse(message.data(), message.size(), request)) {
+        error = "Invalid request";
+      } else {
+        const Json::Value* request_id = request.get("id");
+        id = request_id ? static_cast<uint64_t>(request_id->number) : 0;
+        handle(request, start_us, data, error, new_password);
+      }
+
+      if (opts.delay_us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(opts.delay_us));
+      }
+
+      char head[48];
+      std::snprintf(head, sizeof(head), "{\"id\":%" PRIu64 ",\"errors\":[", id);
+      std::string response = head;
+      if (!error.empty()) {
+        response += Json::quote(error);
+      }
+      response += "],\"data\":" + data + "}";
+      response += '\0';
+      if (encrypted) {
+        cipher.crypt(reinterpret_cast<uint8_t*>(&response[0]), response.size());
+      }
+      if (!Net::send_all(client, response.data(), response.size())) {
+        break;
+      }
+      // The new key takes over after the response that carried it
+      if (encrypted && !new_password.empty()) {
+        cipher = Spice::Rc4(new_password);
+      }
+      requests++;
+    }
+    Net::close(client);
+    std::printf("Client disconnected\n");
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: mock-spice [--port port] [--password password] [--leds n] [--fps fps]\n"
+                 "                  [--delay us]\n");
+  }
+
+  bool parse_arguments(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const std::string arg = argv[i];
+      const char* value = argv[i + 1];
+      if (arg == "--port") {
+        opts.port = std::atoi(value);
+      } else if (arg == "--password") {
+        opts.password = value;
+      } else if (arg == "--leds") {
+        opts.leds = std::atoi(value);
+      } else if (arg == "--fps") {
+        opts.fps = std::atoi(value);
+      } else if (arg == "--delay") {
+        opts.delay_us = std::atoi(value);
+      } else {
+        return false;
+      }
+    }
+    return argc % 2 == 1 && opts.port > 0 && opts.leds > 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  if (!parse_arguments(argc, argv)) {
+    usage();
+    return 1;
+  }
+
+  if (!Net::init()) {
+    std::fprintf(stderr, "Failed to start networking\n");
+    return 1;
+  }
+  const Net::socket_t listener = Net::listen(opts.port);
+  if (listener == Net::INVALID) {
+    std::fprintf(stderr, "Can't listen on port %u\n", opts.port);
+    return 1;
+  }
+  std::printf("Serving %u tape LEDs at %u fps on port %u\n", opts.leds, opts.fps, opts.port);
+
+  const int64_t start = now_us();
+  std::thread([]() {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::seconds(5));
+      const uint32_t n = requests.exchange(0);
+      if (n) {
+        std::printf("%.1f requests/s\n", n / 5.0);
+        std::fflush(stdout);
+      }
+    }
+  }).detach();
+
+  while (true) {
+    const Net::socket_t client = Net::accept(listener);
+    if (client == Net::INVALID) {
+      continue;
+    }
+    std::printf("Client connected\n");
+    std::fflush(stdout);
+    std::thread(serve, client, start).detach();
+  }
+}
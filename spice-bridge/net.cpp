@@ -0,0 +1,144 @@
+#include "net.h"
+
+#include <csignal>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+namespace Net {
+#ifdef _WIN32
+  const socket_t INVALID = INVALID_SOCKET;
+#else
+  const socket_t INVALID = -1;
+#endif
+
+  namespace {
+    // Requests are tiny and answered right away, Nagle would hold them back a whole RTT
+    void set_nodelay(const socket_t s) {
+      const int on = 1;
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+    }
+  }
+
+  bool init() {
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    // A dropped connection should fail the send, not kill the process
+    std::signal(SIGPIPE, SIG_IGN);
+    return true;
+#endif
+  }
+
+  void close(const socket_t s) {
+    if (s == INVALID) {
+      return;
+    }
+#ifdef _WIN32
+    closesocket(s);
+#else
+    ::close(s);
+#endif
+  }
+
+  socket_t connect(const char* host, const uint16_t port) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[6];
+    std::snprintf(service, sizeof(service), "%u", port);
+
+    addrinfo* addresses;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) {
+      return INVALID;
+    }
+
+    socket_t s = INVALID;
+    for (auto a = addresses; a; a = a->ai_next) {
+      s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (s == INVALID) {
+        continue;
+      }
+      if (::connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0) {
+        break;
+      }
+      close(s);
+      s = INVALID;
+    }
+    freeaddrinfo(addresses);
+
+    if (s != INVALID) {
+      set_nodelay(s);
+    }
+    return s;
+  }
+
+  socket_t listen(const uint16_t port) {
+    const socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s == INVALID) {
+      return INVALID;
+    }
+
+    const int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(s, 4) != 0) {
+      close(s);
+      return INVALID;
+    }
+    return s;
+  }
+
+  socket_t accept(const socket_t listener) {
+    const socket_t s = ::accept(listener, nullptr, nullptr);
+    if (s != INVALID) {
+      set_nodelay(s);
+    }
+    return s;
+  }
+
+  bool set_timeout(const socket_t s, const uint32_t timeout_ms) {
+#ifdef _WIN32
+    const DWORD timeout = timeout_ms;
+#else
+    timeval timeout{};
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = timeout_ms % 1000 * 1000;
+#endif
+    return setsockopt(s, SOL_SOCKET, SO_RCVTIMEO,
+                      reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+  }
+
+  bool send_all(const socket_t s, const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+      const auto n = send(s, p, static_cast<int>(length), 0);
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+      length -= n;
+    }
+    return true;
+  }
+
+  int receive(const socket_t s, void* data, const size_t length) {
+    return static_cast<int>(recv(s, static_cast<char*>(data), static_cast<int>(length), 0));
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Just enough TCP for talking to SpiceAPI, on Windows and everywhere else
+namespace Net {
+#ifdef _WIN32
+  using socket_t = uintptr_t;
+#else
+  using socket_t = int;
+#endif
+  extern const socket_t INVALID;
+
+  bool init();
+  void close(socket_t s);
+
+  socket_t connect(const char* host, uint16_t port);
+  // Listens on all interfaces for the mock server
+  socket_t listen(uint16_t port);
+  socket_t accept(socket_t listener);
+
+  // Fails if nothing arrives within timeout_ms
+  bool set_timeout(socket_t s, uint32_t timeout_ms);
+
+  bool send_all(socket_t s, const void* data, size_t length);
+  // Returns the bytes received, 0 if the peer closed or < 0 on error
+  int receive(socket_t s, void* data, size_t length);
+}
@@ -0,0 +1,143 @@
+#include "spice.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+
+namespace Spice {
+  namespace {
+    constexpr uint32_t TIMEOUT_MS = 1000;
+  }
+
+  Rc4::Rc4(const std::string &key) {
+    for (int n = 0; n < 256; n++) {
+      s[n] = n;
+    }
+    if (key.empty()) {
+      return;
+    }
+
+    uint8_t k = 0;
+    for (int n = 0; n < 256; n++) {
+      k += s[n] + static_cast<uint8_t>(key[n % key.size()]);
+      std::swap(s[n], s[k]);
+    }
+  }
+
+  void Rc4::crypt(uint8_t* data, const size_t length) {
+    for (size_t n = 0; n < length; n++) {
+      i++;
+      j += s[i];
+      std::swap(s[i], s[j]);
+      data[n] ^= s[static_cast<uint8_t>(s[i] + s[j])];
+    }
+  }
+
+  bool MessageReader::next(const Net::socket_t s, Rc4* cipher, std::string &message) {
+    while (true) {
+      const auto end = buffer.find('\0');
+      if (end != std::string::npos) {
+        message.assign(buffer, 0, end);
+        buffer.erase(0, end + 1);
+        return true;
+      }
+
+      char chunk[4096];
+      const int n = Net::receive(s, chunk, sizeof(chunk));
+      if (n <= 0) {
+        return false;
+      }
+      if (cipher) {
+        cipher->crypt(reinterpret_cast<uint8_t*>(chunk), n);
+      }
+      buffer.append(chunk, n);
+    }
+  }
+
+  bool Connection::connect(const std::string &host, const uint16_t port, const std::string &password) {
+    close();
+    s = Net::connect(host.c_str(), port);
+    if (s == Net::INVALID) {
+      error = "can't connect to " + host + ":" + std::to_string(port);
+      return false;
+    }
+    Net::set_timeout(s, TIMEOUT_MS);
+
+    encrypted = !password.empty();
+    cipher = Rc4(password);
+    if (!encrypted) {
+      return true;
+    }
+
+    // The server hands out a fresh key for the rest of the session
+    Json::Value data;
+    if (!request("control", "session_refresh", "[]", data)) {
+      close();
+      return false;
+    }
+    if (data.items.empty() || data.items[0].type != Json::Value::Type::String) {
+      error = "bad session_refresh response";
+      close();
+      return false;
+    }
+    cipher = Rc4(data.items[0].string);
+    return true;
+  }
+
+  void Connection::close() {
+    Net::close(s);
+    s = Net::INVALID;
+    reader.reset();
+  }
+
+  bool Connection::send(const std::string &message) {
+    request_buffer.assign(message);
+    request_buffer += '\0';
+    if (encrypted) {
+      cipher.crypt(reinterpret_cast<uint8_t*>(&request_buffer[0]), request_buffer.size());
+    }
+    return Net::send_all(s, request_buffer.data(), request_buffer.size());
+  }
+
+  bool Connection::request(const char* module, const char* function, const std::string &params,
+                           Json::Value &out) {
+    if (!connected()) {
+      error = "not connected";
+      return false;
+    }
+
+    const uint64_t id = next_id++;
+    char head[160];
+    std::snprintf(head, sizeof(head), "{\"id\":%" PRIu64 ",\"module\":\"%s\",\"function\":\"%s\",\"params\":",
+                  id, module, function);
+    if (!send(head + params + "}") || !reader.next(s, encrypted ? &cipher : nullptr, response)) {
+      error = "connection lost";
+      close();
+      return false;
+    }
+
+    Json::Value message;
+    const Json::Value* response_id;
+    if (!Json::parse(response.data(), response.size(), message) ||
+        !(response_id = message.get("id")) || response_id->number != id) {
+      error = "bad response, is the password right?";
+      close();
+      return false;
+    }
+
+    const Json::Value* errors = message.get("errors");
+    if (errors && !errors->items.empty()) {
+      error = errors->items[0].type == Json::Value::Type::String ? errors->items[0].string : "API error";
+      return false;
+    }
+
+    for (auto &member : message.members) {
+      if (member.first == "data" && member.second.type == Json::Value::Type::Array) {
+        out = std::move(member.second);
+        return true;
+      }
+    }
+    error = "response has no data";
+    return false;
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "net.h"
+
+// SpiceAPI wire protocol: JSON requests and responses, each terminated by a
+// null byte. With a password set, everything is RC4 encrypted with a single
+// keystream per connection, requests and responses alike
+namespace Spice {
+  class Rc4 {
+  public:
+    explicit Rc4(const std::string &key = "");
+    void crypt(uint8_t* data, size_t length);
+
+  private:
+    uint8_t s[256];
+    uint8_t i = 0;
+    uint8_t j = 0;
+  };
+
+  // Reads null terminated messages off a socket, decrypting as it goes
+  class MessageReader {
+  public:
+    // False if the connection closed or timed out
+    bool next(Net::socket_t s, Rc4* cipher, std::string &message);
+    void reset() {
+      buffer.clear();
+    }
+
+  private:
+    std::string buffer;
+  };
+
+  // One connection that's kept open across requests, rather than a new one per frame
+  class Connection {
+  public:
+    ~Connection() {
+      close();
+    }
+
+    // Refreshes the session key when there's a password, like the reference client
+    bool connect(const std::string &host, uint16_t port, const std::string &password);
+    void close();
+    bool connected() const {
+      return s != Net::INVALID;
+    }
+
+    // params is a JSON array. On success, out holds the response's data array.
+    // Connection errors close the connection, API errors leave it open
+    bool request(const char* module, const char* function, const std::string &params,
+                 Json::Value &out);
+
+    std::string error;
+
+  private:
+    bool send(const std::string &message);
+
+    Net::socket_t s = Net::INVALID;
+    bool encrypted = false;
+    Rc4 cipher;
+    MessageReader reader;
+    uint64_t next_id = 1;
+    std::string request_buffer;
+    std::string response;
+  };
+}
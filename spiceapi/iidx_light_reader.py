@@ -3,9 +3,11 @@
 IIDX Light State Reader with USB HID Output
 
 This script reads the IIDX tape LEDs from spiceapi,
-then sends them to a USB HID device in a specific format:
+then sends them to a USB HID device using the segmented lights protocol:
 
-- Tape LEDs: 48 bytes (16 RGB LEDs)
+- Each 64 byte report carries a 5 byte header (version, flags, sequence, offset, length)
+  followed by either raw RGB data or RLE (count, r, g, b) runs
+- The last segment of a frame sets the commit flag so the board presents the whole frame at once
 """
 
 import sys
@@ -33,6 +35,14 @@ DEFAULT_PID = 0x8048
 OUTPUT_INTERFACE = 4
 NUM_OF_LEDS = 16
 
+# Lights protocol, see fw/devices/iidx/iidx_tape_led.h
+PROTOCOL_VERSION = 1
+FLAG_COMMIT = 1 << 0
+FLAG_RLE = 1 << 1
+REPORT_SIZE = 64
+HEADER_SIZE = 5
+DATA_SIZE = REPORT_SIZE - HEADER_SIZE
+
 def connect_to_spiceapi(port, password):
     """Connect to the spiceapi server.
 
@@ -95,27 +105,27 @@ def read_tape_leds(conn, name):
     res = iidx_tapeled_get(conn, name)
     return res[0].get(name)
 
-def format_tape_leds(tape_leds):
-    """Format tape LED data into 48 integers (16 RGB LEDs).
+def format_tape_leds(tape_leds, num_of_leds=NUM_OF_LEDS):
+    """Format tape LED data into num_of_leds RGB LEDs.
 
     Args:
         tape_leds (dict): Tape LED states from iidx_tapeled_get
+        num_of_leds (int): Number of LEDs on the light bar
 
     Returns:
-        list: 48 integers representing 16 RGB LEDs
+        list: num_of_leds * 3 integers representing the RGB LEDs
     """
-    # Create 16 RGB LEDs with values from tape LEDs
     result = []
 
     # If we have no LED data, return all zeros
     if not tape_leds:
-        return [0, 0, 0] * NUM_OF_LEDS
+        return [0, 0, 0] * num_of_leds
 
     # Calculate how many RGB triplets we have
     total_triplets = len(tape_leds) // 3
 
-    # If we have 16 or fewer LEDs, just use them directly
-    if total_triplets <= NUM_OF_LEDS:
+    # If we have as many or fewer LEDs than the bar, just use them directly
+    if total_triplets <= num_of_leds:
         for i in range(total_triplets):
             index = i * 3
             r = int(tape_leds[index]) & 0xFF
@@ -124,15 +134,15 @@ def format_tape_leds(tape_leds):
             result.extend([r, g, b])
 
         # Fill the rest with zeros if needed
-        padding = NUM_OF_LEDS - total_triplets
+        padding = num_of_leds - total_triplets
         result.extend([0, 0, 0] * padding)
     else:
-        # Downscale: We need to fit more than 16 LEDs into 16 output slots
-        # Distribute the input LEDs evenly across the 16 output LEDs
-        for i in range(NUM_OF_LEDS):
+        # Downscale: We need to fit more LEDs than the bar has
+        # Distribute the input LEDs evenly across the output LEDs
+        for i in range(num_of_leds):
             # Calculate the range of source LEDs that map to this output LED
-            start_idx = int((i * total_triplets) / NUM_OF_LEDS)
-            end_idx = int(((i + 1) * total_triplets) / NUM_OF_LEDS)
+            start_idx = int((i * total_triplets) / num_of_leds)
+            end_idx = int(((i + 1) * total_triplets) / num_of_leds)
 
             # Average the RGB values for all LEDs in this range
             r_sum = g_sum = b_sum = 0
@@ -153,28 +163,84 @@ def format_tape_leds(tape_leds):
 
     return result
 
-def send_to_usb_device(device: hid.device, data):
-    """Send data to the USB HID device.
+def encode_rle(leds, offset):
+    """RLE encode as many LEDs as fit into one segment, starting at offset.
+
+    Args:
+        leds (list): RGB triplets
+        offset (int): First LED to encode
+
+    Returns:
+        tuple: (encoded data, number of LEDs covered)
+    """
+    data = []
+    i = offset
+    while i < len(leds) and len(data) + 4 <= DATA_SIZE:
+        count = 1
+        while i + count < len(leds) and count < 255 and leds[i + count] == leds[i]:
+            count += 1
+        data.extend([count, *leds[i]])
+        i += count
+    return data, i - offset
+
+def encode_segments(data, sequence):
+    """Split a frame into segment reports, picking raw or RLE per segment.
+
+    Args:
+        data (list): Frame as a flat list of RGB values
+        sequence (int): Frame sequence number
+
+    Returns:
+        list: Reports to send, the last one commits the frame
+    """
+    leds = [tuple(data[i:i + 3]) for i in range(0, len(data), 3)]
+    reports = []
+    offset = 0
+    while offset < len(leds):
+        flags = 0
+        rle_data, rle_length = encode_rle(leds, offset)
+        raw_length = min(DATA_SIZE // 3, len(leds) - offset)
+        if rle_length > raw_length:
+            flags |= FLAG_RLE
+            length = rle_length
+            segment_data = rle_data
+        else:
+            length = raw_length
+            segment_data = [value for led in leds[offset:offset + length] for value in led]
+
+        if offset + length >= len(leds):
+            flags |= FLAG_COMMIT
+
+        report = [PROTOCOL_VERSION, flags, sequence & 0xFF, offset, length] + segment_data
+        report.extend([0] * (REPORT_SIZE - len(report)))
+        reports.append(report)
+        offset += length
+    return reports
+
+def send_to_usb_device(device: hid.device, data, sequence):
+    """Send a frame to the USB HID device.
 
     Args:
         device: HID device object
         data (list): List of integers to send
+        sequence (int): Frame sequence number
 
     Returns:
         bool: True if successful, False otherwise
     """
     try:
-        # In HID reports, the first byte is typically the report ID
-        # For devices that don't use report IDs, use 0
-        report_data = [0] + data
+        for report in encode_segments(data, sequence):
+            # In HID reports, the first byte is typically the report ID
+            # For devices that don't use report IDs, use 0
+            report_data = [0] + report
 
-        # Write the data to the device
-        bytes_written = device.write(report_data)
+            # Write the data to the device
+            bytes_written = device.write(report_data)
 
-        # Check if all data was written
-        if bytes_written != len(report_data):
-            print(f"Warning: Only {bytes_written} of {len(report_data)} bytes were written")
-            return False
+            # Check if all data was written
+            if bytes_written != len(report_data):
+                print(f"Warning: Only {bytes_written} of {len(report_data)} bytes were written")
+                return False
 
         return True
     except Exception as e:
@@ -192,6 +258,7 @@ def parse_arguments():
     parser.add_argument('--port', type=int, required=True, help='SpiceAPI server port')
     parser.add_argument('--password', default='', help='SpiceAPI server password')
     parser.add_argument('--name', default='Cabinet Left', help='Tape LED device name to choose for RGB data')
+    parser.add_argument('--leds', type=int, default=NUM_OF_LEDS, help='Number of LEDs to send, up to LIGHT_BAR_LEDS in the firmware build. Fewer LEDs get upscaled by the board')
 
     return parser.parse_args()
 
@@ -209,6 +276,7 @@ def main():
         sys.exit(1)
 
     conn = None
+    sequence = 0
 
     try:
         print("Press Ctrl+C to exit")
@@ -229,12 +297,13 @@ def main():
                 raise ValueError(f"Unknown tape LED device '{args.name}'")
 
             # Format data for USB HID output
-            tape_led_values = format_tape_leds(tape_leds)
+            tape_led_values = format_tape_leds(tape_leds, args.leds)
 
             # Send to USB device
-            success = send_to_usb_device(device, tape_led_values)
+            success = send_to_usb_device(device, tape_led_values, sequence)
             if not success:
                 print("Failed to send data to Beef Board")
+            sequence += 1
 
             # Wait before next update
             time.sleep(1 / 120)
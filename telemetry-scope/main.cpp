@@ -0,0 +1,387 @@
+// Streams live input telemetry from firmware built with TELEMETRY=1, see
+// fw/telemetry.h. Prints a line of statistics every second, optionally records
+// every report to a file, and sums it all up at the end
+//
+//   ./telemetry-scope
+//   ./telemetry-scope --output session.tlm --seconds 60
+//   ./telemetry-scope --input session.tlm
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include <hidapi.h>
+
+namespace {
+  constexpr unsigned short BEEF_VID = 0x1CCF;
+  constexpr unsigned short IIDX_PID = 0x8048;
+  constexpr unsigned short SDVX_PID = 0x101C;
+
+  constexpr int TELEMETRY_INTERFACE = 5;
+  constexpr size_t REPORT_SIZE = 20;
+  // Recordings from before the lamp interrupt time was added
+  constexpr size_t OLD_REPORT_SIZE = 19;
+
+  // Recordings are this, the report size as a byte, then each report
+  // prefixed with the host's receive time in µs, all little endian
+  const char FILE_MAGIC[8] = { 'B', 'E', 'E', 'F', 'T', 'L', 'M', '1' };
+
+  constexpr uint16_t BUTTON_TT_NEG = 1 << 11;
+  constexpr uint16_t BUTTON_TT_POS = 1 << 12;
+  constexpr uint8_t MAX_BUTTONS = 11;
+  // Timer3 runs at 2 MHz, 8 CPU cycles a tick
+  constexpr double LAMP_TICK_US = 0.5;
+  // Digital turntable reversals quicker than this are counted as flips
+  constexpr uint16_t FLIP_MS = 50;
+
+  struct options {
+    bool sdvx = false;
+    std::string input;
+    std::string output;
+    uint32_t seconds = 0;
+  };
+
+  struct report {
+    int64_t host_us;
+    uint8_t sequence;
+    uint16_t time_ms;
+    uint16_t raw_buttons;
+    uint16_t raw_toggled;
+    uint16_t buttons;
+    uint8_t tt_x;
+    int8_t tt_delta;
+    int8_t tt_direction;
+    uint8_t encoders;
+    uint8_t analog_x;
+    uint8_t analog_y;
+    uint16_t loops;
+    uint16_t max_loop_us;
+    uint8_t max_lamp_isr_ticks;
+  };
+
+  // Counted per report, which is per millisecond while the host keeps up
+  struct stats {
+    uint32_t reports = 0;
+    uint32_t missed = 0;
+    uint64_t loops = 0;
+    uint16_t max_loop_us = 0;
+    uint8_t max_lamp_isr_ticks = 0;
+    uint32_t raw_toggles[MAX_BUTTONS] = {};
+    uint32_t presses[MAX_BUTTONS] = {};
+    uint32_t moving = 0;
+    uint32_t max_speed = 0;
+    // ±1 step while the digital turntable is stopped, movement the deadzone swallowed
+    uint32_t wobble = 0;
+    uint32_t reversals = 0;
+    uint32_t flips = 0;
+    uint8_t analog_min[2] = { 255, 255 };
+    uint8_t analog_max[2] = { 0, 0 };
+  };
+
+  class Scope {
+  public:
+    explicit Scope(const bool sdvx) : buttons(sdvx ? 9 : MAX_BUTTONS), sdvx(sdvx) {}
+
+    void add(const report &r) {
+      add(r, second);
+      add(r, total);
+      turntable(r);
+      last = r;
+      has_last = true;
+    }
+
+    // Prints and clears the last second's statistics
+    void print_second() {
+      const stats &s = second;
+      if (s.reports == 0) {
+        std::printf("No reports\n");
+        return;
+      }
+      std::printf("%4u reports, %u missed, loop avg %5.1f max %5u us",
+                  s.reports, s.missed, 1000.0 * s.reports / std::max<uint64_t>(s.loops, 1),
+                  s.max_loop_us);
+      if (!sdvx) {
+        std::printf(" | TT %3u max %2u/ms wobble %u flips %u", last.tt_x, s.max_speed, s.wobble, s.flips);
+      } else {
+        std::printf(" | knobs %3u %3u", last.analog_x, last.analog_y);
+      }
+      std::printf(" | raw");
+      for (uint8_t i = 0; i < buttons; i++) {
+        std::printf("%c", last.raw_buttons & (1 << i) ? '#' : '.');
+      }
+      std::printf("\n");
+      std::fflush(stdout);
+      second = stats();
+    }
+
+    void print_summary() const {
+      const stats &s = total;
+      if (s.reports == 0) {
+        std::printf("No telemetry received\n");
+        return;
+      }
+      std::printf("\n%u reports, %u missed (%.2f%%)\n", s.reports, s.missed,
+                  100.0 * s.missed / (s.reports + s.missed));
+      std::printf("Main loop: %.1f passes per report, longest pass %u us\n",
+                  static_cast<double>(s.loops) / s.reports, s.max_loop_us);
+      std::printf("Button lamp interrupt: longest %.1f us\n", s.max_lamp_isr_ticks * LAMP_TICK_US);
+
+      std::printf("Button  raw changes  presses  bounces per press\n");
+      for (uint8_t i = 0; i < buttons; i++) {
+        if (s.raw_toggles[i] == 0) {
+          continue;
+        }
+        // A clean press and release is two raw changes
+        const double bounces = s.presses[i] ?
+          std::max(0.0, (s.raw_toggles[i] - 2.0 * s.presses[i]) / s.presses[i]) : 0;
+        std::printf("B%-2u     %11u  %7u  %17.2f\n", i + 1, s.raw_toggles[i], s.presses[i], bounces);
+      }
+
+      if (!sdvx) {
+        std::printf("Turntable: moving %.1f s, fastest %u per ms, %u reversals, %u flips under %u ms,\n"
+                    "           %u ms of wobble while stopped\n",
+                    s.moving / 1000.0, s.max_speed, s.reversals, s.flips,
+                    FLIP_MS, s.wobble);
+      } else {
+        std::printf("Knobs: x %u-%u, y %u-%u\n",
+                    s.analog_min[0], s.analog_max[0], s.analog_min[1], s.analog_max[1]);
+      }
+    }
+
+  private:
+    void add(const report &r, stats &s) {
+      s.reports++;
+      if (has_last) {
+        s.missed += static_cast<uint8_t>(r.sequence - last.sequence - 1);
+      }
+      s.loops += r.loops;
+      s.max_loop_us = std::max(s.max_loop_us, r.max_loop_us);
+      s.max_lamp_isr_ticks = std::max(s.max_lamp_isr_ticks, r.max_lamp_isr_ticks);
+
+      for (uint8_t i = 0; i < buttons; i++) {
+        const uint16_t bit = 1 << i;
+        // At least one change, a report can't tell how many
+        s.raw_toggles[i] += (r.raw_toggled & bit) != 0;
+        s.presses[i] += has_last && (r.buttons & bit) && !(last.buttons & bit);
+      }
+
+      const uint32_t speed = std::abs(r.tt_delta);
+      s.moving += speed > 0;
+      s.max_speed = std::max(s.max_speed, speed);
+      const uint16_t tt = r.buttons & (BUTTON_TT_NEG | BUTTON_TT_POS);
+      s.wobble += speed == 1 && tt == 0;
+
+      for (int axis = 0; axis < 2; axis++) {
+        const uint8_t value = axis ? r.analog_y : r.analog_x;
+        s.analog_min[axis] = std::min(s.analog_min[axis], value);
+        s.analog_max[axis] = std::max(s.analog_max[axis], value);
+      }
+    }
+
+    // Counts digital turntable reversals into both stats. Starting the other
+    // way after stopping for FLIP_MS is a new spin rather than a reversal
+    void turntable(const report &r) {
+      const uint16_t tt = r.buttons & (BUTTON_TT_NEG | BUTTON_TT_POS);
+      if (!tt) {
+        return;
+      }
+      if (tt != last_tt) {
+        if (last_tt && static_cast<uint16_t>(r.time_ms - tt_active_ms) < FLIP_MS) {
+          const bool flip = static_cast<uint16_t>(tt_active_ms - tt_since_ms) < FLIP_MS;
+          for (stats* s : { &second, &total }) {
+            s->reversals++;
+            s->flips += flip;
+          }
+        }
+        last_tt = tt;
+        tt_since_ms = r.time_ms;
+      }
+      tt_active_ms = r.time_ms;
+    }
+
+    const uint8_t buttons;
+    const bool sdvx;
+    stats second;
+    stats total;
+    report last{};
+    bool has_last = false;
+    uint16_t last_tt = 0;
+    // When last_tt started, and when it was last seen
+    uint16_t tt_since_ms = 0;
+    uint16_t tt_active_ms = 0;
+  };
+
+  volatile std::sig_atomic_t stopping = 0;
+
+  int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  report parse(const uint8_t* data, const size_t size, const int64_t host_us) {
+    report r;
+    r.host_us = host_us;
+    r.sequence = data[0];
+    std::memcpy(&r.time_ms, data + 1, 2);
+    std::memcpy(&r.raw_buttons, data + 3, 2);
+    std::memcpy(&r.raw_toggled, data + 5, 2);
+    std::memcpy(&r.buttons, data + 7, 2);
+    r.tt_x = data[9];
+    r.tt_delta = static_cast<int8_t>(data[10]);
+    r.tt_direction = static_cast<int8_t>(data[11]);
+    r.encoders = data[12];
+    r.analog_x = data[13];
+    r.analog_y = data[14];
+    std::memcpy(&r.loops, data + 15, 2);
+    std::memcpy(&r.max_loop_us, data + 17, 2);
+    r.max_lamp_isr_ticks = size > OLD_REPORT_SIZE ? data[19] : 0;
+    return r;
+  }
+
+  hid_device* open_interface(const unsigned short pid, const int interface) {
+    hid_device* device = nullptr;
+    hid_device_info* devices = hid_enumerate(BEEF_VID, pid);
+    for (auto d = devices; d; d = d->next) {
+      if (d->interface_number == interface) {
+        device = hid_open_path(d->path);
+        break;
+      }
+    }
+    hid_free_enumeration(devices);
+    return device;
+  }
+
+  bool replay(const options &opts) {
+    std::FILE* f = std::fopen(opts.input.c_str(), "rb");
+    if (!f) {
+      std::fprintf(stderr, "Can't open %s\n", opts.input.c_str());
+      return false;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    uint8_t size = 0;
+    if (std::fread(magic, sizeof(magic), 1, f) != 1 || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0 ||
+        std::fread(&size, 1, 1, f) != 1 || size < OLD_REPORT_SIZE) {
+      std::fprintf(stderr, "%s isn't a telemetry recording\n", opts.input.c_str());
+      std::fclose(f);
+      return false;
+    }
+
+    Scope scope(opts.sdvx);
+    std::vector<uint8_t> data(size);
+    int64_t host_us;
+    while (std::fread(&host_us, sizeof(host_us), 1, f) == 1 && std::fread(data.data(), size, 1, f) == 1) {
+      scope.add(parse(data.data(), size, host_us));
+    }
+    std::fclose(f);
+    scope.print_summary();
+    return true;
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+                 "Usage: telemetry-scope [--controller iidx|sdvx] [--output file] [--seconds n]\n"
+                 "       telemetry-scope --input file [--controller iidx|sdvx]\n"
+                 "Needs firmware built with TELEMETRY=1\n");
+  }
+
+  bool parse_arguments(int argc, char** argv, options &opts) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+      const std::string arg = argv[i];
+      const char* value = argv[i + 1];
+      if (arg == "--controller") {
+        opts.sdvx = std::strcmp(value, "sdvx") == 0;
+      } else if (arg == "--input") {
+        opts.input = value;
+      } else if (arg == "--output") {
+        opts.output = value;
+      } else if (arg == "--seconds") {
+        opts.seconds = std::atoi(value);
+      } else {
+        return false;
+      }
+    }
+    return argc % 2 == 1;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  if (!opts.input.empty()) {
+    return replay(opts) ? 0 : 1;
+  }
+
+  if (hid_init() != 0) {
+    std::fprintf(stderr, "Failed to start hidapi\n");
+    return 1;
+  }
+
+  hid_device* device = open_interface(opts.sdvx ? SDVX_PID : IIDX_PID, TELEMETRY_INTERFACE);
+  if (!device) {
+    std::fprintf(stderr, "Beef Board telemetry not found, is the firmware built with TELEMETRY=1?\n");
+    return 1;
+  }
+
+  std::FILE* output = nullptr;
+  if (!opts.output.empty()) {
+    output = std::fopen(opts.output.c_str(), "wb");
+    const uint8_t size = REPORT_SIZE;
+    if (!output || std::fwrite(FILE_MAGIC, sizeof(FILE_MAGIC), 1, output) != 1 ||
+        std::fwrite(&size, 1, 1, output) != 1) {
+      std::fprintf(stderr, "Can't write %s\n", opts.output.c_str());
+      return 1;
+    }
+  }
+
+  std::signal(SIGINT, [](int) { stopping = 1; });
+  std::printf("Streaming telemetry, press Ctrl+C to stop\n");
+
+  Scope scope(opts.sdvx);
+  const int64_t start = now_us();
+  int64_t next_print = start + 1000000;
+  int result = 0;
+  while (!stopping && (opts.seconds == 0 || now_us() - start < opts.seconds * 1000000ll)) {
+    uint8_t data[REPORT_SIZE];
+    const int n = hid_read_timeout(device, data, sizeof(data), 100);
+    const int64_t now = now_us();
+    if (n < 0) {
+      std::fprintf(stderr, "Failed to read telemetry: %ls\n", hid_error(device));
+      result = 1;
+      break;
+    }
+    if (n == static_cast<int>(sizeof(data))) {
+      scope.add(parse(data, sizeof(data), now));
+      if (output && (std::fwrite(&now, sizeof(now), 1, output) != 1 ||
+                     std::fwrite(data, sizeof(data), 1, output) != 1)) {
+        std::fprintf(stderr, "Can't write %s\n", opts.output.c_str());
+        result = 1;
+        break;
+      }
+    }
+
+    if (now >= next_print) {
+      next_print += 1000000;
+      scope.print_second();
+    }
+  }
+
+  scope.print_summary();
+  if (output) {
+    std::fclose(output);
+  }
+  hid_close(device);
+  hid_exit();
+  return result;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Replays the timing code with timing-replay and compares the output with
+# golden/timing.expected, then replays it again starting just before the
+# 49.7 day wrap of the millisecond counter, which has to print exactly the same
+#
+#   ./check-timing.sh [timing-replay]
+#
+# After a deliberate change to what the timing code does, regenerate the
+# expected output with ./timing-replay > golden/timing.expected
+
+REPLAY=${1:-./timing-replay}
+# 1 s, 296 ms and 1 ms before the wrap
+UPTIMES="4294966296 4294967000 4294967295"
+
+cd "$(dirname "$0")" || exit 1
+expected=golden/timing.expected
+failed=0
+for uptime in default $UPTIMES; do
+  if [ "$uptime" = default ]; then
+    set --
+  else
+    set -- --uptime "$uptime"
+  fi
+  if "$REPLAY" "$@" | diff -u "$expected" - >&2; then
+    echo "ok   timing-replay $*"
+  else
+    echo "FAIL timing-replay $*"
+    failed=1
+  fi
+done
+exit $failed
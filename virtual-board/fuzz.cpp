@@ -0,0 +1,350 @@
+// Fuzz target for the paths a host or a corrupt EEPROM can reach: config
+// migration from any stored version, validate_config(), and the config
+// interface's feature reports. Built natively with the virtual board's shim,
+// under AddressSanitizer and UBSan.
+//
+//   make fuzz LIBFUZZER=1 CXX=clang++ CC=clang && ./config-fuzz corpus/
+//   make fuzz-check
+//
+// An input is a list of records, each one step:
+//
+//   0 len data...     boot from EEPROM holding MAGIC and data as the config
+//   1 id len data...  SET_REPORT on the config interface
+//   2 id              GET_REPORT on the config interface
+//
+// After every step the config in use has to pass validate_config(), the LED
+// frames have to fit in the arena, both strips' layout maps have to show every
+// LED exactly once, and a few frames of whichever effects are set, and of both
+// lighting programs, have to render in bounds. The strip effects are the real
+// ones, on the shim's FastLED.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "beef.h"
+#include "chatter.h"
+#include "config.h"
+#include "devices/iidx/iidx_rgb_manager.h"
+#include "hardware.h"
+#include "lighting_program.h"
+#include "rgb_helper.h"
+#include "trace.h"
+
+extern HidReport<config, INTERFACE_ID_Config, ENDPOINT_CONTROLEP> config_hid_report;
+extern CRGB led_arena[LED_ARENA_SIZE];
+extern CRGB* tt_out_leds;
+extern CRGB* bar_out_leds;
+
+namespace RgbHelper {
+  extern uint8_t tt_map[MAX_TT_LEDS];
+  extern uint8_t bar_map[LIGHT_BAR_LEDS];
+}
+
+namespace {
+  enum : uint8_t {
+    RECORD_BOOT,
+    RECORD_SET,
+    RECORD_GET,
+    RECORD_COUNT
+  };
+
+  // Same as config.cpp
+  constexpr uint16_t MAGIC = 0xBEEF;
+  constexpr uint16_t CONFIG_ADDR = 2;
+
+  // Roughly a frame at the default 60 Hz
+  constexpr uint8_t FRAME_MS = 17;
+  constexpr uint8_t FRAMES = 4;
+
+  // The LED count only changes on a reboot, see RgbHelper::init()
+  uint8_t boot_tt_leds = 0;
+
+  [[noreturn]] void fail(const char* what) {
+    fprintf(stderr, "Invariant broken: %s\n", what);
+    abort();
+  }
+
+  // Same as main_init() after setup, on whatever is in EEPROM
+  void load() {
+    config_init(&current_config);
+    RgbHelper::init(current_config);
+    LightingProgram::init();
+    IIDX::RgbManager::init(current_config);
+    usb_handler->config_update(current_config);
+    boot_tt_leds = current_config.tt_leds;
+  }
+
+  void boot(const uint8_t* data, const uint8_t length) {
+    Hardware::reset();
+    eeprom[0] = MAGIC & 0xFF;
+    eeprom[1] = MAGIC >> 8;
+    memcpy(eeprom + CONFIG_ADDR, data, MIN(length, static_cast<uint8_t>(sizeof(config))));
+    load();
+  }
+
+  void set_report(const uint8_t id, const uint8_t* data, const uint8_t length) {
+    UECONX &= ~(1 << STALLRQ);
+    CALLBACK_HID_Device_ProcessHIDReport(&config_hid_report.HID_Interface, id,
+                                         HID_REPORT_ITEM_Feature, data, length);
+    // Then the main loop's pass
+    LightingProgram::save();
+  }
+
+  void get_report(const uint8_t id) {
+    auto &info = config_hid_report.HID_Interface;
+    // LUFA hands the callback a buffer this big, see virtual-board/usb.cpp
+    std::unique_ptr<uint8_t[]> data(new uint8_t[info.Config.PrevReportINBufferSize]());
+    uint8_t report_id = id;
+    uint16_t size = 0;
+    UECONX &= ~(1 << STALLRQ);
+    CALLBACK_HID_Device_CreateHIDReport(&info, &report_id, HID_REPORT_ITEM_Feature, data.get(), &size);
+    if (size > info.Config.PrevReportINBufferSize) {
+      fail("GET_REPORT larger than the control buffer");
+    }
+  }
+
+  void render(const LightingProgram::Slot slot, const uint8_t n) {
+    // Heap allocated at exactly n, so AddressSanitizer sees any overrun
+    std::unique_ptr<CRGB[]> leds(new CRGB[n > 0 ? n : 1]);
+    const LightingProgram::inputs in = {
+      .time = milliseconds,
+      .tt_velocity = 1,
+      .tt_pos = 0,
+      .buttons = 0x7FF
+    };
+    LightingProgram::render(slot, leds.get(), n, in);
+  }
+
+  // Every physical LED shows one LED of the frame, and no two show the same one
+  void check_map(const uint8_t* map, const uint8_t n) {
+    bool shown[256] = {};
+    for (uint8_t p = 0; p < n; p++) {
+      if (map[p] >= n || shown[map[p]]) {
+        fail("layout map isn't a permutation of the strip");
+      }
+      shown[map[p]] = true;
+    }
+  }
+
+  // Frames all come out of the one arena, so running off the end of one lands
+  // in the next, out of AddressSanitizer's sight. Checked against the arena here
+  void check_frames() {
+    if (RgbHelper::num_tt_leds != boot_tt_leds ||
+        RgbHelper::num_tt_leds == 0 || RgbHelper::num_tt_leds > MAX_TT_LEDS) {
+      fail("LED count out of step with the config it booted with");
+    }
+    if (tt_leds != led_arena || bar_out_leds + LIGHT_BAR_LEDS > led_arena + LED_ARENA_SIZE) {
+      fail("LED frames don't fit in the arena");
+    }
+    if (tt_out_leds - tt_leds != 2 * RgbHelper::num_tt_leds + 4 * LIGHT_BAR_LEDS) {
+      fail("LED frames overlap");
+    }
+    check_map(RgbHelper::tt_map, RgbHelper::num_tt_leds);
+    check_map(RgbHelper::bar_map, LIGHT_BAR_LEDS);
+  }
+
+  // A few frames of whatever the config has on both strips, turning the
+  // turntable both ways, so tickers and patterns step at least once
+  void render_strips() {
+    IIDX::hid_lights lights{};
+    lights.tt_lights = { 255, 128, 0 };
+    lights.bar_lights = { 0, 128, 255 };
+    IIDX::RgbManager::Turntable::force_update = true;
+    IIDX::RgbManager::Bar::force_update = true;
+    for (uint8_t frame = 0; frame < FRAMES; frame++) {
+      milliseconds += FRAME_MS;
+      IIDX::RgbManager::update(frame & 1 ? 1 : -1, lights);
+    }
+  }
+
+  void check() {
+    if (!validate_config(current_config)) {
+      fail("config in use doesn't validate");
+    }
+    check_frames();
+    render_strips();
+    render(LightingProgram::Slot::Turntable, RgbHelper::num_tt_leds);
+    render(LightingProgram::Slot::Bar, LIGHT_BAR_LEDS);
+  }
+
+  void start() {
+    static bool started = false;
+    if (!started) {
+      Hardware::reset();
+      main_init();
+      started = true;
+    }
+    // Every input starts from a freshly flashed board
+    Hardware::reset();
+    load();
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+  start();
+
+  const uint8_t* const end = data + size;
+  while (data < end) {
+    const uint8_t record = *data++ % RECORD_COUNT;
+    uint8_t id = 0;
+    if (record != RECORD_BOOT) {
+      if (data == end) {
+        break;
+      }
+      id = *data++;
+    }
+
+    uint8_t length = 0;
+    if (record != RECORD_GET) {
+      if (data == end) {
+        break;
+      }
+      const uint8_t wanted = *data++;
+      length = MIN(static_cast<size_t>(wanted), static_cast<size_t>(end - data));
+    }
+
+    // Copied so AddressSanitizer catches reads past what the host sent, and
+    // never null since LUFA always passes its control buffer
+    std::unique_ptr<uint8_t[]> payload(new uint8_t[length]);
+    memcpy(payload.get(), data, length);
+    data += length;
+
+    switch (record) {
+      case RECORD_BOOT:
+        boot(payload.get(), length);
+        break;
+      case RECORD_SET:
+        set_report(id, payload.get(), length);
+        break;
+      case RECORD_GET:
+        get_report(id);
+        break;
+    }
+    check();
+  }
+  return 0;
+}
+
+#ifndef LIBFUZZER
+// Without libFuzzer, runs the files given, then inputs generated from a fixed
+// seed so every run is the same. Each record starts from a valid report and
+// mutates a few bytes of it, which gets past the size checks far more often
+// than random bytes would
+namespace {
+  uint32_t seed = 1;
+
+  uint32_t next() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
+
+  void mutate(std::vector<uint8_t> &payload) {
+    const uint8_t flips = next() % 4;
+    for (uint8_t i = 0; i < flips && !payload.empty(); i++) {
+      payload[next() % payload.size()] = next();
+    }
+  }
+
+  std::vector<uint8_t> config_payload() {
+    std::vector<uint8_t> payload(sizeof(config));
+    memcpy(payload.data(), &current_config, sizeof(config));
+    if (next() % 2) {
+      // Every stored version has to migrate to something valid
+      payload[offsetof(config, version)] = next() % 32;
+    }
+    mutate(payload);
+    return payload;
+  }
+
+  std::vector<uint8_t> program_payload() {
+    LightingProgram::program_report report{};
+    report.slot = LightingProgram::Slot(next() % 3);
+    report.length = next() % (LightingProgram::MAX_PROGRAM_SIZE + 4);
+    for (auto &byte : report.code) {
+      // Mostly real ops, and small immediates so jumps land nearby
+      byte = next() % 2 ? next() % uint8_t(LightingProgram::Op::Count) : next() % 16;
+    }
+    std::vector<uint8_t> payload(sizeof(report));
+    memcpy(payload.data(), &report, sizeof(report));
+    return payload;
+  }
+
+  std::vector<uint8_t> generate() {
+    std::vector<uint8_t> input;
+    const uint8_t records = 1 + next() % 8;
+    for (uint8_t r = 0; r < records; r++) {
+      const uint8_t record = next() % RECORD_COUNT;
+      const uint8_t id = 1 + next() % HID_REPORTID_Latched;
+      std::vector<uint8_t> payload;
+      if (record == RECORD_BOOT) {
+        payload = config_payload();
+      } else if (id == HID_REPORTID_Config) {
+        payload = config_payload();
+      } else if (id == HID_REPORTID_LightingProgram) {
+        payload = program_payload();
+      } else {
+        payload.resize(next() % 4);
+        for (auto &byte : payload) {
+          byte = next();
+        }
+      }
+      if (next() % 8 == 0) {
+        // Wrong sizes have to be turned away too
+        payload.resize(next() % (sizeof(config) + 2));
+      }
+
+      input.push_back(record);
+      if (record != RECORD_BOOT) {
+        input.push_back(id);
+      }
+      if (record != RECORD_GET) {
+        input.push_back(payload.size());
+        input.insert(input.end(), payload.begin(), payload.end());
+      }
+    }
+    return input;
+  }
+
+  bool run_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+      fprintf(stderr, "Can't open %s\n", path);
+      return false;
+    }
+    std::vector<uint8_t> input;
+    uint8_t buffer[256];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      input.insert(input.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+    return true;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t runs = 100000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = strtoul(argv[++i], nullptr, 10);
+    } else if (!run_file(argv[i])) {
+      return 1;
+    }
+  }
+
+  for (uint32_t i = 0; i < runs; i++) {
+    const auto input = generate();
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  printf("%u generated inputs passed\n", runs);
+  return 0;
+}
+#endif
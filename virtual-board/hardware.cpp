@@ -0,0 +1,87 @@
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <FastLED/src/FastLED.h>
+
+#include "hardware.h"
+
+#define AVR_DEFINE_8(name) volatile uint8_t name;
+#define AVR_DEFINE_16(name) volatile uint16_t name;
+AVR_REGISTERS_8(AVR_DEFINE_8)
+AVR_REGISTERS_16(AVR_DEFINE_16)
+#undef AVR_DEFINE_8
+#undef AVR_DEFINE_16
+
+// Erased EEPROM reads back as 0xFF, which the firmware takes as no config
+uint8_t eeprom[EEPROM_SIZE];
+
+CFastLED FastLED;
+
+// Whole milliseconds the firmware's clock has been moved on since power on
+static uint64_t elapsed_ms = 0;
+
+namespace Hardware {
+  void reset() {
+    memset(eeprom, 0xFF, sizeof(eeprom));
+
+    // Buttons are active low with pull-ups, so nothing is pressed
+    PINA = PINB = PINC = PIND = PINE = PINF = 0xFF;
+    // The turntable encoder starts on 00
+    PINF &= ~((1 << PINF0) | (1 << PINF1));
+  }
+
+  bool load_eeprom(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+      return false;
+    }
+    fread(eeprom, 1, sizeof(eeprom), file);
+    fclose(file);
+    return true;
+  }
+
+  bool save_eeprom(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+      return false;
+    }
+    const bool ok = fwrite(eeprom, 1, sizeof(eeprom), file) == sizeof(eeprom);
+    return fclose(file) == 0 && ok;
+  }
+
+  void set_button(const button_pins &button, const bool pressed) {
+    if (pressed) {
+      *button.INPUT_PORT.PIN &= ~(1 << button.input_pin);
+    } else {
+      *button.INPUT_PORT.PIN |= 1 << button.input_pin;
+    }
+  }
+
+  bool lamp(const button_pins &button) {
+    return *button.LED_PORT.PORT & (1 << button.led_pin);
+  }
+
+  void step_turntable(const int8_t direction) {
+    // Gray code, in the order the firmware counts as positive
+    static const uint8_t sequence[4] = { 0b00, 0b01, 0b11, 0b10 };
+    static uint8_t position = 0;
+
+    position = (position + direction) & 3;
+    const uint8_t ab = sequence[position];
+    const uint8_t mask = (1 << PINF0) | (1 << PINF1);
+    PINF = (PINF & ~mask) | ((ab >> 1) << PINF0) | ((ab & 1) << PINF1);
+  }
+
+  void set_uptime(const uint32_t ms) {
+    milliseconds = ms;
+  }
+
+  void set_clock(const uint64_t us) {
+    // Timer1 counts 0-249 at 4us a tick, and the firmware counts milliseconds off its interrupt
+    for (; elapsed_ms < us / 1000; elapsed_ms++) {
+      TIMER1_COMPA_vect();
+    }
+    TCNT1 = us % 1000 / 4;
+    // Full speed frames are 1ms
+    UDFNUM = milliseconds & 0x7FF;
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pin.h"
+#include "timer.h"
+
+// Interrupt handlers in the firmware, the virtual board calls them when they'd fire
+extern "C" void TIMER1_COMPA_vect();
+extern "C" void TIMER3_COMPA_vect();
+
+// The board's pins, registers and EEPROM, as the firmware sees them
+namespace Hardware {
+  // Power on state, with erased EEPROM and nothing pressed
+  void reset();
+  bool load_eeprom(const char* path);
+  bool save_eeprom(const char* path);
+
+  void set_button(const button_pins &button, bool pressed);
+  // Whether a lamp's pin is driven high, in whichever bit plane is being output
+  bool lamp(const button_pins &button);
+  // Moves the turntable encoder one step, +1 or -1
+  void step_turntable(int8_t direction);
+
+  // Where the firmware's clock starts, before the first set_clock()
+  void set_uptime(uint32_t ms);
+  // Catches the firmware's clock up to us microseconds since power on
+  void set_clock(uint64_t us);
+}
@@ -0,0 +1,320 @@
+// Runs the firmware on the host, presenting it to the kernel through uhid
+// so games, beef-config and the host tools can be tested without a board
+//
+//   ./virtual-board script.txt
+//   ./virtual-board --hold 1,9 --eeprom sdvx.eeprom -v
+//   ./virtual-board --uptime 4294957296 script.txt
+//
+// Scripts are read line by line, from stdin if no file is given:
+//
+//   press 1 2       press buttons 1 and 2, numbered 1-11 like the firmware
+//   release 1       release button 1, or every button without a number
+//   tt 96 200       turn the turntable 96 encoder steps over 200ms, negative turns it back
+//   wait 500        wait 500ms before the next line
+//   lamps           print the lit lamps
+//   quit            unplug the board and exit
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "beef.h"
+#include "hardware.h"
+#include "usb.h"
+
+extern button_pins buttons[];
+
+namespace {
+  struct options {
+    const char* script = nullptr;
+    uint16_t hold = 0;
+    uint32_t uptime_ms = 0;
+  };
+
+  volatile std::sig_atomic_t stopping = 0;
+  const char* eeprom_path = nullptr;
+
+  int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Reads whole lines without blocking, so an interactive stdin doesn't hold up the board
+  class LineReader {
+  public:
+    explicit LineReader(const int fd) : fd(fd) {}
+
+    bool next(std::string &line) {
+      while (true) {
+        const auto end = buffer.find('\n');
+        if (end != std::string::npos) {
+          line = buffer.substr(0, end);
+          buffer.erase(0, end + 1);
+          return true;
+        }
+        if (eof) {
+          if (buffer.empty()) {
+            return false;
+          }
+          line.swap(buffer);
+          buffer.clear();
+          return true;
+        }
+
+        pollfd p{ fd, POLLIN, 0 };
+        if (::poll(&p, 1, 0) <= 0) {
+          return false;
+        }
+
+        char chunk[256];
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) {
+          eof = true;
+        } else {
+          buffer.append(chunk, n);
+        }
+      }
+    }
+
+  private:
+    int fd;
+    std::string buffer;
+    bool eof = false;
+  };
+
+  class Script {
+  public:
+    Script(const int fd, const uint32_t start_ms) : reader(fd), resume_ms(start_ms) {}
+
+    // Runs lines until the next wait, returns false once the script quits
+    bool run(const uint32_t now_ms) {
+      if (static_cast<int32_t>(now_ms - resume_ms) < 0) {
+        return true;
+      }
+
+      std::string line;
+      while (reader.next(line)) {
+        if (!run_line(line, now_ms)) {
+          return false;
+        }
+        if (static_cast<int32_t>(now_ms - resume_ms) < 0) {
+          break;
+        }
+      }
+      return true;
+    }
+
+    // At most one encoder step per main loop pass, or the firmware would miss some
+    void step_turntable(const uint32_t now_ms) {
+      if (tt_steps == 0) {
+        return;
+      }
+
+      const uint32_t elapsed = std::min(now_ms - tt_start_ms, tt_duration_ms);
+      const int32_t due = static_cast<int64_t>(tt_steps) * elapsed / tt_duration_ms;
+      if (tt_done != due) {
+        const int8_t direction = due > tt_done ? 1 : -1;
+        Hardware::step_turntable(direction);
+        tt_done += direction;
+      }
+      if (tt_done == tt_steps) {
+        tt_steps = 0;
+      }
+    }
+
+  private:
+    bool run_line(const std::string &line, const uint32_t now_ms) {
+      std::istringstream in(line.substr(0, line.find('#')));
+      std::string command;
+      if (!(in >> command)) {
+        return true;
+      }
+
+      if (command == "press" || command == "release") {
+        const bool pressed = command == "press";
+        int button;
+        bool any = false;
+        while (in >> button) {
+          any = true;
+          if (button < 1 || button > BUTTONS) {
+            std::fprintf(stderr, "No button %d\n", button);
+            continue;
+          }
+          Hardware::set_button(buttons[button - 1], pressed);
+        }
+        if (!any && !pressed) {
+          for (uint8_t i = 0; i < BUTTONS; i++) {
+            Hardware::set_button(buttons[i], false);
+          }
+        }
+      } else if (command == "tt") {
+        int32_t steps = 0;
+        uint32_t duration = 0;
+        in >> steps >> duration;
+        // Replaces whatever is left of the last turn
+        tt_steps = steps;
+        tt_done = 0;
+        tt_start_ms = now_ms;
+        tt_duration_ms = duration ? duration : std::max<uint32_t>(std::abs(steps), 1);
+      } else if (command == "wait") {
+        uint32_t ms = 0;
+        in >> ms;
+        resume_ms = now_ms + ms;
+      } else if (command == "lamps") {
+        std::printf("%8u lamps   ", now_ms);
+        for (uint8_t i = 0; i < BUTTONS; i++) {
+          if (Hardware::lamp(buttons[i])) {
+            std::printf(" %u", i + 1);
+          }
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+      } else if (command == "quit") {
+        return false;
+      } else {
+        std::fprintf(stderr, "Unknown command: %s\n", line.c_str());
+      }
+      return true;
+    }
+
+    LineReader reader;
+    uint32_t resume_ms;
+
+    int32_t tt_steps = 0;
+    int32_t tt_done = 0;
+    uint32_t tt_start_ms = 0;
+    uint32_t tt_duration_ms = 1;
+  };
+
+  // Also runs when the firmware reboots, which exits
+  void save_eeprom() {
+    if (eeprom_path && !Hardware::save_eeprom(eeprom_path)) {
+      std::fprintf(stderr, "Failed to save EEPROM to %s\n", eeprom_path);
+    }
+  }
+
+  void usage() {
+    std::fprintf(stderr,
+      "Usage: virtual-board [options] [script]\n"
+      "  --hold BUTTONS  buttons held while plugging in, e.g. 1,9 for SDVX joystick mode\n"
+      "  --eeprom FILE   load EEPROM from FILE and save it back on exit\n"
+      "  --uptime MS     start the firmware's clock MS ms after power on\n"
+      "  -v              print every report\n");
+  }
+
+  bool parse_buttons(const char* arg, uint16_t &bits) {
+    std::istringstream in(arg);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+      const int button = std::atoi(item.c_str());
+      if (button < 1 || button > BUTTONS) {
+        return false;
+      }
+      bits |= 1 << (button - 1);
+    }
+    return true;
+  }
+
+  bool parse_arguments(const int argc, char** argv, options &opts) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      const bool has_value = i + 1 < argc;
+      if (arg == "--hold" && has_value) {
+        if (!parse_buttons(argv[++i], opts.hold)) {
+          return false;
+        }
+      } else if (arg == "--eeprom" && has_value) {
+        eeprom_path = argv[++i];
+      } else if (arg == "--uptime" && has_value) {
+        opts.uptime_ms = std::strtoul(argv[++i], nullptr, 10);
+      } else if (arg == "-v") {
+        Usb::verbose = true;
+      } else if (arg[0] != '-' && !opts.script) {
+        opts.script = argv[i];
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+int main(int argc, char** argv) {
+  options opts;
+  if (!parse_arguments(argc, argv, opts)) {
+    usage();
+    return 1;
+  }
+
+  int script_fd = STDIN_FILENO;
+  if (opts.script) {
+    script_fd = open(opts.script, O_RDONLY | O_CLOEXEC);
+    if (script_fd < 0) {
+      std::fprintf(stderr, "Can't open %s\n", opts.script);
+      return 1;
+    }
+  }
+  Script script(script_fd, opts.uptime_ms);
+
+  Hardware::reset();
+  Hardware::set_uptime(opts.uptime_ms);
+  if (eeprom_path && !Hardware::load_eeprom(eeprom_path)) {
+    std::printf("Starting with blank EEPROM\n");
+  }
+  std::atexit(save_eeprom);
+  for (uint8_t i = 0; i < BUTTONS; i++) {
+    Hardware::set_button(buttons[i], opts.hold & (1 << i));
+  }
+
+  const int64_t start = now_us();
+  const auto clock = [start]() {
+    Hardware::set_clock(now_us() - start);
+  };
+
+  clock();
+  main_init();
+  if (!Usb::attach()) {
+    return 1;
+  }
+  std::printf("Board attached, press Ctrl+C to unplug\n");
+  std::fflush(stdout);
+
+  std::signal(SIGINT, [](int) { stopping = 1; });
+  std::signal(SIGTERM, [](int) { stopping = 1; });
+
+  uint32_t frame = milliseconds;
+  while (!stopping) {
+    Usb::poll();
+    clock();
+    if (!script.run(milliseconds)) {
+      break;
+    }
+    script.step_turntable(milliseconds);
+
+    if (frame != milliseconds) {
+      frame = milliseconds;
+      Usb::start_of_frame();
+    }
+    // Next bit plane for the lamps
+    TIMER3_COMPA_vect();
+
+    main_task();
+
+    // The real main loop spins, this leaves some CPU for the host
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  Usb::detach();
+  return 0;
+}
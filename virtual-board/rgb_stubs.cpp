@@ -0,0 +1,90 @@
+#include "devices/iidx/iidx_rgb_manager.h"
+#include "hid.h"
+#include "rgb_helper.h"
+
+// LED strips aren't emulated, their effects need the real FastLED.
+// These keep the state the rest of the firmware reads and do nothing else.
+
+CRGB* tt_leds;
+CRGB* tt_rainbow_leds;
+CRGB* bar_leds;
+CRGB* bar_staging_leds;
+CRGB* bar_prev_leds;
+CRGB* bar_next_leds;
+
+namespace RgbHelper {
+  timer combo_timer{};
+  uint8_t tt_anim_normalise = 0;
+  uint8_t num_tt_leds = 0;
+
+  void init(const config &cfg) {
+    timer_init(&combo_timer);
+    num_tt_leds = cfg.tt_leds;
+  }
+
+  void update(const config &new_cfg) {
+    num_tt_leds = new_cfg.tt_leds;
+  }
+
+  void start(const render_fn render, void* arg) {
+    (void)render;
+    (void)arg;
+  }
+
+  void run() {}
+
+  bool set_rgb(CRGB* leds, const uint8_t n, const CRGB &rgb) {
+    bool update = false;
+    for (uint8_t i = 0; i < n; i++) {
+      update |= leds[i] != rgb;
+      leds[i] = rgb;
+    }
+    return update;
+  }
+
+  void clear() {}
+}
+
+namespace IIDX {
+  namespace RgbManager {
+    void init(const config &cfg) {
+      (void)cfg;
+    }
+
+    // Light frames are taken off the ring, there's no bar to show them on
+    void receive() {
+      HID_Discard(lights_out_state);
+    }
+
+    void update(const int8_t tt_report, const hid_lights &led_state_from_hid_report) {
+      (void)tt_report;
+      (void)led_state_from_hid_report;
+    }
+
+    namespace Turntable {
+      bool force_update = false;
+
+      bool set_leds_off() {
+        return false;
+      }
+
+      void reverse_tt(const bool reverse_tt) {
+        (void)reverse_tt;
+      }
+
+      void display_tt_change(const CRGB &colour, const uint8_t value, const uint8_t range) {
+        (void)colour;
+        (void)value;
+        (void)range;
+      }
+    }
+
+    namespace Bar {
+      bool force_update = false;
+
+      bool set_leds_off() {
+        return false;
+      }
+    }
+  }
+}
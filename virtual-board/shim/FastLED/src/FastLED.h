@@ -0,0 +1,220 @@
+#pragma once
+
+// The colour types and 8-bit maths the firmware's effects use, and controllers
+// that only keep the frame they're shown. LED strips aren't emulated.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t fract8;
+
+struct CHSV {
+  uint8_t h, s, v;
+
+  CHSV() = default;
+  constexpr CHSV(uint8_t h, uint8_t s, uint8_t v) : h(h), s(s), v(v) {}
+};
+
+struct CRGB {
+  uint8_t r, g, b;
+
+  enum HTMLColorCode : uint32_t {
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    Green = 0x008000,
+    Red = 0xFF0000,
+    White = 0xFFFFFF,
+    Yellow = 0xFFFF00
+  };
+
+  CRGB() = default;
+  constexpr CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+  constexpr CRGB(HTMLColorCode code) : r(code >> 16), g(code >> 8), b(code) {}
+  CRGB(const CHSV &hsv);
+
+  uint8_t &operator[](uint8_t i) { return (&r)[i]; }
+  const uint8_t &operator[](uint8_t i) const { return (&r)[i]; }
+
+  CRGB &operator+=(const CRGB &rhs);
+  CRGB &nscale8(uint8_t scale);
+  CRGB scale8(uint8_t scale) const;
+};
+
+inline bool operator==(const CRGB &a, const CRGB &b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+inline bool operator!=(const CRGB &a, const CRGB &b) {
+  return !(a == b);
+}
+
+inline uint8_t scale8(uint8_t i, fract8 scale) {
+  return (static_cast<uint16_t>(i) * (1 + scale)) >> 8;
+}
+
+inline CRGB &CRGB::nscale8(uint8_t scale) {
+  r = ::scale8(r, scale);
+  g = ::scale8(g, scale);
+  b = ::scale8(b, scale);
+  return *this;
+}
+
+inline CRGB CRGB::scale8(uint8_t scale) const {
+  return CRGB(*this).nscale8(scale);
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) {
+  const unsigned t = i + j;
+  return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) {
+  return i > j ? i - j : 0;
+}
+
+inline CRGB &CRGB::operator+=(const CRGB &rhs) {
+  r = qadd8(r, rhs.r);
+  g = qadd8(g, rhs.g);
+  b = qadd8(b, rhs.b);
+  return *this;
+}
+
+inline CRGB operator-(const CRGB &a, const CRGB &b) {
+  return CRGB(qsub8(a.r, b.r), qsub8(a.g, b.g), qsub8(a.b, b.b));
+}
+
+inline uint8_t sin8(uint8_t theta) {
+  return 128 + lrintf(127.5f * sinf(theta * (2 * static_cast<float>(M_PI) / 256)) - 0.5f);
+}
+
+inline uint8_t cos8(uint8_t theta) {
+  return sin8(theta + 64);
+}
+
+inline uint8_t triwave8(uint8_t in) {
+  if (in & 0x80) {
+    in = 255 - in;
+  }
+  return in << 1;
+}
+
+inline uint8_t quadwave8(uint8_t in) {
+  const uint8_t j = triwave8(in);
+  const uint8_t eased = j & 0x80 ? 255 - scale8(255 - j, 255 - j) * 2 : scale8(j, j) * 2;
+  return eased;
+}
+
+inline CRGB blend(const CRGB &a, const CRGB &b, fract8 amount) {
+  return CRGB(a.r + ((b.r - a.r) * amount >> 8),
+              a.g + ((b.g - a.g) * amount >> 8),
+              a.b + ((b.b - a.b) * amount >> 8));
+}
+
+// Straight HSV conversion, close enough for anything the virtual board prints
+inline void hsv2rgb_spectrum(const CHSV &hsv, CRGB &rgb) {
+  const uint8_t region = hsv.h / 43;
+  const uint8_t f = (hsv.h - region * 43) * 6;
+  const uint8_t p = scale8(hsv.v, 255 - hsv.s);
+  const uint8_t q = scale8(hsv.v, 255 - scale8(hsv.s, f));
+  const uint8_t t = scale8(hsv.v, 255 - scale8(hsv.s, 255 - f));
+  switch (region) {
+    case 0: rgb = CRGB(hsv.v, t, p); break;
+    case 1: rgb = CRGB(q, hsv.v, p); break;
+    case 2: rgb = CRGB(p, hsv.v, t); break;
+    case 3: rgb = CRGB(p, q, hsv.v); break;
+    case 4: rgb = CRGB(t, p, hsv.v); break;
+    default: rgb = CRGB(hsv.v, p, q); break;
+  }
+}
+
+inline void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb) {
+  hsv2rgb_spectrum(hsv, rgb);
+}
+
+inline CRGB::CRGB(const CHSV &hsv) {
+  hsv2rgb_rainbow(hsv, *this);
+}
+
+// Same saturation and value as FastLED's
+inline void fill_rainbow(CRGB* leds, int n, uint8_t hue, uint8_t delta = 5) {
+  for (int i = 0; i < n; i++, hue += delta) {
+    leds[i] = CHSV(hue, 240, 255);
+  }
+}
+
+inline void fill_rainbow_circular(CRGB* leds, int n, uint8_t hue, bool reversed = false) {
+  if (n <= 0) {
+    return;
+  }
+  const uint16_t delta = 65535 / n;
+  uint16_t hue16 = hue << 8;
+  for (int i = 0; i < n; i++) {
+    leds[i] = CHSV(hue16 >> 8, 240, 255);
+    hue16 = reversed ? hue16 - delta : hue16 + delta;
+  }
+}
+
+enum { DISABLE_DITHER = 0 };
+
+template<uint8_t DATA_PIN> class NEOPIXEL {};
+
+// Keeps what it was last shown. Showing reads the whole frame, so the
+// sanitizers catch a strip that was handed too short a buffer
+class CLEDController {
+ public:
+  CLEDController* next = nullptr;
+  CRGB* leds = nullptr;
+  int n = 0;
+  uint8_t brightness = 0;
+  uint32_t sum = 0;
+
+  CLEDController &setDither(uint8_t dither) {
+    (void)dither;
+    return *this;
+  }
+
+  void showLeds(uint8_t brightness) {
+    this->brightness = brightness;
+    sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += leds[i].r + leds[i].g + leds[i].b;
+    }
+  }
+};
+
+class CFastLED {
+ public:
+  // One controller per pin, so setting a strip up again replaces it
+  template<template<uint8_t> class CHIPSET, uint8_t DATA_PIN>
+  CLEDController &addLeds(CRGB* leds, int n) {
+    static CLEDController controller;
+    static bool added = false;
+    if (!added) {
+      controller.next = controllers;
+      controllers = &controller;
+      added = true;
+    }
+    controller.leds = leds;
+    controller.n = n;
+    return controller;
+  }
+
+  void setMaxRefreshRate(uint16_t refresh) {
+    (void)refresh;
+  }
+
+  void clear(bool write = false) {
+    for (auto controller = controllers; controller; controller = controller->next) {
+      memset(controller->leds, 0, controller->n * sizeof(CRGB));
+      if (write) {
+        controller->showLeds(0);
+      }
+    }
+  }
+
+ private:
+  CLEDController* controllers = nullptr;
+};
+
+extern CFastLED FastLED;
@@ -0,0 +1,4 @@
+#pragma once
+
+// There's no signature row to read a serial number from
+#define boot_signature_byte_get(address) 0
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// 4KB of EEPROM in RAM, the virtual board loads and saves it from a file
+enum {
+  EEPROM_SIZE = 4096
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern uint8_t eeprom[EEPROM_SIZE];
+#ifdef __cplusplus
+}
+#endif
+
+#define EEMEM
+#define E2END (EEPROM_SIZE - 1)
+
+static inline uint8_t eeprom_read_byte(const uint8_t* address) {
+  return eeprom[(uintptr_t)address % EEPROM_SIZE];
+}
+
+static inline void eeprom_update_byte(uint8_t* address, const uint8_t value) {
+  eeprom[(uintptr_t)address % EEPROM_SIZE] = value;
+}
+
+static inline void eeprom_read_block(void* dst, const void* src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    ((uint8_t*)dst)[i] = eeprom_read_byte((const uint8_t*)src + i);
+  }
+}
+
+static inline void eeprom_update_block(const void* src, void* dst, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    eeprom_update_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]);
+  }
+}
+
+static inline uint16_t eeprom_read_word(const uint16_t* address) {
+  uint16_t value;
+  eeprom_read_block(&value, address, sizeof(value));
+  return value;
+}
+
+static inline void eeprom_update_word(uint16_t* address, const uint16_t value) {
+  eeprom_update_block(&value, address, sizeof(value));
+}
+
+static inline uint32_t eeprom_read_dword(const uint32_t* address) {
+  uint32_t value;
+  eeprom_read_block(&value, address, sizeof(value));
+  return value;
+}
+
+static inline void eeprom_update_dword(uint32_t* address, const uint32_t value) {
+  eeprom_update_block(&value, address, sizeof(value));
+}
+
+#define eeprom_write_byte eeprom_update_byte
+#define eeprom_write_word eeprom_update_word
+#define eeprom_write_dword eeprom_update_dword
+#define eeprom_write_block eeprom_update_block
+#define eeprom_busy_wait()
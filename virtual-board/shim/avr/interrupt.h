@@ -0,0 +1,18 @@
+#pragma once
+
+#include <avr/io.h>
+
+// The virtual board calls interrupt handlers from its own loop between firmware tasks,
+// so nothing ever preempts the firmware and masking interrupts is a no-op
+#define sei()
+#define cli()
+
+#ifdef __cplusplus
+#define ISR(vector, ...) extern "C" void vector(void); void vector(void)
+#else
+#define ISR(vector, ...) void vector(void); void vector(void)
+#endif
+#define ISR_ALIASOF(vector)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define EMPTY_INTERRUPT(vector) ISR(vector) {}
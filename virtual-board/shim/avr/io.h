@@ -0,0 +1,227 @@
+#pragma once
+
+// Just enough of an AT90USB1286 for the firmware and LUFA headers to compile natively.
+// Registers are plain variables, so the virtual board drives inputs by writing
+// PINx and reads outputs back from PORTx, like a logic analyser would.
+
+#include <stdint.h>
+
+#define AVR_REGISTERS_8(R) \
+  R(PINA) R(DDRA) R(PORTA) \
+  R(PINB) R(DDRB) R(PORTB) \
+  R(PINC) R(DDRC) R(PORTC) \
+  R(PIND) R(DDRD) R(PORTD) \
+  R(PINE) R(DDRE) R(PORTE) \
+  R(PINF) R(DDRF) R(PORTF) \
+  R(SREG) R(MCUSR) R(MCUCR) R(CLKPR) R(SMCR) \
+  R(EIMSK) R(EIFR) R(EICRA) R(EICRB) R(PCICR) R(PCIFR) R(PCMSK0) \
+  R(TCCR0A) R(TCCR0B) R(TCNT0) R(TIMSK0) R(TIFR0) \
+  R(TCCR1A) R(TCCR1B) R(TIMSK1) R(TIFR1) \
+  R(TIMSK2) \
+  R(TCCR3A) R(TCCR3B) R(TIMSK3) R(TIFR3) \
+  R(ADMUX) R(ADCSRA) R(ADCL) R(ADCH) \
+  R(SPCR) R(ACSR) R(EECR) R(TWCR) R(UCSR1B) \
+  R(UHWCON) R(USBCON) R(USBSTA) R(USBINT) \
+  R(UDCON) R(UDINT) R(UDIEN) R(UDADDR) R(UDFNUML) R(UDFNUMH) R(UDMFN) \
+  R(UEINTX) R(UENUM) R(UERST) R(UECONX) R(UECFG0X) R(UECFG1X) R(UESTA0X) R(UESTA1X) \
+  R(UEIENX) R(UEDATX) R(UEBCLX) R(UEBCHX) R(UEINT) \
+  R(OTGCON) R(OTGIEN) R(OTGINT) R(PLLCSR)
+
+#define AVR_REGISTERS_16(R) \
+  R(TCNT1) R(OCR1A) \
+  R(TCNT3) R(OCR3A) \
+  R(UDFNUM) R(UEBCX)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AVR_DECLARE_8(name) extern volatile uint8_t name;
+#define AVR_DECLARE_16(name) extern volatile uint16_t name;
+AVR_REGISTERS_8(AVR_DECLARE_8)
+AVR_REGISTERS_16(AVR_DECLARE_16)
+#undef AVR_DECLARE_8
+#undef AVR_DECLARE_16
+
+#ifdef __cplusplus
+}
+#endif
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_IO_ADDR(reg) 0
+#define bit_is_set(reg, bit) ((reg) & _BV(bit))
+#define bit_is_clear(reg, bit) (!((reg) & _BV(bit)))
+
+#define PINA0 0
+#define PINA1 1
+#define PINA2 2
+#define PINA3 3
+#define PINA4 4
+#define PINA5 5
+#define PINA6 6
+#define PINA7 7
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+#define PINB4 4
+#define PINB5 5
+#define PINB6 6
+#define PINB7 7
+#define PINC0 0
+#define PINC1 1
+#define PINC2 2
+#define PINC3 3
+#define PINC4 4
+#define PINC5 5
+#define PINC6 6
+#define PINC7 7
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define PIND7 7
+#define PINE0 0
+#define PINE1 1
+#define PINE2 2
+#define PINE3 3
+#define PINE4 4
+#define PINE5 5
+#define PINE6 6
+#define PINE7 7
+#define PINF0 0
+#define PINF1 1
+#define PINF2 2
+#define PINF3 3
+#define PINF4 4
+#define PINF5 5
+#define PINF6 6
+#define PINF7 7
+
+// MCUSR, MCUCR, CLKPR
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define JTRF 4
+#define IVCE 0
+#define IVSEL 1
+#define PUD 4
+#define JTD 7
+
+// Timers
+#define TOV0 0
+#define OCF1A 1
+#define OCIE1A 1
+#define OCIE3A 1
+#define WGM12 3
+#define WGM32 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define CS30 0
+#define CS31 1
+#define CS32 2
+
+// ADC
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADSC 6
+#define ADEN 7
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+
+// External interrupts
+#define INT0 0
+#define INT1 1
+#define INT2 2
+#define INT3 3
+#define ISC00 0
+#define ISC01 1
+#define ISC20 4
+#define ISC21 5
+#define INTF0 0
+#define INTF2 2
+#define PCIE0 0
+#define PCIF0 0
+#define PCINT4 4
+#define PCINT6 6
+
+// USB controller
+#define UVREGE 0
+#define UIMOD 7
+#define UIDE 6
+#define UVCONE 4
+#define OTGPADE 4
+#define FRZCLK 5
+#define USBE 7
+#define VBUSTE 0
+#define VBUSTI 0
+#define VBUS 0
+#define ID 1
+#define SPEED 3
+#define PLLP0 2
+#define PLLP1 3
+#define PLLP2 4
+#define PLLE 1
+#define PLOCK 0
+#define DETACH 0
+#define RMWKUP 1
+#define LSM 2
+#define RSTCPU 3
+#define SUSPI 0
+#define MSOFI 1
+#define SOFI 2
+#define EORSTI 3
+#define WAKEUPI 4
+#define EORSMI 5
+#define UPRSMI 6
+#define SUSPE 0
+#define MSOFE 1
+#define SOFE 2
+#define EORSTE 3
+#define WAKEUPE 4
+#define EORSME 5
+#define UPRSME 6
+#define ADDEN 7
+#define EPNUM0 0
+#define EPNUM1 1
+#define EPNUM2 2
+#define EPEN 0
+#define RSTDT 3
+#define STALLRQC 4
+#define STALLRQ 5
+#define EPDIR 0
+#define EPTYPE0 6
+#define EPTYPE1 7
+#define ALLOC 1
+#define EPBK0 2
+#define EPBK1 3
+#define EPSIZE0 4
+#define EPSIZE1 5
+#define EPSIZE2 6
+#define CFGOK 7
+#define NBUSYBK0 0
+#define NBUSYBK1 1
+#define DTSEQ0 2
+#define DTSEQ1 3
+#define UNDERFI 5
+#define OVERFI 6
+#define TXINI 0
+#define STALLEDI 1
+#define RXOUTI 2
+#define RXSTPI 3
+#define NAKOUTI 4
+#define RWAL 5
+#define NAKINI 6
+#define FIFOCON 7
+#define TXINE 0
+#define STALLEDE 1
+#define RXOUTE 2
+#define RXSTPE 3
+#define FLERRE 7
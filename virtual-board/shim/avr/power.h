@@ -0,0 +1,4 @@
+#pragma once
+
+#define clock_div_1 0
+#define clock_prescale_set(division)
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdlib.h>
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+
+// The firmware only arms the watchdog to reboot, so the virtual board exits instead
+#define wdt_enable(timeout) exit(0)
+#define wdt_disable()
+#define wdt_reset()
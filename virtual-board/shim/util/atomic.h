@@ -0,0 +1,6 @@
+#pragma once
+
+// Interrupts only run between firmware tasks, see avr/interrupt.h
+#define ATOMIC_BLOCK(type) for (int atomic_once = 1; atomic_once; atomic_once = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
@@ -0,0 +1,200 @@
+// Deterministic replay of the firmware's timing code: Ticker, SpinPattern,
+// BreathingPattern, Bpm, Tempo and process_combos(). A fixed script of
+// presses, turntable spins and a held combo is played against the firmware's
+// own millisecond counter, stepped at irregular intervals from a fixed seed,
+// and what each of them does is printed relative to the start.
+//
+//   ./timing-replay                     what check-timing.sh compares with golden/
+//   ./timing-replay --uptime 4294966296 has to print exactly the same
+//   ./timing-replay --bench             host time per call, for refactors
+//
+// Starting just before the 49.7 day wrap of the counter is the point: a
+// replay that crosses it has to print the same as one that doesn't.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "beef.h"
+#include "bpm.h"
+#include "combo.h"
+#include "config.h"
+#include "hardware.h"
+#include "rgb_patterns.h"
+#include "tempo.h"
+#include "ticker.h"
+
+namespace {
+  constexpr uint32_t DURATION_MS = 20000;
+  // A summary line this often, events as they happen
+  constexpr uint32_t SUMMARY_MS = 500;
+
+  // 150 BPM on button 1 until the combo, so Tempo locks and Bpm fills up
+  constexpr uint32_t BEAT_MS = 400;
+  constexpr uint32_t PRESS_MS = 60;
+  constexpr uint32_t BEATS_END_MS = 10000;
+  // Held long enough to cycle the turntable effect once
+  constexpr uint32_t COMBO_START_MS = 11000;
+  constexpr uint32_t COMBO_END_MS = 12500;
+  constexpr uint16_t TT_EFFECTS_COMBO = BUTTON_2 | BUTTON_8 | BUTTON_11;
+
+  uint32_t seed = 1;
+
+  uint32_t next() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
+
+  // Mostly 1 ms loop passes, some faster than the clock, some long stalls
+  // like a USB transfer or an LED frame holding the loop up
+  uint32_t next_gap() {
+    const uint8_t r = next() % 10;
+    if (r < 7) {
+      return 1;
+    }
+    if (r < 9) {
+      return next() % 4;
+    }
+    return 5 + next() % 36;
+  }
+
+  uint16_t buttons_at(const uint32_t t) {
+    if (t >= COMBO_START_MS && t < COMBO_END_MS) {
+      return TT_EFFECTS_COMBO;
+    }
+    if (t < BEATS_END_MS && t % BEAT_MS < PRESS_MS) {
+      return BUTTON_1;
+    }
+    return 0;
+  }
+
+  int8_t tt_at(const uint32_t t) {
+    if (t >= 3000 && t < 6000) {
+      return 1;
+    }
+    if (t >= 6000 && t < 8000) {
+      return -1;
+    }
+    return 0;
+  }
+
+  struct state {
+    uint32_t ticks;
+    uint16_t spin_steps;
+    uint8_t spin;
+    uint8_t breathing;
+    uint8_t bpm;
+    bool locked;
+    uint16_t period;
+    uint8_t beats;
+    uint8_t tt_effect;
+    bool combo_lights;
+  };
+
+  int replay(const uint32_t uptime) {
+    Hardware::reset();
+    milliseconds = uptime;
+    main_init();
+
+    Ticker ticker(7);
+    SpinPattern spin(50, 25, 12);
+    BreathingPattern breathing(3000);
+    Bpm bpm(16);
+
+    state s{};
+    state last{};
+    last.tt_effect = s.tt_effect = uint8_t(current_config.tt_effect);
+    uint32_t next_summary = 0;
+
+    for (uint32_t t = 0; t < DURATION_MS; t += next_gap()) {
+      milliseconds = uptime + t;
+      button_state = buttons_at(t);
+
+      s.ticks += ticker.get_ticks();
+      s.spin_steps += spin.update(tt_at(t));
+      s.spin = spin.get();
+      s.breathing = breathing.update();
+      s.bpm = bpm.update(button_state);
+      Tempo::update(button_state);
+      s.locked = Tempo::locked();
+      s.period = Tempo::period();
+      s.beats = Tempo::beat_count();
+      process_combos();
+      s.tt_effect = uint8_t(current_config.tt_effect);
+      s.combo_lights = timer_is_active(&combo_lights_timer);
+
+      if (s.locked != last.locked) {
+        std::printf("%5" PRIu32 " tempo %s\n", t, s.locked ? "locked" : "lost");
+      }
+      if (s.tt_effect != last.tt_effect) {
+        std::printf("%5" PRIu32 " combo tt_effect %u\n", t, s.tt_effect);
+      }
+      if (s.combo_lights != last.combo_lights) {
+        std::printf("%5" PRIu32 " combo lights %s\n", t, s.combo_lights ? "on" : "off");
+      }
+      if (t >= next_summary) {
+        std::printf("%5" PRIu32 " ticks %" PRIu32 " spin %u/%u breathing %u bpm %u tempo %u/%u\n",
+                    t, s.ticks, s.spin, s.spin_steps, s.breathing, s.bpm, s.period, s.beats);
+        next_summary += SUMMARY_MS;
+      }
+      last = s;
+    }
+    return 0;
+  }
+
+  template<typename F>
+  void bench(const char* name, F f) {
+    constexpr uint32_t CALLS = 10000000;
+    milliseconds = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CALLS; i++) {
+      // A new millisecond every 16 calls, roughly a busy main loop
+      milliseconds += (i & 0xF) == 0;
+      f(i);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-12s %6.1f ns/call\n", name, elapsed.count() / CALLS);
+  }
+
+  // Only host time, which says how a refactor moves things, not what the
+  // AVR takes. The results are kept so the calls aren't optimised away
+  int run_benchmarks() {
+    Hardware::reset();
+    main_init();
+
+    volatile uint32_t sink = 0;
+    Ticker ticker(7);
+    bench("Ticker", [&](uint32_t) { sink += ticker.get_ticks(); });
+    SpinPattern spin(50, 25, 12);
+    bench("SpinPattern", [&](uint32_t i) { sink += spin.update((i >> 12) % 3 - 1); });
+    BreathingPattern breathing(3000);
+    bench("Breathing", [&](uint32_t) { sink += breathing.update(); });
+    Bpm bpm(16);
+    bench("Bpm", [&](uint32_t i) { sink += bpm.update(buttons_at(i >> 4)); });
+    bench("Tempo", [&](uint32_t i) { Tempo::update(buttons_at(i >> 4 & 0x1FFF)); });
+    bench("Combos", [&](uint32_t i) {
+      button_state = buttons_at(i >> 4 & 0x3FFF);
+      process_combos();
+    });
+    return 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t uptime = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--uptime") == 0 && i + 1 < argc) {
+      uptime = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--bench") == 0) {
+      return run_benchmarks();
+    } else {
+      std::fprintf(stderr, "Usage: %s [--uptime ms] [--bench]\n", argv[0]);
+      return 1;
+    }
+  }
+  return replay(uptime);
+}
@@ -0,0 +1,376 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uhid.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <LUFA/Drivers/USB/USB.h>
+
+#include "Descriptors.h"
+#include "hid.h"
+#include "usb.h"
+
+#ifndef UHID_PATH
+#define UHID_PATH "/dev/uhid"
+#endif
+
+// Declared in beef.cpp, handles control requests for the config interface
+extern HidReport<config, INTERFACE_ID_Config, ENDPOINT_CONTROLEP> config_hid_report;
+
+// LUFA globals and functions the firmware uses, everything else it needs from
+// the USB controller is inline and reads or writes registers
+volatile uint8_t USB_DeviceState = DEVICE_STATE_Unattached;
+bool USB_Device_RemoteWakeupEnabled = false;
+
+void USB_Init() {
+  USB_DeviceState = DEVICE_STATE_Powered;
+}
+
+void USB_Device_SendRemoteWakeup() {}
+
+bool Endpoint_ConfigureEndpoint_Prv(const uint8_t Number,
+                                    const uint8_t UECFG0XData,
+                                    const uint8_t UECFG1XData) {
+  (void)Number;
+  (void)UECFG0XData;
+  (void)UECFG1XData;
+  return true;
+}
+
+// Control requests come from uhid instead, see Usb::poll()
+void HID_Device_ProcessControlRequest(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo) {
+  (void)HIDInterfaceInfo;
+}
+
+namespace Usb {
+  enum {
+    INTERFACES = INTERFACE_ID_Telemetry + 1
+  };
+
+  bool verbose = false;
+
+  int fds[INTERFACES] = { -1, -1, -1, -1, -1, -1 };
+
+  struct out_report {
+    hid_state* state;
+    std::vector<uint8_t> data;
+  };
+  std::vector<out_report> out_reports;
+
+  const char* const interface_names[INTERFACES] = {
+    "joystick", "keyboard", "mouse", "config", "lights", "telemetry"
+  };
+
+  void print_report(const char* what, const uint8_t interface, const uint8_t* data, const uint16_t size) {
+    if (!verbose) {
+      return;
+    }
+
+    printf("%8u %-4s %-8s", milliseconds, what, interface_names[interface]);
+    for (uint16_t i = 0; i < size; i++) {
+      printf(" %02x", data[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  bool send(const uint8_t interface, const uhid_event &event) {
+    if (write(fds[interface], &event, sizeof(event)) != sizeof(event)) {
+      fprintf(stderr, "Writing to %s failed: %s\n", interface_names[interface], strerror(errno));
+      return false;
+    }
+    return true;
+  }
+
+  // Reads a string descriptor into ASCII, for device names
+  void get_string(const uint8_t index, char* str, const size_t n) {
+    const void* address;
+    str[0] = '\0';
+    if (CALLBACK_USB_GetDescriptor((DTYPE_String << 8) | index, 0, &address) == NO_DESCRIPTOR) {
+      return;
+    }
+
+    const auto descriptor = static_cast<const USB_Descriptor_String_t*>(address);
+    const size_t length = (descriptor->Header.Size - sizeof(USB_Descriptor_Header_t)) / sizeof(descriptor->UnicodeString[0]);
+    size_t i = 0;
+    for (; i < length && i + 1 < n && descriptor->UnicodeString[i]; i++) {
+      str[i] = static_cast<char>(descriptor->UnicodeString[i]);
+    }
+    str[i] = '\0';
+  }
+
+  bool create(const uint8_t interface) {
+    const void* hid_descriptor;
+    const void* report_descriptor;
+    const uint16_t report_size = CALLBACK_USB_GetDescriptor(HID_DTYPE_Report << 8, interface, &report_descriptor);
+    if (report_size == NO_DESCRIPTOR ||
+        CALLBACK_USB_GetDescriptor(HID_DTYPE_HID << 8, interface, &hid_descriptor) == NO_DESCRIPTOR) {
+      // SDVX has no lights interface, and only TELEMETRY builds have telemetry
+      return true;
+    }
+
+    fds[interface] = open(UHID_PATH, O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    if (fds[interface] < 0) {
+      fprintf(stderr, "Can't open " UHID_PATH ": %s\n", strerror(errno));
+      return false;
+    }
+
+    uhid_event event{};
+    event.type = UHID_CREATE2;
+    auto &create = event.u.create2;
+
+    char manufacturer[32];
+    char product[32];
+    get_string(STRING_ID_Manufacturer, manufacturer, sizeof(manufacturer));
+    get_string(STRING_ID_Product, product, sizeof(product));
+    snprintf(reinterpret_cast<char*>(create.name), sizeof(create.name), "%s %s", manufacturer, product);
+    snprintf(reinterpret_cast<char*>(create.phys), sizeof(create.phys), "virtual-board/input%u", interface);
+
+    create.bus = BUS_USB;
+    create.vendor = DeviceDescriptor->VendorID;
+    create.product = DeviceDescriptor->ProductID;
+    create.version = DeviceDescriptor->ReleaseNumber;
+    create.country = static_cast<const USB_HID_Descriptor_HID_t*>(hid_descriptor)->CountryCode;
+    create.rd_size = report_size;
+    memcpy(create.rd_data, report_descriptor, report_size);
+
+    return send(interface, event);
+  }
+
+  bool attach() {
+    for (uint8_t interface = 0; interface < INTERFACES; interface++) {
+      if (!create(interface)) {
+        detach();
+        return false;
+      }
+    }
+
+    // The host has set the configuration
+    USB_DeviceState = DEVICE_STATE_Configured;
+    EVENT_USB_Device_ConfigurationChanged();
+    return true;
+  }
+
+  void detach() {
+    USB_DeviceState = DEVICE_STATE_Unattached;
+
+    for (auto &fd : fds) {
+      if (fd < 0) {
+        continue;
+      }
+
+      uhid_event event{};
+      event.type = UHID_DESTROY;
+      write(fd, &event, sizeof(event));
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  uint8_t report_type(const uint8_t rtype) {
+    switch (rtype) {
+      case UHID_INPUT_REPORT:
+        return HID_REPORT_ITEM_In;
+      case UHID_OUTPUT_REPORT:
+        return HID_REPORT_ITEM_Out;
+      default:
+        return HID_REPORT_ITEM_Feature;
+    }
+  }
+
+  // The firmware stalls requests it doesn't handle
+  void clear_stall() {
+    UECONX &= ~(1 << STALLRQ);
+  }
+
+  bool stalled() {
+    return UECONX & (1 << STALLRQ);
+  }
+
+  // Same as HID_Device_ProcessControlRequest() for a GET_REPORT request
+  void get_report(const uint8_t interface, const uhid_get_report_req &request) {
+    uhid_event reply{};
+    reply.type = UHID_GET_REPORT_REPLY;
+    reply.u.get_report_reply.id = request.id;
+    reply.u.get_report_reply.err = EIO;
+
+    if (interface == INTERFACE_ID_Config) {
+      auto &info = config_hid_report.HID_Interface;
+      uint8_t report_data[info.Config.PrevReportINBufferSize];
+      uint8_t report_id = request.rnum;
+      uint16_t report_size = 0;
+      memset(report_data, 0, sizeof(report_data));
+
+      clear_stall();
+      CALLBACK_HID_Device_CreateHIDReport(&info, &report_id, report_type(request.rtype),
+                                          report_data, &report_size);
+      if (!stalled()) {
+        uint8_t* const data = reply.u.get_report_reply.data;
+        uint16_t size = 0;
+        if (request.rnum) {
+          data[size++] = request.rnum;
+        }
+        memcpy(data + size, report_data, report_size);
+        size += report_size;
+
+        reply.u.get_report_reply.err = 0;
+        reply.u.get_report_reply.size = size;
+        print_report("get", interface, data, size);
+      }
+    }
+
+    send(interface, reply);
+  }
+
+  // Same as HID_Device_ProcessControlRequest() for a SET_REPORT request
+  void set_report(const uint8_t interface, const uhid_set_report_req &request) {
+    uhid_event reply{};
+    reply.type = UHID_SET_REPORT_REPLY;
+    reply.u.set_report_reply.id = request.id;
+    reply.u.set_report_reply.err = EIO;
+
+    const uint8_t skip = request.rnum ? 1 : 0;
+    if (interface == INTERFACE_ID_Config && request.size >= skip) {
+      print_report("set", interface, request.data, request.size);
+
+      clear_stall();
+      CALLBACK_HID_Device_ProcessHIDReport(&config_hid_report.HID_Interface, request.rnum,
+                                           report_type(request.rtype),
+                                           request.data + skip, request.size - skip);
+      if (!stalled()) {
+        reply.u.set_report_reply.err = 0;
+      }
+    }
+
+    send(interface, reply);
+  }
+
+  void output(const uint8_t interface, const uhid_output_req &request) {
+    hid_state* state;
+    switch (interface) {
+      case INTERFACE_ID_Joystick:
+        state = &joystick_out_state;
+        break;
+      case INTERFACE_ID_Lights:
+        state = &lights_out_state;
+        break;
+      default:
+        return;
+    }
+
+    print_report("out", interface, request.data, request.size);
+    out_reports.push_back({ state, std::vector<uint8_t>(request.data, request.data + request.size) });
+  }
+
+  void poll() {
+    for (uint8_t interface = 0; interface < INTERFACES; interface++) {
+      if (fds[interface] < 0) {
+        continue;
+      }
+
+      uhid_event event;
+      while (read(fds[interface], &event, sizeof(event)) > 0) {
+        switch (event.type) {
+          case UHID_OUTPUT:
+            output(interface, event.u.output);
+            break;
+          case UHID_GET_REPORT:
+            get_report(interface, event.u.get_report);
+            break;
+          case UHID_SET_REPORT:
+            set_report(interface, event.u.set_report);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+  }
+
+  // Same as receive() in hid.cpp, which reads the report out of the endpoint instead.
+  // Returns false if the ring is full and the report has to wait, like a NAK
+  bool receive(hid_state &state, const std::vector<uint8_t> &data) {
+    const uint8_t length = MIN(data.size(), static_cast<size_t>(state.size));
+    if (length == 0) {
+      return true;
+    }
+
+    uint8_t* const buffer = hid_back_buffer(state);
+    if (!buffer) {
+      return false;
+    }
+    memcpy(buffer, data.data(), length);
+    hid_push(state, length);
+    return true;
+  }
+
+  void start_of_frame() {
+    if (USB_DeviceState != DEVICE_STATE_Configured) {
+      out_reports.clear();
+      return;
+    }
+
+    // Reports a full ring turned away are retried next frame, in order
+    std::vector<out_report> waiting;
+    for (auto &report : out_reports) {
+      const bool blocked = std::any_of(waiting.begin(), waiting.end(), [&report](const out_report &w) {
+        return w.state == report.state;
+      });
+      if (blocked || !receive(*report.state, report.data)) {
+        waiting.push_back(std::move(report));
+      }
+    }
+    out_reports = std::move(waiting);
+  }
+}
+
+// Same as LUFA's, but the report goes to the interface's uhid device
+void HID_Device_USBTask(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo) {
+  if (USB_DeviceState != DEVICE_STATE_Configured) {
+    return;
+  }
+  if (HIDInterfaceInfo->State.PrevFrameNum == USB_Device_GetFrameNumber()) {
+    return;
+  }
+
+  uint8_t ReportINData[HIDInterfaceInfo->Config.PrevReportINBufferSize];
+  uint8_t ReportID = 0;
+  uint16_t ReportINSize = 0;
+  memset(ReportINData, 0, sizeof(ReportINData));
+
+  const bool ForceSend = CALLBACK_HID_Device_CreateHIDReport(HIDInterfaceInfo, &ReportID, HID_REPORT_ITEM_In,
+                                                             ReportINData, &ReportINSize);
+  bool StatesChanged = false;
+  const bool IdlePeriodElapsed = HIDInterfaceInfo->State.IdleCount && !HIDInterfaceInfo->State.IdleMSRemaining;
+
+  if (HIDInterfaceInfo->Config.PrevReportINBuffer != NULL) {
+    StatesChanged = memcmp(ReportINData, HIDInterfaceInfo->Config.PrevReportINBuffer, ReportINSize) != 0;
+    memcpy(HIDInterfaceInfo->Config.PrevReportINBuffer, ReportINData, HIDInterfaceInfo->Config.PrevReportINBufferSize);
+  }
+
+  const uint8_t interface = HIDInterfaceInfo->Config.InterfaceNumber;
+  if (ReportINSize && (ForceSend || StatesChanged || IdlePeriodElapsed) && Usb::fds[interface] >= 0) {
+    HIDInterfaceInfo->State.IdleMSRemaining = HIDInterfaceInfo->State.IdleCount;
+
+    uhid_event event{};
+    event.type = UHID_INPUT2;
+    auto &input = event.u.input2;
+    if (ReportID) {
+      input.data[input.size++] = ReportID;
+    }
+    memcpy(input.data + input.size, ReportINData, ReportINSize);
+    input.size += ReportINSize;
+
+    // Joystick reports go out every frame, so only show them when they change
+    if (StatesChanged || IdlePeriodElapsed) {
+      Usb::print_report("in", interface, input.data, input.size);
+    }
+    Usb::send(interface, event);
+  }
+
+  HIDInterfaceInfo->State.PrevFrameNum = USB_Device_GetFrameNumber();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Stands in for LUFA's USB controller driver, presenting each of the firmware's
+// HID interfaces to the host as a separate uhid device
+namespace Usb {
+  // Print every report that goes over the bus
+  extern bool verbose;
+
+  // Creates the uhid devices from the firmware's descriptors and configures the board,
+  // like a host enumerating it after it's plugged in
+  bool attach();
+  void detach();
+
+  // Handles the host's requests and queues its OUT reports
+  void poll();
+  // Hands queued OUT reports to the firmware, like hid_receive() does every frame
+  void start_of_frame();
+}